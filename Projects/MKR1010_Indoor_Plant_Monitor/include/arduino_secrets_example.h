@@ -1,5 +1,7 @@
 #define S_SSID "your_network_ssid"
 #define S_PASS "your_network_passphrase"
+// #define S_SSID_2 "second_network_ssid"  // Optional, the stronger of the two is joined
+// #define S_PASS_2 "second_network_passphrase"
 #define S_MQTT_PORT 1883    // Default ports 1883 / 8883 (SSL)
 #define S_MQTT_ADDR "0.0.0.0"
 #define S_MQTT_USER "username"
@@ -18,6 +18,66 @@
   [1.3] --------------
   > Critical bug fix
     - Moisture sensor calibration cap values were being incorrectly saved to base
+  [1.4] --------------
+  > Persistent calibration
+    - Moisture sensor calibration is stored in flash and loaded at boot
+    - Recalibrate by touching the touch pin during boot or with a "calibrate" command on the cmd topic
+  [1.5] --------------
+  > Shared Mqtt Utility
+    - Local Mqtt Utility copy replaced with the shared common/libraries/Mqtt_Utility (1.2)
+    - Connection is kept up by the library's reconnect engine (tick()) instead of pollMqtt()
+  [1.6] --------------
+  > Bounded sensor reads
+    - DHT22 reads are retried for SENSOR_TIMEOUT ms instead of forever, last good values are kept
+    - DHT22 availability is published on the availability topic
+    - Optional hardware watchdog (SENSORS_WATCHDOG)
+  [1.7] --------------
+  > Supervisor
+    - Boot continues without WiFi/MQTT instead of halting, discovery is configured on the first connection
+    - Watchdog is owned by the shared Supervisor, it is kicked during calibration (SENSORS_WATCHDOG)
+    - Reset reason and crash count are published on the availability topic
+  [1.8] --------------
+  > Change-based reporting
+    - Sensors are sampled every interval, a report is published when a value crosses its deadband
+      or when heartbeat has elapsed since the last report
+    - Reports carry min/mean/max of the DHT22 samples since the previous report under "stats"
+  [1.9] --------------
+  > Runtime configuration
+    - interval, heartbeat, sensor timeout, moisture sampling rounds and DHT22 offsets are set with a
+      JSON document on the command topic, e.g. {"interval": 120, "rounds": 20}
+    - Changes apply without a reset and are saved to flash
+  [1.10] --------------
+  > State frame
+    - State payloads are set in a static StateFrame and serialized once by Mqtt_Utility, sendData()
+      no longer measures, serializes and copies a JsonDocument
+  [1.11] --------------
+  > Sensor set
+    - Sensors are driver policies in a SensorSet (common/libraries/Sensors), reads, availability and
+      payload fields are expanded at compile time
+  [1.12] --------------
+  > Static moisture sensor table
+    - Probes are listed in MST_PROBES, the table is sized at compile time and MST_COUNT is checked with
+      static_assert. No malloc or VLA in setup(), ids and payload keys are string literals in flash
+  [1.13] --------------
+  > Persistent MQTT session
+    - Connects under the device id with clean session off, a dropped broker connection recovers with
+      one CONNECT when the broker answers the first attempt. Commands sent while offline are queued (QoS 1)
+  [1.14] --------------
+  > Publish acknowledgements
+    - State messages are published at QoS 1. A reading that is not published leaves the report gate due
+      and is reported again at the next sample
+  [1.15] --------------
+  > Network selection
+    - S_SSID_2 in arduino_secrets.h adds a second network, the stronger one is joined from a scan. A weak
+      link (MQTTU_ROAM_RSSI) is re-evaluated every few minutes and the node moves to a clearly stronger network
+  [1.16] --------------
+  > Fixed-point moisture
+    - Calibration is precomputed into a fixed-point scale (Sensor_Convert.h), readings are converted with
+      one multiply instead of map(). Moisture is published with one decimal, e.g. "smst1": 43.5
+  [1.17] --------------
+  > Firmware updates over MQTT
+    - With MQTTU_OTA, firmware is uploaded with common/scripts/ota_send.py. The image is streamed into the
+      upper flash half and applied after its CRC checks, sampling and reports pause during the download
 
   Board(s):
     - Arduino MKR WiFi 1010
@@ -37,23 +97,30 @@
 #include <Arduino.h>
 #include <ArduinoJson.h>
 #include <ArduinoMqttClient.h>
-#include <DHT.h>
 #include <WiFiNINA.h>
 #include <utility/wifi_drv.h>
 #include "arduino_secrets.h"
 #include "local_utils.h"
 #include <Mqtt_Utility.h>
+#include <Task_Scheduler.h>
+#include <Calibration_Store.h>
+#include <Sensor_Set.h>
+#include <drivers/dht22_sensor.h>
+#include <Supervisor.h>
+#include <Node_Config.h>
 
 // ------- Globals ------------
 // > Pins
 #define MST_COUNT 4 // Number of moisture sensors (only used for validation)
-#define MST_PIN_1 A0
-#define MST_PIN_2 A1
-#define MST_PIN_3 A2
-#define MST_PIN_4 A3
-// #define MST_PIN_5 A4
-// #define MST_PIN_6 A5
-// #define MST_PIN_7 A6
+// Moisture probes as X(id, pin) in order, up to 7
+#define MST_PROBES(X) \
+  X("1", A0) \
+  X("2", A1) \
+  X("3", A2) \
+  X("4", A3)
+  // X("5", A4)
+  // X("6", A5)
+  // X("7", A6)
 #define CASE_LED LED_BUILTIN
 #define DHTPIN 1
 #define TOUCH_PIN 2
@@ -62,186 +129,256 @@
 #define RGB_B_PIN 27
 // > Configuration
 const bool is_capacitive = true;
-const long interval = 300000;
-unsigned long previous = 0;
+const long interval = 60000;      // Sampling period
+const long heartbeat = 300000;    // Longest time between reports while readings stay within their deadbands
+const long sample_lead = 5000; // Start sampling this many ms before publishing
+const long poll_interval = 10;
 bool is_rgb_set = false;
 const unsigned short sensor_timeout = 3600;
+const unsigned long cal_touch_window = 3000;    // Touch within this many ms of boot to recalibrate
+const unsigned long cal_touch_timeout = 60000;  // Recalibration over MQTT is aborted without a touch in time
+// > Reporting deadbands, a change this large since the last report is published immediately
+const float mst_deadband = 5, temp_deadband = 0.5, hum_deadband = 3;
+const unsigned short mst_rounds = 40;       // Moisture readings averaged per measurement, 100 ms apart
+// > Runtime configuration, the constants above are defaults for a config document on the command topic
+const node_cfg config_defaults = { interval, heartbeat, sensor_timeout, mst_rounds, 0, 0 };
+NodeConfig node_config(config_defaults);
 // > Sensors
-mst_sen_arr* mst_arr;
-int mst_arr_size;
-DHT dht (DHTPIN, DHT22);
-float temp, hum;
+mst_sen mst_arr[] = { MST_PROBES(MST_SENSOR) };  // Static, ids point to literals in flash
+constexpr int mst_arr_size = sizeof(mst_arr) / sizeof(mst_arr[0]);
+static_assert(mst_arr_size == MST_COUNT, "MST_PROBES does not match MST_COUNT");
+#ifdef DHTPIN
+typedef Dht22Sensor<DHTPIN> DhtSensor;
+#else
+typedef NoSensor DhtSensor;
+#endif
+SensorSet<DhtSensor> sensors;
+CalibrationStore cal_store;
+bool is_cal_requested = false;
+ReportGate report_gate(heartbeat);
+StateFrame state_frame;  // State payload, rendered once per report
+int8_t mst_first_channel;  // Moisture sensors take consecutive channels
 
 // ------- WiFi & MQTT --------
 // > Secrets (include/arduino_secrets.h)
 char ssid[] = S_SSID;
 char psk[] = S_PASS;
+// The strongest network in range is joined, S_SSID_2 is e.g. a repeater with its own SSID
+const wifi_cred networks[] = {
+  { ssid, psk },
+  #ifdef S_SSID_2
+  { S_SSID_2, S_PASS_2 },
+  #endif
+};
 char host[] = S_MQTT_ADDR;
 uint16_t port = S_MQTT_PORT;
 char user[] = S_MQTT_USER;
 char pass[] = S_MQTT_PASS;
 // > MQTT topics
 const char state_topic[] = "homeassistant/sensor/greenB/state";
+const char command_topic[] = "homeassistant/sensor/greenB/cmd";
+const char availability_topic[] = "homeassistant/sensor/greenB/avty";
+const char ota_topic[] = "homeassistant/sensor/greenB/ota";
+const char ota_status_topic[] = "homeassistant/sensor/greenB/ota/status";
 // > Global Classes
 WiFiClient wifiClient;
 // WiFiSSLClient wifiClient;
 MqttClient mqttClient(wifiClient);
 MqttUtility mqttUtil(wifiClient, mqttClient, ssid, psk, host, port);
+TaskScheduler scheduler;
+int8_t sample_task_id, publish_task_id;
+Supervisor supervisor;
+bool is_configured = false;  // Discovery sent, deferred until the first connection
 
 // Function declarations
 //
 void measureData();
 void sendData();
+void sendAvailability();
+void configureDiscovery();
+void pollTask();
+void sampleTask();
+void publishTask();
 int setMoistureCap(uint8_t, bool);
 int setMoistureBase(uint8_t, bool);
+bool calibrate(unsigned long);
+bool waitTouch(unsigned long);
+bool loadCalibration();
+void saveCalibration();
+void onCommand(const char*, size_t);
+void onConfig(JsonObjectConst);
+void onOta(util_ota_state);
+void applyConfig(uint8_t);
 void rgbLed(uint8_t, uint8_t, uint8_t);
-void makeSenArray();
 
 void setup() {
+  supervisor.begin();
   pinMode(CASE_LED, OUTPUT);
   pinMode(TOUCH_PIN, INPUT);
   digitalWrite(CASE_LED, HIGH);
   delay(50);
 
-  makeSenArray();
+  for (int i = 0; i < mst_arr_size; i++) {
+    int8_t channel = report_gate.addChannel(mst_arr[i].val_id, mst_deadband, false);
+    if (i == 0) mst_first_channel = channel;
+  }
+  report_gate.addChannel("temp", temp_deadband);  // Sensors emit into the channels by key
+  report_gate.addChannel("hum", hum_deadband);
   delay(50);
 
   if (strlen(user) > 0 && strlen(pass) > 0) {
     mqttUtil.setMqttUser(user, pass);
   }
+  mqttUtil.setWiFiNetworks(networks, sizeof(networks) / sizeof(networks[0]));
+  mqttUtil.setPersistentSession("greenB");  // Fast reconnects, the broker keeps the subscription
+  mqttUtil.setTopicQos(state_topic, 1);  // Readings count as published once the broker has acknowledged them
+  mqttUtil.setAvailabilityTopic(availability_topic);
   delay(50);
-  if(mqttUtil.init() != CONN_CONNECTED) while(1);
+  // Connect in the background, tick() keeps retrying
+  mqttUtil.start();
+  mqttUtil.setCommandCallback(command_topic, onCommand);
+  mqttUtil.setConfigCallback(command_topic, onConfig);
+  #ifdef MQTTU_OTA
+  mqttUtil.setOtaTopics(ota_topic, ota_status_topic, onOta);
+  #endif
   delay(50);
 
-  int r_max, g_max, b_max;
-  // Calibration - Base(Dry)
-  rgbLed(100, 50, 0);
-  r_max = 140;
-  g_max = 70;
-  b_max = 0;
-  while(digitalRead(TOUCH_PIN) != HIGH);
-  for (int i = 0; i < mst_arr_size; i++){
-    rgbLed(r_max*(i+1)/mst_arr_size, g_max*(i+1)/mst_arr_size, b_max*(i+1)/mst_arr_size);
-    (*mst_arr)[i].base = setMoistureBase((*mst_arr)[i].pin, is_capacitive);
-    delay(100);
-  }
-  delay(50);
-  rgbLed(0, 100, 0);
-  delay(2000);
+  // Load calibration from flash, calibrate if none is stored or touch pin is touched during boot
+  rgbLed(0, 0, 100);
+  if (!loadCalibration() || waitTouch(cal_touch_window)) calibrate(0);
   rgbLed(0, 0, 0);
   delay(50);
 
-  // Calibration - Cap(Wet)
-  rgbLed(0, 100, 100);
-  r_max = 0;
-  g_max = 140;
-  b_max = 140;
-  while(digitalRead(TOUCH_PIN) != HIGH);
-  for (int i = 0; i < mst_arr_size; i++){
-    rgbLed(r_max*(i+1)/mst_arr_size, g_max*(i+1)/mst_arr_size, b_max*(i+1)/mst_arr_size);
-    (*mst_arr)[i].cap = setMoistureCap((*mst_arr)[i].pin, is_capacitive);
-    delay(100);
-  }
-  delay(50);
-  rgbLed(0, 100, 0);
-  delay(2000);
-  rgbLed(0, 0, 0);
+  sensors.begin();
+  node_config.load();
+  applyConfig(NODE_CFG_HEARTBEAT | NODE_CFG_OFFSETS);
+
+  unsigned long period = node_config.get().interval;
+  scheduler.addTask(pollTask, poll_interval);
+  sample_task_id = scheduler.addTask(sampleTask, period, period - sample_lead);
+  publish_task_id = scheduler.addTask(publishTask, period, period);
+  
   delay(50);
+  digitalWrite(CASE_LED, LOW);
+}
+
+void loop() {
+  supervisor.kick();
+  scheduler.run();
+  if (is_cal_requested) {
+    is_cal_requested = false;
+    calibrate(cal_touch_timeout);
+  }
+}
+
+void pollTask() {
+  if (mqttUtil.tick() == CONN_STATE_CONNECTED && !is_configured) configureDiscovery();
+}
+
+void sampleTask() {
+  digitalWrite(CASE_LED, HIGH);
+  measureData();
+}
+
+void publishTask() {
+  // Samples between reports only go to the statistics
+  if (report_gate.isDue(mqttUtil.monotonicMs()) || sensors.isChanged()) sendData();
+  supervisor.markHealthy();
+  digitalWrite(CASE_LED, LOW);
+}
 
+
+// Function definitions
+//
+/**
+ * Publish discovery configs for the moisture sensors and DHT22
+ */
+void configureDiscovery() {
+  unsigned short sensor_timeout = node_config.get().sensorTimeout;
   for (int i = 0; i < mst_arr_size; i++){
     const char name_h[]="Green B Soil Moisture", id_h[]="greenBsoil", val_h[]="{{ value_json.", val_t[]=" }}", conf_h[]="homeassistant/sensor/greenBM", conf_t[]="/config";
 
-    char conf_topic[strlen(conf_h) + strlen((*mst_arr)[i].id) + strlen(conf_t) + 1];
-    snprintf(conf_topic, strlen(conf_h) + strlen((*mst_arr)[i].id) + strlen(conf_t) + 1, "%s%s%s", conf_h, (*mst_arr)[i].id, conf_t);
+    char conf_topic[strlen(conf_h) + strlen(mst_arr[i].id) + strlen(conf_t) + 1];
+    snprintf(conf_topic, strlen(conf_h) + strlen(mst_arr[i].id) + strlen(conf_t) + 1, "%s%s%s", conf_h, mst_arr[i].id, conf_t);
 
-    char name[strlen(name_h) + strlen((*mst_arr)[i].id) + 1];
-    snprintf(name, strlen(name_h) + strlen((*mst_arr)[i].id) + 1, "%s%s", name_h, (*mst_arr)[i].id);
+    char name[strlen(name_h) + strlen(mst_arr[i].id) + 1];
+    snprintf(name, strlen(name_h) + strlen(mst_arr[i].id) + 1, "%s%s", name_h, mst_arr[i].id);
 
-    char uniq_id[strlen(id_h) + strlen((*mst_arr)[i].id) + 1];
-    snprintf(uniq_id, strlen(id_h) + strlen((*mst_arr)[i].id) + 1, "%s%s", id_h, (*mst_arr)[i].id);
+    char uniq_id[strlen(id_h) + strlen(mst_arr[i].id) + 1];
+    snprintf(uniq_id, strlen(id_h) + strlen(mst_arr[i].id) + 1, "%s%s", id_h, mst_arr[i].id);
 
-    char val_tpl[strlen(val_h) + strlen((*mst_arr)[i].val_id) + strlen(val_t) + 1];
-    snprintf(val_tpl, strlen(val_h) + strlen((*mst_arr)[i].val_id) + strlen(val_t) + 1, "%s%s%s", val_h, (*mst_arr)[i].val_id, val_t);
+    char val_tpl[strlen(val_h) + strlen(mst_arr[i].val_id) + strlen(val_t) + 1];
+    snprintf(val_tpl, strlen(val_h) + strlen(mst_arr[i].val_id) + strlen(val_t) + 1, "%s%s%s", val_h, mst_arr[i].val_id, val_t);
 
-    mdev dev = { conf_topic, "moisture", sensor_timeout, name, state_topic, uniq_id, "%", val_tpl };
-    mqttUtil.configureTopic(&dev);
+    mdev dev = { "moisture", sensor_timeout, name, state_topic, uniq_id, "%", val_tpl, conf_topic };
+    mqttUtil.configureTopic(dev);
   }
 
   #ifdef DHTPIN
-  dht.begin();
   const char dht_temp_conf_t[] = "homeassistant/sensor/greenBT/config";
   const char dht_hum_conf_t[] = "homeassistant/sensor/greenBH/config";
-  mdev dht_t_dev = { dht_temp_conf_t, "temperature", sensor_timeout, "GreenB Air Temperature", state_topic, "greenBtemp", "°C", "{{ value_json.temp | round(2) }}" };
-  mqttUtil.configureTopic(&dht_t_dev);
-  mdev dht_h_dev = { dht_hum_conf_t, "humidity", sensor_timeout, "GreenB Air Humidity", state_topic, "greenBhum", "%", "{{ value_json.hum | round(1) }}" };
-  mqttUtil.configureTopic(&dht_h_dev);
+  mdev dht_t_dev = { "temperature", sensor_timeout, "GreenB Air Temperature", state_topic, "greenBtemp", "°C", "{{ value_json.temp | round(2) }}", dht_temp_conf_t, NULL, "{{ value_json.dht }}" };
+  mqttUtil.configureTopic(dht_t_dev);
+  mdev dht_h_dev = { "humidity", sensor_timeout, "GreenB Air Humidity", state_topic, "greenBhum", "%", "{{ value_json.hum | round(1) }}", dht_hum_conf_t, NULL, "{{ value_json.dht }}" };
+  mqttUtil.configureTopic(dht_h_dev);
   #endif
-  
-  delay(50);
-  digitalWrite(CASE_LED, LOW);
-}
-
-void loop() {
-  mqttUtil.pollMqtt();
-  unsigned long current = millis();
-  
-  if (current - previous >= interval) {
-    previous = current;
-    digitalWrite(CASE_LED, HIGH);
-    measureData();
-    sendData();
-    digitalWrite(CASE_LED, LOW);
-  }
-  delay(1000);
+  mqttUtil.saveDiscoveryCache();
+  is_configured = true;
 }
 
-
-// Function definitions
-//
 void measureData() {
-  short lp = 40;
+  // Sampling blocks, rounds are limited to what fits in sample_lead
+  short lp = min((unsigned long)node_config.get().rounds, (unsigned long)(sample_lead / 100));
   int raw;
   for(int k=0; k < mst_arr_size; k++){
-    (*mst_arr)[k].sum = 0;
+    mst_arr[k].sum = 0;
   }
 
   for(int i=0; i<lp; i++){
     for(int k=0; k < mst_arr_size; k++){
       // Constrain values to avoid mapping issues
-      raw = constrain(analogRead((*mst_arr)[k].pin), (*mst_arr)[k].cap, (*mst_arr)[k].base);
-      (*mst_arr)[k].sum += raw;
+      raw = constrain(analogRead(mst_arr[k].pin), mst_arr[k].cap, mst_arr[k].base);
+      mst_arr[k].sum += raw;
     }
     delay(100);
   }
   
   for(int k=0; k < mst_arr_size; k++){
-    (*mst_arr)[k].val = map((*mst_arr)[k].sum/lp, (*mst_arr)[k].cap, (*mst_arr)[k].base, 100, 0);
+    mst_arr[k].val = mst_arr[k].scale.apply(mst_arr[k].sum / lp);
+    report_gate.update(mst_first_channel + k, mst_arr[k].val * 0.1f);
   }
 
-  do {
-    temp = dht.readTemperature();
-    hum = dht.readHumidity();
-  } while (isnan(temp) || isnan(hum));
+  // Previous values are kept if the sensor does not answer
+  sensors.acquireAll(report_gate);
   return;
 }
 
 void sendData() {
-    JsonDocument doc;
+    state_frame.clear();
     for(int i=0; i<mst_arr_size; i++){
-      doc[(*mst_arr)[i].val_id] = (*mst_arr)[i].val;
+      state_frame.setFixed(mst_arr[i].val_id, mst_arr[i].val, 1);
     }
-    #ifdef DHTPIN
-    doc["temp"] = temp;
-    doc["hum"] = hum;
-    #endif
-    int len = measureJson(doc);
-    char output[len++];
-    serializeJson(doc, output, len);
+    sensors.emit(state_frame);
+    report_gate.addStats(state_frame);
     mqttUtil.checkConnection();
-    mqttUtil.sendPackets(doc, state_topic);
+    // A dropped reading leaves the gate due, it is reported again at the next sample
+    if (mqttUtil.sendFrame(state_frame, state_topic) != PUB_DROPPED) report_gate.markReported(mqttUtil.monotonicMs());
+    sendAvailability();
     return;
 }
 
+/**
+ * Publish sensor availability when it has changed, with the reason of the last reset
+ */
+void sendAvailability() {
+  if (!sensors.isChanged()) return;
+  JsonDocument doc;
+  sensors.addAvailability(doc);
+  doc["rst"] = supervisor.getResetReason();
+  doc["crash"] = supervisor.getCrashCount();
+  if (mqttUtil.sendAvailability(doc)) sensors.markReported();
+}
+
 int setMoistureCap(uint8_t sensor_pin, bool is_capacitive){
   unsigned long start = millis();
   int moisture_cap;
@@ -249,6 +386,7 @@ int setMoistureCap(uint8_t sensor_pin, bool is_capacitive){
   if(is_capacitive){
     moisture_cap = 0;
     while(millis() - start < 5000){
+      supervisor.kick();
       int mst = analogRead(sensor_pin);
       if(mst > moisture_cap){
         moisture_cap = mst;
@@ -258,6 +396,7 @@ int setMoistureCap(uint8_t sensor_pin, bool is_capacitive){
   } else {
     moisture_cap = 2000;
     while(millis() - start < 5000){
+      supervisor.kick();
       int mst = analogRead(sensor_pin);
       if(mst < moisture_cap){
         moisture_cap = mst;
@@ -276,6 +415,7 @@ int setMoistureBase(uint8_t sensor_pin, bool is_capacitive){
   if(is_capacitive){
     moisture_base = 2000;
     while(millis() - start < 5000){
+      supervisor.kick();
       int mst = analogRead(sensor_pin);
       if(mst < moisture_base){
         moisture_base = mst;
@@ -285,6 +425,7 @@ int setMoistureBase(uint8_t sensor_pin, bool is_capacitive){
   } else {
     moisture_base = 0;
     while(millis() - start < 5000){
+      supervisor.kick();
       int mst = analogRead(sensor_pin);
       if(mst > moisture_base){
         moisture_base = mst;
@@ -295,6 +436,141 @@ int setMoistureBase(uint8_t sensor_pin, bool is_capacitive){
   return moisture_base;
 }
 
+/**
+ * Calibrate moisture sensors, dry (base) first and then wet (cap). Each step starts with a touch.
+ * Values are saved to flash when both steps complete.
+ * touch_timeout: ms to wait for each touch, 0 = wait forever. Returns false if aborted.
+ */
+bool calibrate(unsigned long touch_timeout) {
+  int r_max, g_max, b_max;
+  short base[mst_arr_size];
+
+  // Calibration - Base(Dry)
+  rgbLed(100, 50, 0);
+  r_max = 140;
+  g_max = 70;
+  b_max = 0;
+  if (!waitTouch(touch_timeout)) {
+    rgbLed(0, 0, 0);
+    return false;
+  }
+  for (int i = 0; i < mst_arr_size; i++){
+    rgbLed(r_max*(i+1)/mst_arr_size, g_max*(i+1)/mst_arr_size, b_max*(i+1)/mst_arr_size);
+    base[i] = setMoistureBase(mst_arr[i].pin, is_capacitive);
+    delay(100);
+  }
+  delay(50);
+  rgbLed(0, 100, 0);
+  delay(2000);
+  rgbLed(0, 0, 0);
+  delay(50);
+
+  // Calibration - Cap(Wet)
+  rgbLed(0, 100, 100);
+  r_max = 0;
+  g_max = 140;
+  b_max = 140;
+  if (!waitTouch(touch_timeout)) {
+    rgbLed(0, 0, 0);
+    return false;
+  }
+  for (int i = 0; i < mst_arr_size; i++){
+    rgbLed(r_max*(i+1)/mst_arr_size, g_max*(i+1)/mst_arr_size, b_max*(i+1)/mst_arr_size);
+    setCalibration(mst_arr[i], base[i], setMoistureCap(mst_arr[i].pin, is_capacitive));
+    delay(100);
+  }
+  delay(50);
+  rgbLed(0, 100, 0);
+  delay(2000);
+  rgbLed(0, 0, 0);
+  delay(50);
+
+  saveCalibration();
+  return true;
+}
+
+/**
+ * Wait for the touch pin, polls MQTT while waiting. Returns true if touched before timeout (0 = wait forever).
+ */
+bool waitTouch(unsigned long timeout) {
+  unsigned long start = millis();
+  while (digitalRead(TOUCH_PIN) != HIGH) {
+    if (timeout > 0 && millis() - start >= timeout) return false;
+    supervisor.kick();
+    pollTask();
+  }
+  return true;
+}
+
+/**
+ * Load moisture sensor calibration from flash, stored pins must match the sensor array.
+ */
+bool loadCalibration() {
+  cal_entry cal[mst_arr_size];
+  for (int i = 0; i < mst_arr_size; i++) cal[i].pin = mst_arr[i].pin;
+  if (!cal_store.load(cal, mst_arr_size)) return false;
+
+  for (int i = 0; i < mst_arr_size; i++) {
+    setCalibration(mst_arr[i], cal[i].base, cal[i].cap);
+  }
+  return true;
+}
+
+void saveCalibration() {
+  cal_entry cal[mst_arr_size];
+  for (int i = 0; i < mst_arr_size; i++) {
+    cal[i] = { mst_arr[i].pin, mst_arr[i].base, mst_arr[i].cap };
+  }
+  cal_store.save(cal, mst_arr_size);
+}
+
+/**
+ * MQTT command handler. "calibrate": recalibrate moisture sensors, each step must be started with a touch.
+ */
+void onCommand(const char* payload, size_t length) {
+  if (strcmp(payload, "calibrate") == 0) is_cal_requested = true;
+}
+
+/**
+ * Apply a config document from the command topic, changed settings are saved to flash
+*/
+void onConfig(JsonObjectConst config) {
+  uint8_t changed = node_config.apply(config);
+  if (changed == 0) return;
+  applyConfig(changed);
+  node_config.save();
+}
+
+#ifdef MQTTU_OTA
+/**
+ * Pause sampling and reports while a firmware image is received, NINA only serves the download
+*/
+void onOta(util_ota_state state) {
+  bool is_idle = state != OTA_RECEIVING;
+  // Resumed with the sampling run sample_lead ahead of the report, as scheduled in setup()
+  uint32_t period = node_config.get().interval;
+  scheduler.setEnabled(sample_task_id, is_idle, period - sample_lead);
+  scheduler.setEnabled(publish_task_id, is_idle, period);
+  if (state == OTA_APPLYING) supervisor.pause();  // The flash copy runs without kicks
+}
+#endif
+
+/**
+ * Apply changed settings. Rounds are read on every measurement, offsets go to the DHT22 policy.
+*/
+void applyConfig(uint8_t changed) {
+  const node_cfg& cfg = node_config.get();
+  if (changed & NODE_CFG_INTERVAL) {
+    scheduler.setPeriod(sample_task_id, cfg.interval);
+    scheduler.setPeriod(publish_task_id, cfg.interval);
+  }
+  if (changed & NODE_CFG_HEARTBEAT) report_gate.setHeartbeat(cfg.heartbeat);
+  #ifdef DHTPIN
+  if (changed & NODE_CFG_OFFSETS) sensors.get<DhtSensor>().setOffsets(cfg.temperatureOffset, cfg.humidityOffset);
+  #endif
+  if (changed & NODE_CFG_TIMEOUT) is_configured = false;  // Re-published by pollTask()
+}
+
 /**
  * WiFiNINA boards: control built-in RGB LED
 */
@@ -309,80 +585,3 @@ void rgbLed(uint8_t r, uint8_t g, uint8_t b) {
   WiFiDrv::analogWrite(RGB_G_PIN, g);
   WiFiDrv::analogWrite(RGB_B_PIN, b);
 }
-
-/**
- * Validate moisture sensor definitions then create a new array of sensor definitions and save to global.
- */
-void makeSenArray() {
-  // Verify sensor pin count
-  int c = 0;
-  #ifdef MST_PIN_1
-  c++;
-  #endif
-  #ifdef MST_PIN_2
-  c++;
-  #endif
-  #ifdef MST_PIN_3
-  c++;
-  #endif
-  #ifdef MST_PIN_4
-  c++;
-  #endif
-  #ifdef MST_PIN_5
-  c++;
-  #endif
-  #ifdef MST_PIN_6
-  c++;
-  #endif
-  #ifdef MST_PIN_7
-  c++;
-  #endif
-  if(c!=MST_COUNT) {
-    rgbLed(100,0,0);
-    while(1);
-  }
-
-  // Gather pin assignments
-  uint8_t pin_arr[c];
-  int n = 0;
-  #ifdef MST_PIN_1
-  pin_arr[n]=MST_PIN_1;
-  n++;
-  #endif
-  #ifdef MST_PIN_2
-  pin_arr[n]=MST_PIN_2;
-  n++;
-  #endif
-  #ifdef MST_PIN_3
-  pin_arr[n]=MST_PIN_3;
-  n++;
-  #endif
-  #ifdef MST_PIN_4
-  pin_arr[n]=MST_PIN_4;
-  n++;
-  #endif
-  #ifdef MST_PIN_5
-  pin_arr[n]=MST_PIN_5;
-  n++;
-  #endif
-  #ifdef MST_PIN_6
-  pin_arr[n]=MST_PIN_6;
-  n++;
-  #endif
-  #ifdef MST_PIN_7
-  pin_arr[n]=MST_PIN_7;
-  n++;
-  #endif
-
-  // Allocate and populate new sensor array
-  mst_sen_arr* new_arr = (mst_sen_arr*)malloc(c * sizeof(mst_sen));
-  for(int k = 0; k<c; k++){
-    (*new_arr)[k] = { pin_arr[k], 0, 0, 0, 0 };
-    snprintf((*new_arr)[k].id, sizeof((*new_arr)[k].id), "%d", k+1);
-    snprintf((*new_arr)[k].val_id, sizeof((*new_arr)[k].val_id), "%s%d", "smst", k+1);
-  }
-
-  mst_arr_size = c; // Save array size to global
-  mst_arr = new_arr;  // Save new array to global
-  return;
-}
\ No newline at end of file
@@ -0,0 +1,57 @@
+/*
+  Author: Ilari Mattsson
+  project: MKR1010_Indoor_Plant_Monitor
+  File: discovery_table.h
+
+  Device identity, moisture probes, fitted sensors and their Home Assistant discovery table.
+  Shared by src/main.cpp and the native tests, so the tests publish the table the firmware does.
+*/
+
+#ifndef DISCOVERY_TABLE_H
+#define DISCOVERY_TABLE_H
+
+#include <Arduino.h>
+#include <Mqtt_Utility.h>
+
+#define FW_VERSION "2.13"  // Version in the src/main.cpp header, published as the device sw_version
+#define DEVICE_NAME "GreenA"
+#define DEVICE_ID "greenA"
+
+// Moisture probes as X(id, pin) in order, up to 7. Builds the sensor table and its discovery configs
+#define MST_PROBES(X) \
+  X("1", A0) \
+  X("2", A1) \
+  X("3", A2) \
+  X("4", A3) \
+  X("5", A4)
+  // X("6", A5)
+  // X("7", A6)
+#define SHT31_ENABLED
+#define SI1151_ENABLED
+
+const uint16_t sensorTimeout = 3600;
+const mdev_info device = MQTTU_DEVICE(DEVICE_NAME, DEVICE_ID, "MKR1010 Indoor Plant Monitor", FW_VERSION);
+
+// Moisture sensor discovery config, id matches the probe id in MST_PROBES
+#define MST_DEV(id, pin) { "moisture", sensorTimeout, DEVICE_NAME " Soil Moisture", MQTTU_STATE_TOPIC(DEVICE_ID), DEVICE_ID "soil" id, "%", \
+  MQTTU_VALUE_TEMPLATE("smst" id, ""), MQTTU_CONFIG_TOPIC(DEVICE_ID "mst" id) },
+
+// Homeassistant sensor device classes: https://www.home-assistant.io/integrations/sensor/#device-class
+const mdev discovery[] = {  // expires_after is replaced by the configured sensor timeout when published
+  MST_PROBES(MST_DEV)
+  #ifdef SHT31_ENABLED
+  MQTTU_SENSOR_AVTY(DEVICE_NAME, DEVICE_ID, "Air Temperature", "temp", "temperature", "°C", " | round(1)", sensorTimeout, "sht"),
+  MQTTU_SENSOR_AVTY(DEVICE_NAME, DEVICE_ID, "Air Humidity", "humi", "humidity", "%", " | round(1)", sensorTimeout, "sht"),
+  #endif
+  #ifdef SI1151_ENABLED
+  MQTTU_SENSOR_AVTY(DEVICE_NAME, DEVICE_ID, "Sunlight", "sun", "illuminance", "lx", "", sensorTimeout, "sun"),
+  #endif
+  #ifdef MQTTU_LOW_POWER
+  MQTTU_SENSOR(DEVICE_NAME, DEVICE_ID, "Average Current", "icur", "current", "mA", " | round(2)", sensorTimeout),
+  #endif
+  #ifdef MQTTU_DIAGNOSTICS
+  MQTTU_DIAGNOSTIC_SENSORS(DEVICE_NAME, DEVICE_ID, sensorTimeout),
+  #endif
+};
+
+#endif  // DISCOVERY_TABLE_H
@@ -4,15 +4,36 @@
   File: local_utils.h
 */
 
+#ifndef LOCAL_UTILS_H
+#define LOCAL_UTILS_H
+
+#include <Arduino.h>
+#include <Sensor_Convert.h>
+
+// Fields read every sampling round first, ids point to string literals kept in flash
 typedef struct moisture_sensor {
-  uint8_t pin;
-  short val;
   long sum;
+  short val;          // Tenths of a percent
   short base;
   short cap;
-  // bool capacitive;
-  char id[10];
-  char val_id[20];
+  uint8_t pin;
+  const char* id;
+  const char* val_id;
+  FixedScale scale;   // Averaged reading to val, set with setCalibration()
 } mst_sen;
 
-typedef mst_sen mst_sen_arr[];
+/**
+ * Static table entry for one probe. id is a string literal, e.g. MST_SENSOR("1", A0) has the key "smst1"
+*/
+#define MST_SENSOR(id, pin) { 0, 0, 0, 0, pin, id, "smst" id },
+
+/**
+ * Set calibration, the conversion to 0.0 % at base (dry) .. 100.0 % at cap (wet) is precomputed here
+*/
+inline void setCalibration(mst_sen& sensor, short base, short cap) {
+  sensor.base = base;
+  sensor.cap = cap;
+  sensor.scale.set(base, cap, 0, 1000);
+}
+
+#endif  // LOCAL_UTILS_H
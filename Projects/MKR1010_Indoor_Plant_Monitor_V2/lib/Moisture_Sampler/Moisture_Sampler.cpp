@@ -0,0 +1,249 @@
+/*
+  Author: Ilari Mattsson
+  Library: Moisture Sampler
+  File: Moisture_Sampler.cpp
+  Version: 1.1
+*/
+
+#include "Moisture_Sampler.h"
+#include <Arduino.h>
+
+#ifdef MST_USE_DMA
+#include "wiring_private.h"
+
+static DmacDescriptor _dmaDescriptors[MST_DMA_CHANNEL + 1] __attribute__((aligned(16)));
+static DmacDescriptor _dmaWriteback[MST_DMA_CHANNEL + 1] __attribute__((aligned(16)));
+static volatile uint16_t _dmaBuffer[MST_DMA_BUFFER_SIZE];
+
+static inline void syncAdc() {
+  while (ADC->STATUS.bit.SYNCBUSY);
+}
+#endif
+
+
+MoistureSampler::MoistureSampler():
+  _sensors(NULL),
+  _count(0),
+  _rounds(1),
+  _taken(0),
+  _shift(0),
+  _running(false),
+  _ready(false)
+  #ifdef MST_USE_DMA
+  , _scanFirst(0),
+  _scanLen(0)
+  #endif
+  {
+}
+
+// ================================ Class public methods ========================================
+
+void MoistureSampler::begin(mst_sen* sensors, int count, uint16_t rounds) {
+  _sensors = sensors;
+  _count = count;
+  _rounds = rounds > 0 ? rounds : 1;
+  _taken = 0;
+  _running = false;
+  _ready = false;
+
+  #ifdef MST_USE_DMA
+  dmaInit();
+  #endif
+
+  // Batch length is fixed from here, reduce() converts the sums without dividing
+  for (int i = 0; i < _count; i++) {
+    _sensors[i].scale.setCount(_rounds);
+  }
+}
+
+void MoistureSampler::setHardwareAveraging(uint16_t samples) {
+  #if defined(ARDUINO_ARCH_SAMD)
+  uint8_t n = 0;
+  while ((1u << (n + 1)) <= samples && n < 10) n++;
+
+  // Averaged result is sum >> ADJRES: 12 bits up to 16 samples, one extra bit per doubling above
+  uint8_t adjres = n < 4 ? n : 4;
+  _shift = 2 + (n - adjres);
+
+  while (ADC->STATUS.bit.SYNCBUSY);
+  ADC->AVGCTRL.reg = ADC_AVGCTRL_SAMPLENUM(n) | ADC_AVGCTRL_ADJRES(adjres);
+  while (ADC->STATUS.bit.SYNCBUSY);
+  if (n > 0) {
+    ADC->CTRLB.bit.RESSEL = ADC_CTRLB_RESSEL_16BIT_Val;
+  } else {
+    ADC->CTRLB.bit.RESSEL = ADC_CTRLB_RESSEL_10BIT_Val;
+    _shift = 0;
+  }
+  while (ADC->STATUS.bit.SYNCBUSY);
+  #else
+  (void)samples;
+  #endif
+}
+
+void MoistureSampler::start() {
+  for (int i = 0; i < _count; i++) {
+    _sensors[i].sum = 0;
+  }
+  _taken = 0;
+  _running = (_count > 0);
+  _ready = false;
+
+  #ifdef MST_USE_DMA
+  if (_running) dmaStart();
+  #endif
+}
+
+bool MoistureSampler::tick() {
+  if (!_running) return _ready;
+
+  #ifdef MST_USE_DMA
+  if (!dmaDone()) return false;
+  dmaStop();
+  dmaReduce();
+  _running = false;
+  _ready = true;
+  return true;
+  #endif
+
+  for (int k = 0; k < _count; k++) {
+    // Constrain values within calibrated range.
+    int raw = read(_sensors[k].pin);
+    _sensors[k].sum += constrain(raw, _sensors[k].cap, _sensors[k].base);
+  }
+
+  if (++_taken >= _rounds) {
+    _running = false;
+    _ready = true;
+  }
+  return _ready;
+}
+
+bool MoistureSampler::reduce() {
+  if (!_ready) return false;
+
+  for (int k = 0; k < _count; k++) {
+    _sensors[k].val = _sensors[k].scale.applyMean(_sensors[k].sum);
+  }
+  _ready = false;
+  return true;
+}
+
+int MoistureSampler::read(uint8_t pin) {
+  return analogRead(pin) >> _shift;
+}
+
+bool MoistureSampler::isRunning() const {
+  return _running;
+}
+
+bool MoistureSampler::isReady() const {
+  return _ready;
+}
+
+// ================================ Class private methods =======================================
+
+#ifdef MST_USE_DMA
+/**
+ * Find the ADC input range covering all probes and set up DMAC memory.
+ * The ADC scans consecutive inputs, e.g. MKR 1010 A0..A6 map to AIN0, AIN10, AIN11, AIN4..AIN7,
+ * so the scan covers AIN0..AIN11 and unused inputs are discarded in dmaReduce().
+*/
+void MoistureSampler::dmaInit() {
+  uint8_t first = 0xFF, last = 0;
+  for (int k = 0; k < _count; k++) {
+    uint8_t pin = _sensors[k].pin;
+    if (pin < A0) pin += A0;
+    pinPeripheral(pin, PIO_ANALOG);
+    if (g_APinDescription[pin].ulADCChannelNumber == No_ADC_Channel) continue;
+    uint8_t ch = g_APinDescription[pin].ulADCChannelNumber;
+    if (ch < first) first = ch;
+    if (ch > last) last = ch;
+  }
+  if (first > last) {
+    _count = 0;
+    return;
+  }
+  _scanFirst = first;
+  _scanLen = last - first + 1;
+
+  // First scan after enabling the ADC is discarded
+  uint16_t maxRounds = MST_DMA_BUFFER_SIZE / _scanLen - 1;
+  if (_rounds > maxRounds) _rounds = maxRounds;
+
+  PM->AHBMASK.reg |= PM_AHBMASK_DMAC;
+  PM->APBBMASK.reg |= PM_APBBMASK_DMAC;
+  DMAC->CTRL.reg = 0;
+  DMAC->BASEADDR.reg = (uint32_t)_dmaDescriptors;
+  DMAC->WRBADDR.reg = (uint32_t)_dmaWriteback;
+  DMAC->CTRL.reg = DMAC_CTRL_DMAENABLE | DMAC_CTRL_LVLEN(0xF);
+}
+
+void MoistureSampler::dmaStart() {
+  uint16_t beats = (_rounds + 1) * _scanLen;
+  DmacDescriptor& desc = _dmaDescriptors[MST_DMA_CHANNEL];
+  desc.BTCTRL.reg = DMAC_BTCTRL_VALID | DMAC_BTCTRL_BEATSIZE_HWORD | DMAC_BTCTRL_DSTINC | DMAC_BTCTRL_BLOCKACT_NOACT;
+  desc.BTCNT.reg = beats;
+  desc.SRCADDR.reg = (uint32_t)&ADC->RESULT.reg;
+  desc.DSTADDR.reg = (uint32_t)(_dmaBuffer + beats);  // Incrementing address points to block end
+  desc.DESCADDR.reg = 0;
+
+  DMAC->CHID.reg = DMAC_CHID_ID(MST_DMA_CHANNEL);
+  DMAC->CHCTRLA.reg &= ~DMAC_CHCTRLA_ENABLE;
+  DMAC->CHCTRLA.reg = DMAC_CHCTRLA_SWRST;
+  DMAC->CHCTRLB.reg = DMAC_CHCTRLB_LVL(0) | DMAC_CHCTRLB_TRIGSRC(ADC_DMAC_ID_RESRDY) | DMAC_CHCTRLB_TRIGACT_BEAT;
+  DMAC->CHINTFLAG.reg = DMAC_CHINTFLAG_MASK;
+  DMAC->CHCTRLA.reg |= DMAC_CHCTRLA_ENABLE;
+
+  // Free running input scan over the probe range
+  syncAdc();
+  ADC->CTRLA.bit.ENABLE = 0;
+  syncAdc();
+  ADC->INPUTCTRL.bit.MUXPOS = _scanFirst;
+  ADC->INPUTCTRL.bit.INPUTSCAN = _scanLen - 1;
+  ADC->INPUTCTRL.bit.INPUTOFFSET = 0;
+  syncAdc();
+  ADC->CTRLB.bit.FREERUN = 1;
+  ADC->INTFLAG.reg = ADC_INTFLAG_RESRDY;
+  syncAdc();
+  ADC->CTRLA.bit.ENABLE = 1;
+  syncAdc();
+  ADC->SWTRIG.bit.START = 1;
+}
+
+bool MoistureSampler::dmaDone() {
+  DMAC->CHID.reg = DMAC_CHID_ID(MST_DMA_CHANNEL);
+  return DMAC->CHINTFLAG.bit.TCMPL;
+}
+
+/**
+ * Stop the scan and restore single conversion settings used by analogRead().
+*/
+void MoistureSampler::dmaStop() {
+  syncAdc();
+  ADC->CTRLA.bit.ENABLE = 0;
+  syncAdc();
+  ADC->CTRLB.bit.FREERUN = 0;
+  syncAdc();
+  ADC->INPUTCTRL.bit.INPUTSCAN = 0;
+  syncAdc();
+
+  DMAC->CHID.reg = DMAC_CHID_ID(MST_DMA_CHANNEL);
+  DMAC->CHCTRLA.reg &= ~DMAC_CHCTRLA_ENABLE;
+  DMAC->CHINTFLAG.reg = DMAC_CHINTFLAG_MASK;
+}
+
+void MoistureSampler::dmaReduce() {
+  for (int k = 0; k < _count; k++) {
+    uint8_t pin = _sensors[k].pin;
+    if (pin < A0) pin += A0;
+    // Not in the scan, see dmaInit()
+    if (g_APinDescription[pin].ulADCChannelNumber == No_ADC_Channel) continue;
+    uint8_t idx = (uint8_t)g_APinDescription[pin].ulADCChannelNumber - _scanFirst;
+    for (uint16_t r = 1; r <= _rounds; r++) {
+      int raw = _dmaBuffer[r * _scanLen + idx] >> _shift;
+      _sensors[k].sum += constrain(raw, _sensors[k].cap, _sensors[k].base);
+    }
+  }
+  _taken = _rounds;
+}
+#endif  // MST_USE_DMA
@@ -0,0 +1,111 @@
+/*
+  Incremental soil moisture sampler for the plant monitor.
+  Spreads a measurement batch over several scheduler ticks instead of blocking
+  loop() with delay() between samples. Each tick() takes one reading per sensor.
+
+  > Implements:
+    - Batches of N rounds, one round per tick(), summed into mst_sen.sum
+    - Readings constrained within the calibrated range (cap..base)
+    - SAMD21 ADC hardware averaging (AVGCTRL), results scaled back to 10 bits
+    - Single read path shared by sampling and calibration
+    - Optional DMA backend (build flag MST_ADC_DMA, SAMD21 only): the ADC scans all probe
+      channels in free running mode and DMA stores every result, tick() only polls for completion
+
+  Author: Ilari Mattsson
+  Library: Moisture Sampler
+  File: Moisture_Sampler.h
+  Version: 1.0
+*/
+
+#ifndef MOISTURE_SAMPLER_H
+#define MOISTURE_SAMPLER_H
+
+#include <Arduino.h>
+#include "local_utils.h"
+
+#define MOISTURE_SAMPLER_VERSION "1.1"
+
+#if defined(MST_ADC_DMA) && defined(ARDUINO_ARCH_SAMD)
+#define MST_USE_DMA
+#endif
+
+#ifndef MST_DMA_CHANNEL
+#define MST_DMA_CHANNEL 0         // DMAC channel, the sampler owns the DMAC descriptor base
+#endif
+
+#ifndef MST_DMA_BUFFER_SIZE
+#define MST_DMA_BUFFER_SIZE 1024  // ADC results (uint16_t) per DMA batch
+#endif
+
+class MoistureSampler {
+public:
+  MoistureSampler();
+
+  /**
+   * Set sensor array and batch length, the batch length is set as the count of each sensor's scale.
+   * params:
+   *   mst_sen* sensors: moisture sensor array, calibration values must be set before sampling
+   *   int count: number of sensors in the array
+   *   uint16_t rounds: readings per sensor in one batch.
+   *     With MST_ADC_DMA limited to MST_DMA_BUFFER_SIZE / scanned channels - 1.
+   */
+  void begin(mst_sen* sensors, int count, uint16_t rounds);
+
+  /**
+   * Enable ADC hardware averaging, SAMD21 only. Must be called after analogReadResolution(10),
+   * which resets the ADC result resolution. Ignored on other architectures.
+   * params: uint16_t samples: conversions averaged per reading, power of two 1..1024 (1 = off)
+   */
+  void setHardwareAveraging(uint16_t samples);
+
+  /**
+   * Reset sensor sums and start a new batch. A batch already in progress is restarted.
+   */
+  void start();
+
+  /**
+   * Take one reading per sensor if a batch is running. With MST_ADC_DMA only checks whether
+   * the DMA transfer has completed and sums the buffered scans.
+   * returns: bool: true when the batch has completed
+   */
+  bool tick();
+
+  /**
+   * Convert completed batch averages to moisture in tenths of a percent (mst_sen.val) with the
+   * fixed-point scale precomputed by setCalibration() and begin(). The sums are scaled for the batch
+   * length without dividing, the fraction of the averaged ADC count carries into val.
+   * returns: bool: true if a completed batch was reduced, false if values were left unchanged
+   */
+  bool reduce();
+
+  /**
+   * Read one sensor pin at 10-bit scale, hardware averaged if enabled.
+   * params: uint8_t pin: analog pin
+   * returns: int: reading 0..1023
+   */
+  int read(uint8_t pin);
+
+  bool isRunning() const;
+  bool isReady() const;
+
+private:
+  mst_sen* _sensors;
+  int _count;
+  uint16_t _rounds;
+  uint16_t _taken;
+  uint8_t _shift;     // Right shift from averaged ADC result to 10 bits
+  bool _running;
+  bool _ready;
+
+  #ifdef MST_USE_DMA
+  uint8_t _scanFirst; // First ADC input (AINx) of the scan
+  uint8_t _scanLen;   // Consecutive inputs scanned, includes unused inputs between probes
+  void dmaInit();
+  void dmaStart();
+  bool dmaDone();
+  void dmaStop();
+  void dmaReduce();
+  #endif
+};
+
+#endif  // MOISTURE_SAMPLER_H
@@ -10,6 +10,51 @@
   - ADDED Si1151 Sunlight sensor
   - Included iterative general improvements from Nano IoT Indoor Air Monitor project
   - Included updated mqttUtility library module
+  Changes in V2.1:
+  - SHT31 and Si1151 reads are bounded by SENSOR_TIMEOUT, last good values are kept
+  - Per sensor availability is published on the availability topic
+  - Optional hardware watchdog (SENSORS_WATCHDOG)
+  Changes in V2.2:
+  - SHT31 and Si1151 start-up is retried with backoff, the node runs without a sensor that does not start
+  - Boot continues without WiFi/MQTT, discovery is configured on the first connection
+  - Watchdog resets are counted per boot stage, a stage that keeps crashing is skipped (SENSORS_WATCHDOG)
+  - Reset reason and crash count are published on the availability topic
+  Changes in V2.3:
+  - Sensors are sampled every loopInterval, a report is published when a value crosses its deadband
+    or when heartbeat has elapsed since the last report
+  - Reports carry min/mean/max of the air and light samples since the previous report under "stats"
+  Changes in V2.4:
+  - loopInterval, heartbeat, sensor timeout, moisture sampling rounds and SHT31 offsets can be changed with a
+    JSON document on the command topic, e.g. {"interval": 120, "rounds": 20}. Changes apply live and are saved to flash
+  Changes in V2.5:
+  - State payloads are set in a static StateFrame and serialized once by Mqtt_Utility, sendData()
+    no longer measures, serializes and copies a JsonDocument
+  Changes in V2.6:
+  - SHT31 and Si1151 are driver policies in a SensorSet (common/libraries/Sensors)
+  - SHT31 is read with one measurement for both values
+  - Humidity is published as "humi", the key used by its discovery value template
+  Changes in V2.7:
+  - Moisture probes are listed in MST_PROBES, the sensor table and its discovery configs are generated
+    from it at compile time. No malloc or VLA in setup(), ids and payload keys are string literals in flash
+  Changes in V2.8:
+  - Connects under the device id with a persistent MQTT session, a dropped broker connection recovers with
+    one CONNECT when the broker answers the first attempt. Commands sent while offline are queued (QoS 1)
+  Changes in V2.9:
+  - State and backfill messages are published at QoS 1. A reading that is neither published nor buffered
+    for backfill leaves the report gate due and is reported again at the next sample
+  Changes in V2.10:
+  - S_SSID_2 in arduino_secrets.h adds a second network, the stronger one is joined from a scan. A weak
+    link (MQTTU_ROAM_RSSI) is re-evaluated every few minutes and the node moves to a clearly stronger network
+  Changes in V2.11:
+  - Moisture calibration is precomputed into a fixed-point scale (Sensor_Convert.h), batches are converted
+    with one multiply instead of map(). Moisture is published with one decimal, e.g. "smst1": 43.5
+  Changes in V2.12:
+  - Optional BLE gateway (BLE_RELAY_GATEWAY, common/libraries/Ble_Relay): nearby leaf nodes send their readings
+    over BLE, the gateway publishes them on the leaves' state topics through its own MQTT connection.
+    NINA runs BLE or WiFi at a time, the gateway alternates listen and online windows
+  Changes in V2.13:
+  - Optional firmware updates over MQTT (MQTTU_OTA, common/scripts/ota_send.py). The image is streamed into
+    the upper flash half and applied after its CRC checks, sampling and reports pause during the download
 
   Board(s):
     - Arduino MKR WiFi 1010
@@ -23,32 +68,39 @@
   Author: Ilari Mattsson
   Project MKR1010_Indoor_Plant_Monitor_V2
   File: main.cpp
-  Version: 2.0
+  Version: 2.13
 */
 
 #include <Arduino.h>
 #include <ArduinoJson.h>
 #include <ArduinoMqttClient.h>
-#include "Adafruit_SHT31.h"
-#include "Si115X.h"
 #include <WiFiNINA.h>
 #include <utility/wifi_drv.h>
 #include "arduino_secrets.h"
 #include "local_utils.h"
 #include <Mqtt_Utility.h>
+#include "discovery_table.h"
+#include <Task_Scheduler.h>
+#include <Moisture_Sampler.h>
+#include <Calibration_Store.h>
+#include <Sensor_Set.h>
+#include <drivers/adafruit_sht31_sensor.h>
+#include <drivers/si1151_sensor.h>
+#include <Supervisor.h>
+#include <Node_Config.h>
+#ifdef BLE_RELAY_GATEWAY
+#include <Ble_Relay.h>
+#endif
+
+#if defined(BLE_RELAY_GATEWAY) && defined(MQTTU_LOW_POWER)
+#error "BLE_RELAY_GATEWAY listens for leaf nodes continuously, it cannot be combined with MQTTU_LOW_POWER"
+#endif
 
 // ------- Globals ------------
 // > Macros
-#define MST_PIN_1 A0
-#define MST_PIN_2 A1
-#define MST_PIN_3 A2
-#define MST_PIN_4 A3
-#define MST_PIN_5 A4
-// #define MST_PIN_6 A5
-// #define MST_PIN_7 A6
-#define SHT31_ENABLED
-#define SI1151_ENABLED
+// FW_VERSION, device identity, moisture probes (MST_PROBES) and fitted sensors are set in discovery_table.h
 #define CASE_LED LED_BUILTIN
+// #define DEVICE_DISCOVERY  // Single device-based discovery message, remove old per-sensor configs from the broker first
 #define TOUCH_PIN (uint8_t)2u
 
 // Built-in RGB LED pins (MKR 1010 WiFi ONLY)
@@ -58,28 +110,73 @@
 
 // > Configuration
 const bool isCapacitive = true;
-const uint32_t loopInterval = 300000;
-uint32_t loopPrevious = 0;
+#ifdef MQTTU_LOW_POWER
+const uint32_t loopInterval = 300000;  // Sampling period, every wake reconnects WiFi so sample at the heartbeat
+#else
+const uint32_t loopInterval = 60000;   // Sampling period
+#endif
+const uint32_t heartbeat = 300000;     // Longest time between reports while readings stay within their deadbands
+const uint32_t sampleLead = 5000;  // Start sampling this many ms before publishing
+#ifdef MQTTU_LOW_POWER
+const uint32_t wakeLead = 10000;   // Wake up this many ms before sampling to reconnect
+const uint32_t sleepMin = 30000;   // Stay awake if the board would sleep less than this
+#endif
+const uint32_t pollInterval = 10;
+const uint32_t ledInterval = 500;
+const uint32_t mstInterval = 100;  // ms between moisture sampling rounds
+#ifdef MST_ADC_DMA
+const uint16_t mstRounds = 64;     // DMA scans cost no CPU time, oversample more
+#else
+const uint16_t mstRounds = 10;     // Sampling rounds per batch, must fit within sampleLead
+#endif
+const uint16_t mstHwSamples = 4;   // ADC hardware averaged conversions per reading (SAMD21)
 bool isRGBSet = false;
-const uint16_t sensorTimeout = 3600;
+const uint32_t calTouchWindow = 3000;    // Touch within this many ms of boot to recalibrate
+const uint32_t calTouchTimeout = 60000;  // Recalibration over MQTT is aborted without a touch in time
+// > Reporting deadbands, a change this large since the last report is published immediately
+const int16_t mstDeadband = 50;          // Tenths of a percent, the unit of mst_sen.val
+const float tempDeadband = 0.5, humDeadband = 3;
+const float sunDeadband = 0;             // Light changes all day, heartbeat only
+// > Runtime configuration, the constants above are defaults for a config document on the command topic
+const node_cfg configDefaults = { loopInterval, heartbeat, sensorTimeout, mstRounds, 0, 0 };
+NodeConfig nodeConfig(configDefaults);
+bool isRoundsChanged = false;
 
 // > Sensors
-mst_sen_arr* mstArray;
-int mstArraySize;
-
-#ifdef SI1151_ENABLED
-Si115X si1151;
-uint16_t sun;
-#endif  // SI1151_ENABLED
+mst_sen mstArray[] = { MST_PROBES(MST_SENSOR) };  // Static, keys point to literals in flash
+constexpr int mstArraySize = sizeof(mstArray) / sizeof(mstArray[0]);
+static_assert(mstArraySize > 0 && mstArraySize <= 7, "MST_PROBES must list 1..7 probes");
+MoistureSampler mstSampler;
+int8_t mstTaskId;
+CalibrationStore calStore;
+bool isCalRequested = false;
+bool isDiscoveryRequested = false;
+ReportGate reportGate(heartbeat);
+StateFrame stateFrame;  // State payload, rendered once per report
+int8_t mstFirstChannel;  // Moisture sensors take consecutive channels in mstArray order
 
 #ifdef SHT31_ENABLED
-Adafruit_SHT31 sht = Adafruit_SHT31();
-float temp, hum;
+typedef AdafruitSht31Sensor<> ShtSensor;
+#else
+typedef NoSensor ShtSensor;
 #endif  // SHT31_ENABLED
+#ifdef SI1151_ENABLED
+typedef Si1151Sensor SunSensor;
+#else
+typedef NoSensor SunSensor;
+#endif  // SI1151_ENABLED
+SensorSet<ShtSensor, SunSensor> sensors;
 
 // > Secrets (arduino_secrets.h)
 char ssid[] = S_SSID;
 char psk[] = S_PASS;
+// The strongest network in range is joined, S_SSID_2 is e.g. a repeater with its own SSID
+const wifi_cred networks[] = {
+  { ssid, psk },
+  #ifdef S_SSID_2
+  { S_SSID_2, S_PASS_2 },
+  #endif
+};
 char host[] = S_MQTT_ADDR;
 uint16_t port = S_MQTT_PORT;
 char user[] = S_MQTT_USER;
@@ -89,20 +186,54 @@ char pass[] = S_MQTT_PASS;
 WiFiClient wifiClient;
 //WiFiSSLClient wifiClient;
 MqttUtility mqttUtility(wifiClient);
+#ifdef BLE_RELAY_GATEWAY
+BleRelayGateway relay(mqttUtility);  // Starts and ends mqttUtility between its BLE listen windows
+#endif
+TaskScheduler scheduler;
+int8_t sampleTaskId, publishTaskId;
+Supervisor supervisor;
+bool isConfigured = false;  // Discovery sent, deferred until the first connection
+
+// > Boot stages, a stage that crashes SUPERVISOR_MAX_CRASHES boots in a row is skipped
+enum bootStage { STAGE_SHT = 1, STAGE_SUN };
 
 // > Sensor const variables
-const char stateTopic[] = "homeassistant/sensor/greenA/state";
-const char deviceName[] = "GreenA";
-const char deviceNameLower[] = "greenA";
+const char stateTopic[] = MQTTU_STATE_TOPIC(DEVICE_ID);
+const char commandTopic[] = MQTTU_COMMAND_TOPIC(DEVICE_ID);
+const char availabilityTopic[] = MQTTU_AVAILABILITY_TOPIC(DEVICE_ID);
+const char backfillTopic[] = MQTTU_BACKFILL_TOPIC(DEVICE_ID);  // Readings missed while offline
+const char packedTopic[] = MQTTU_PACKED_TOPIC(DEVICE_ID);
+const char diagTopic[] = MQTTU_DIAGNOSTICS_TOPIC(DEVICE_ID);
+const char otaTopic[] = MQTTU_OTA_TOPIC(DEVICE_ID);
+const char otaStatusTopic[] = MQTTU_OTA_STATUS_TOPIC(DEVICE_ID);
 
 
 // Function declarations
 void measureData();
 void sendData();
+void sendAvailability();
+void pollTask();
+void sampleTask();
+void publishTask();
+void mstTask();
+void ledTask();
+void sleepCycle();
 int calMoisture(uint8_t pin, bool calCapacitive, bool calBase);
+bool calibrate(uint32_t touchTimeout);
+bool waitTouch(uint32_t timeout);
+bool loadCalibration();
+void saveCalibration();
+void onCommand(const char* payload, size_t length);
+void configureDiscovery();
+void onConfig(JsonObjectConst config);
+void onOta(util_ota_state state);
+void applyConfig(uint8_t changed);
+uint16_t mstRoundsLimit(uint16_t rounds);
 void rgbLed(uint8_t r, uint8_t g, uint8_t b);
 
 void setup() {
+  supervisor.begin();
+  nodeConfig.load();
   analogReadResolution(10);
   pinMode(CASE_LED, OUTPUT);
   pinMode(TOUCH_PIN, INPUT);
@@ -111,192 +242,216 @@ void setup() {
 
   // Initialize WiFi & MQTT
   //
-  mqttUtility.setWiFiNetwork(ssid, psk);
+  mqttUtility.setWiFiNetworks(networks, sizeof(networks) / sizeof(networks[0]));
   mqttUtility.setMqttHost(host, port);
-  mqttUtility.setWifiRetry(5);
+  mqttUtility.setWifiRetry(5);  // Then WiFi off for MQTTU_RETRY_REST, a new round follows
+  mqttUtility.setBackfillTopic(backfillTopic);
+  mqttUtility.setAvailabilityTopic(availabilityTopic);
+  #ifdef MQTTU_PACKED_STATE  // Also publish state payloads as MessagePack, JSON topic is kept
+  mqttUtility.setPackedTopic(packedTopic);
+  #endif
+  #ifdef MQTTU_DIAGNOSTICS
+  mqttUtility.setDiagnosticsTopic(diagTopic);
+  #endif
   if (strlen(user) > 0 && strlen(pass) > 0) {
     mqttUtility.setMqttUser(user, pass);
     delay(50);
   }
-  if(mqttUtility.begin() != CONN_CONNECTED) {
-    rgbLed(100,0,0);
-    while(1) {
-      digitalWrite(CASE_LED, LOW);
-      delay(1000);
-      digitalWrite(CASE_LED, HIGH);
-      delay(1000);
-    }
-  }
+  mqttUtility.setPersistentSession(DEVICE_ID);  // Fast reconnects, the broker keeps the subscription
+  mqttUtility.setTopicQos(stateTopic, 1);  // Readings count as published once the broker has acknowledged them
+  mqttUtility.setTopicQos(backfillTopic, 1);
+  #ifndef BLE_RELAY_GATEWAY
+  // Connect in the background, readings are buffered for backfill until connected
+  mqttUtility.start();
+  #endif
+  mqttUtility.setCommandCallback(commandTopic, onCommand);
+  mqttUtility.setConfigCallback(commandTopic, onConfig);
+  #ifdef MQTTU_OTA
+  mqttUtility.setOtaTopics(otaTopic, otaStatusTopic, onOta);
+  #endif
   delay(50);
 
-  // Generate and configure moisture sensor array
+  // Configure moisture sensor array
   //
-  makeSenArray();
-  delay(50);
-
-  int redMax, grnMax, bluMax;
-  // Calibration - Base(Dry)
-  rgbLed(100, 50, 0);
-  redMax = 140, grnMax = 70, bluMax = 0;
-  while(digitalRead(TOUCH_PIN) != HIGH);
-  for (int i = 0; i < mstArraySize; i++){
-    rgbLed(redMax*(i+1)/mstArraySize, grnMax*(i+1)/mstArraySize, bluMax*(i+1)/mstArraySize);
-    (*mstArray)[i].base = calMoisture((*mstArray)[i].pin, isCapacitive, true);
-    delay(100);
+  mstSampler.begin(mstArray, mstArraySize, mstRoundsLimit(nodeConfig.get().rounds));
+  mstSampler.setHardwareAveraging(mstHwSamples);
+  // Moisture changes slowly, only its deadband is tracked to keep the payload short.
+  // The channels take the integer tenths as is, no conversion per reduced batch
+  for (int i = 0; i < mstArraySize; i++) {
+    int8_t channel = reportGate.addChannel(mstArray[i].val_id, mstDeadband, false);
+    if (i == 0) mstFirstChannel = channel;
   }
   delay(50);
-  rgbLed(0, 100, 0);
-  delay(2000);
-  rgbLed(0, 0, 0);
-  delay(50);
 
-  // Calibration - Cap(Wet)
-  rgbLed(0, 100, 100);
-  redMax = 0, grnMax = 140, bluMax = 140;
-  while(digitalRead(TOUCH_PIN) != HIGH);
-  for (int i = 0; i < mstArraySize; i++){
-    rgbLed(redMax*(i+1)/mstArraySize, grnMax*(i+1)/mstArraySize, bluMax*(i+1)/mstArraySize);
-    (*mstArray)[i].cap = calMoisture((*mstArray)[i].pin, isCapacitive, false);
-    delay(100);
-  }
-  delay(50);
-  rgbLed(0, 100, 0);
-  delay(2000);
+  // Load calibration from flash, calibrate if none is stored or touch pin is touched during boot
+  //
+  rgbLed(0, 0, 100);
+  if (!loadCalibration() || waitTouch(calTouchWindow)) calibrate(0);
   rgbLed(0, 0, 0);
   delay(50);
 
-  for (int i = 0; i < mstArraySize; i++){
-
-    String name = String(deviceName) + " Soil Moisture";
-    String uid = String(deviceNameLower) + "soil" + (*mstArray)[i].id;
-    String valTpl = "{{ value_json." + String((*mstArray)[i].val_id) + " }}";
-    String confTopic = "homeassistant/sensor/" + String(deviceNameLower) + "mst" + (*mstArray)[i].id + "/config";
-
-    mdevs mstDev = { "moisture", sensorTimeout, name, String(stateTopic), uid, "%", valTpl, confTopic };
-    mqttUtility.configureTopic(&mstDev);
-  }
-  delay(50);
-
-  // Initialize and configure SHT31
+  // Initialize SHT31, continue without it if it does not start
   //
   #ifdef SHT31_ENABLED
-  if(!sht.begin(SHT31_DEFAULT_ADDR)){
-    rgbLed(100,50,0);
-    while(1);
-  }
-  String shtTempName = String(deviceName) + " Air Temperature"; 
-  String shtTempUid = String(deviceNameLower) + "temp";
-  String shtTempValTpl = "{{ value_json.temp | round(1) }}";
-  String shtTempConfTopic = "homeassistant/sensor/" + String(deviceNameLower) + "temp/config";
-
-  mdevs shtTempDev = {"temperature", sensorTimeout, shtTempName, String(stateTopic), shtTempUid, "°C", shtTempValTpl, shtTempConfTopic};
-  mqttUtility.configureTopic(&shtTempDev);
-
-  String shtHumiName = String(deviceName) + " Air Humidity"; 
-  String shtHumiUid = String(deviceNameLower) + "humi";
-  String shtHumiValTpl = "{{ value_json.humi | round(1) }}";
-  String shtHumiConfTopic = "homeassistant/sensor/" + String(deviceNameLower) + "humi/config";
-
-  mdevs shtHumiDev = {"humidity", sensorTimeout, shtHumiName, String(stateTopic), shtHumiUid, "%", shtHumiValTpl, shtHumiConfTopic};
-  mqttUtility.configureTopic(&shtHumiDev);
+  supervisor.setStage(STAGE_SHT);
+  if (!supervisor.isSuspect(STAGE_SHT)) supervisor.retry([]() { return sensors.begin<ShtSensor>(); });
+  if (!sensors.isEnabled<ShtSensor>()) rgbLed(100,50,0);
+  sensors.get<ShtSensor>().setKeys("temp", "humi");  // Keys of the discovery value templates
+  reportGate.addChannel("temp", tempDeadband);  // Sensors emit into the channels by key
+  reportGate.addChannel("humi", humDeadband);
   delay(50);
   #endif // SHT31_ENABLED
 
-  // Initialize and configure Si1151
+  // Initialize Si1151, continue without it if it does not start
   //
   #ifdef SI1151_ENABLED
-  if(!si1151.Begin()){
-    rgbLed(100,0,50);
-    while(1);
-  }
-  String siSunName = String(deviceName) + " Sunlight"; 
-  String siSunUid = String(deviceNameLower) + "sun";
-  String siSunValTpl = "{{ value_json.sun }}";
-  String siSunConfTopic = "homeassistant/sensor/" + String(deviceNameLower) + "sun/config";
-
-  mdevs siSunDev = {"illuminance", sensorTimeout, siSunName, String(stateTopic), siSunUid, "lx", siSunValTpl, siSunConfTopic};
-  mqttUtility.configureTopic(&siSunDev);
+  supervisor.setStage(STAGE_SUN);
+  if (!supervisor.isSuspect(STAGE_SUN)) supervisor.retry([]() { return sensors.begin<SunSensor>(); });
+  if (!sensors.isEnabled<SunSensor>()) rgbLed(100,0,50);
+  reportGate.addChannel("sun", sunDeadband);
   delay(50);
   #endif // SI115_ENABLED
+  supervisor.setStage(SUPERVISOR_STAGE_RUN);
+  applyConfig(NODE_CFG_HEARTBEAT | NODE_CFG_TIMEOUT | NODE_CFG_OFFSETS);
+
+  // Schedule tasks
+  //
+  scheduler.addTask(pollTask, pollInterval);
+  uint32_t period = nodeConfig.get().interval;
+  sampleTaskId = scheduler.addTask(sampleTask, period, period - sampleLead);
+  publishTaskId = scheduler.addTask(publishTask, period, period);
+  mstTaskId = scheduler.addTask(mstTask, mstInterval);
+  scheduler.setEnabled(mstTaskId, false);
+  scheduler.addTask(ledTask, ledInterval);
+
+  #ifdef BLE_RELAY_GATEWAY
+  // Listen first, WiFi comes up in the first online window
+  relay.begin(DEVICE_NAME "-gw");
+  #endif
 
   digitalWrite(CASE_LED, LOW);
 }
 
 void loop() {
-  mqttUtility.pollMqtt();
-  unsigned long current = millis();
-  
-  if (current - loopPrevious >= loopInterval) {
-    loopPrevious = current;
-    digitalWrite(CASE_LED, HIGH);
-    mqttUtility.checkConnection();
-    measureData();
-    sendData();
-    digitalWrite(CASE_LED, LOW);
+  supervisor.kick();
+  scheduler.run();
+  #ifdef BLE_RELAY_GATEWAY
+  // Not ticked from waitTouch(), the RGB LED is written over SPI and needs NINA on WiFi during calibration
+  relay.tick();
+  if (relay.getState() != RELAY_ONLINE) return;
+  #endif
+  // Recalibration blocks while waiting for touches, run it between moisture sampling batches
+  if (isCalRequested && !mstSampler.isRunning()) {
+    isCalRequested = false;
+    calibrate(calTouchTimeout);
+  }
+  // Sampler is restarted between batches with the new round count, a completed batch is reduced first
+  if (isRoundsChanged && !mstSampler.isRunning() && !mstSampler.isReady()) {
+    isRoundsChanged = false;
+    mstSampler.begin(mstArray, mstArraySize, mstRoundsLimit(nodeConfig.get().rounds));
+  }
+  if (isDiscoveryRequested) {
+    isDiscoveryRequested = false;
+    mqttUtility.clearDiscoveryCache();
+    configureDiscovery();
   }
-  delay(1000);
 }
 
-void measureData() {
-  short loops = 40;
-  int raw;
-  
-  // Reset moisture sensort sums to 0
-  for(int i=0; i < mstArraySize; i++){
-    (*mstArray)[i].sum = 0;
-  }
+void pollTask() {
+  if (mqttUtility.tick() == CONN_STATE_CONNECTED && !isConfigured) configureDiscovery();
+}
 
-  for(int i=0; i < loops; i++){
-    for(int k=0; k < mstArraySize; k++){
-      // Constrain values within calibrated range.
-      raw = constrain(analogRead((*mstArray)[k].pin), (*mstArray)[k].cap, (*mstArray)[k].base);
-      (*mstArray)[k].sum += raw;
-    }
-    delay(100);
+/**
+ * Start a moisture sampling batch, rounds are taken by mstTask
+*/
+void sampleTask() {
+  digitalWrite(CASE_LED, HIGH);
+  mstSampler.start();
+  scheduler.setEnabled(mstTaskId, true);
+}
+
+void publishTask() {
+  {
+    #ifdef MQTTU_DIAGNOSTICS
+    PhaseTimer timer(mqttUtility.getPhase(PHASE_SENSOR));
+    #endif
+    measureData();
   }
+  // Samples between reports only go to the statistics
+  if (reportGate.isDue(mqttUtility.monotonicMs()) || sensors.isChanged()) sendData();
+  supervisor.markHealthy();
+  digitalWrite(CASE_LED, LOW);
+  #ifdef MQTTU_LOW_POWER
+  sleepCycle();
+  #endif
+}
+
+void mstTask() {
+  if (mstSampler.tick()) scheduler.setEnabled(mstTaskId, false);
+}
 
-    for(int k=0; k < mstArraySize; k++){
-    (*mstArray)[k].val = map((*mstArray)[k].sum/loops, (*mstArray)[k].cap, (*mstArray)[k].base, 100, 0);
+/**
+ * Blink case LED while WiFi/MQTT is not connected
+*/
+void ledTask() {
+  static bool isLedOn = false;
+  if (mqttUtility.getState() == CONN_STATE_CONNECTED) {
+    if (isLedOn) digitalWrite(CASE_LED, LOW);
+    isLedOn = false;
+    return;
   }
+  isLedOn = !isLedOn;
+  digitalWrite(CASE_LED, isLedOn ? HIGH : LOW);
+}
 
-  #ifdef SHT31_ENABLED
-  do {
-    temp = sht.readTemperature();
-    hum = sht.readHumidity();
-  } while (isnan(temp) || isnan(hum));
-  #endif
+void measureData() {
+  // Moisture values keep their previous readings if the batch has not completed
+  if (mstSampler.reduce()) {
+    for (int i = 0; i < mstArraySize; i++) reportGate.update(mstFirstChannel + i, mstArray[i].val);
+  }
 
-  #ifdef SI1151_ENABLED
-  do {
-    sun = si1151.ReadVisible();
-  } while (isnan(sun));
-  #endif
+  // Previous values are kept if a sensor does not answer, sensors that did not start are skipped
+  sensors.acquireAll(reportGate);
 
   return;
 }
 
 void sendData() {
-    JsonDocument doc;
+    stateFrame.clear();
     // Add moisture sensors (for loop)
     for(int i=0; i<mstArraySize; i++){
-      doc[(*mstArray)[i].val_id] = (*mstArray)[i].val;
+      stateFrame.setFixed(mstArray[i].val_id, mstArray[i].val, 1);
     }
     // Add other sensors
-    #ifdef SHT31_ENABLED
-    doc["temp"] = temp;
-    doc["hum"] = hum;
-    #endif
-    #ifdef SI1151_ENABLED
-    doc["sun"] = sun;
+    sensors.emit(stateFrame);
+    #ifdef MQTTU_LOW_POWER
+    stateFrame.set("icur", mqttUtility.getAverageCurrent());
     #endif
-    int len = measureJson(doc);
-    char output[len++];
-    serializeJson(doc, output, len);
+    reportGate.addStats(stateFrame);
+    #ifdef BLE_RELAY_GATEWAY
+    // Published with the leaf readings in the next online window
+    if (relay.enqueue(DEVICE_ID, stateFrame)) reportGate.markReported(mqttUtility.monotonicMs());
+    #else
     mqttUtility.checkConnection();
-    mqttUtility.sendPackets(doc, stateTopic);
+    // A dropped reading leaves the gate due, it is reported again at the next sample
+    if (mqttUtility.sendFrame(stateFrame, stateTopic) != PUB_DROPPED) reportGate.markReported(mqttUtility.monotonicMs());
+    #endif
+    sendAvailability();
     return;
 }
 
+/**
+ * Publish sensor availability when it has changed, the retained message holds every sensor and the last reset reason
+*/
+void sendAvailability() {
+  if (!sensors.isChanged()) return;
+  JsonDocument doc;
+  sensors.addAvailability(doc);
+  doc["rst"] = supervisor.getResetReason();
+  doc["crash"] = supervisor.getCrashCount();
+  if (mqttUtility.sendAvailability(doc)) sensors.markReported();
+}
+
 /**
  * Simple analog sensor calibration tool
  * params: 
@@ -322,7 +477,8 @@ int calMoisture(uint8_t pin, bool calCapacitive, bool calBase){
   else useGreaterThan = false;
 
   while(millis() - start < duration){
-    int readout = analogRead(pin);
+    supervisor.kick();
+    int readout = mstSampler.read(pin);
     if(useGreaterThan){ 
       if(readout > value) value = readout;
     }else{
@@ -334,6 +490,189 @@ int calMoisture(uint8_t pin, bool calCapacitive, bool calBase){
   return value;
 }
 
+#ifdef MQTTU_LOW_POWER
+/**
+ * Sleep until wakeLead ms before the next sampling run, then reconnect in the background
+*/
+void sleepCycle() {
+  #ifdef MQTTU_OTA
+  if (mqttUtility.isOtaActive()) return;
+  #endif
+  int32_t idle = scheduler.timeUntil(sampleTaskId) - (int32_t)wakeLead;
+  if (idle < (int32_t)sleepMin) return;
+  supervisor.pause();  // WDT keeps running in standby
+  scheduler.advance(mqttUtility.sleep(idle));
+  supervisor.resume();
+}
+#endif
+
+/**
+ * Calibrate moisture sensors, dry (base) first and then wet (cap). Each step starts with a touch.
+ * Values are saved to flash when both steps complete.
+ * params: uint32_t touchTimeout: ms to wait for each touch, 0 = wait forever
+ * returns: bool: true if calibration was updated, false if aborted
+*/
+bool calibrate(uint32_t touchTimeout) {
+  int redMax, grnMax, bluMax;
+  short base[mstArraySize];
+
+  // Calibration - Base(Dry)
+  rgbLed(100, 50, 0);
+  redMax = 140, grnMax = 70, bluMax = 0;
+  if (!waitTouch(touchTimeout)) {
+    rgbLed(0, 0, 0);
+    return false;
+  }
+  for (int i = 0; i < mstArraySize; i++){
+    rgbLed(redMax*(i+1)/mstArraySize, grnMax*(i+1)/mstArraySize, bluMax*(i+1)/mstArraySize);
+    base[i] = calMoisture(mstArray[i].pin, isCapacitive, true);
+    delay(100);
+  }
+  delay(50);
+  rgbLed(0, 100, 0);
+  delay(2000);
+  rgbLed(0, 0, 0);
+  delay(50);
+
+  // Calibration - Cap(Wet)
+  rgbLed(0, 100, 100);
+  redMax = 0, grnMax = 140, bluMax = 140;
+  if (!waitTouch(touchTimeout)) {
+    rgbLed(0, 0, 0);
+    return false;
+  }
+  for (int i = 0; i < mstArraySize; i++){
+    rgbLed(redMax*(i+1)/mstArraySize, grnMax*(i+1)/mstArraySize, bluMax*(i+1)/mstArraySize);
+    setCalibration(mstArray[i], base[i], calMoisture(mstArray[i].pin, isCapacitive, false));
+    delay(100);
+  }
+  delay(50);
+  rgbLed(0, 100, 0);
+  delay(2000);
+  rgbLed(0, 0, 0);
+  delay(50);
+
+  saveCalibration();
+  return true;
+}
+
+/**
+ * Wait for the touch pin, keeps the MQTT connection alive while waiting
+ * params: uint32_t timeout: ms to wait, 0 = wait forever
+ * returns: bool: true if touched before timeout
+*/
+bool waitTouch(uint32_t timeout) {
+  uint32_t start = millis();
+  while (digitalRead(TOUCH_PIN) != HIGH) {
+    if (timeout > 0 && millis() - start >= timeout) return false;
+    supervisor.kick();
+    pollTask();
+  }
+  return true;
+}
+
+/**
+ * Load moisture sensor calibration from flash. Stored pins must match the current sensor array.
+ * returns: bool: true if calibration was loaded
+*/
+bool loadCalibration() {
+  cal_entry cal[mstArraySize];
+  for (int i = 0; i < mstArraySize; i++) cal[i].pin = mstArray[i].pin;
+  if (!calStore.load(cal, mstArraySize)) return false;
+
+  for (int i = 0; i < mstArraySize; i++) {
+    setCalibration(mstArray[i], cal[i].base, cal[i].cap);
+  }
+  return true;
+}
+
+void saveCalibration() {
+  cal_entry cal[mstArraySize];
+  for (int i = 0; i < mstArraySize; i++) {
+    cal[i] = { mstArray[i].pin, mstArray[i].base, mstArray[i].cap };
+  }
+  calStore.save(cal, mstArraySize);
+}
+
+/**
+ * MQTT command handler. Commands:
+ *   calibrate: recalibrate moisture sensors, each step must be started with a touch within calTouchTimeout
+ *   discovery: re-publish all discovery configs, e.g. after the broker lost retained messages
+*/
+void onCommand(const char* payload, size_t length) {
+  if (strcmp(payload, "calibrate") == 0) isCalRequested = true;
+  else if (strcmp(payload, "discovery") == 0) isDiscoveryRequested = true;
+}
+
+/**
+ * Apply a config document from the command topic, changed settings are saved to flash
+*/
+void onConfig(JsonObjectConst config) {
+  uint8_t changed = nodeConfig.apply(config);
+  if (changed == 0) return;
+  applyConfig(changed);
+  nodeConfig.save();
+}
+
+#ifdef MQTTU_OTA
+/**
+ * Pause sampling and reports while a firmware image is received, NINA only serves the download
+*/
+void onOta(util_ota_state state) {
+  bool isIdle = state != OTA_RECEIVING;
+  // Resumed with the moisture batch sampleLead ahead of the report, as scheduled in setup()
+  uint32_t period = nodeConfig.get().interval;
+  scheduler.setEnabled(sampleTaskId, isIdle, period - sampleLead);
+  scheduler.setEnabled(publishTaskId, isIdle, period);
+  if (!isIdle) scheduler.setEnabled(mstTaskId, false);  // Restarted by the next sampleTask()
+  if (state == OTA_APPLYING) supervisor.pause();  // The flash copy runs without kicks
+}
+#endif
+
+/**
+ * Apply changed settings live. Offsets go to the SHT31 policy.
+ * params: uint8_t changed: NODE_CFG_* flags
+*/
+void applyConfig(uint8_t changed) {
+  const node_cfg& cfg = nodeConfig.get();
+  if (changed & NODE_CFG_INTERVAL) {
+    scheduler.setPeriod(sampleTaskId, cfg.interval);
+    scheduler.setPeriod(publishTaskId, cfg.interval);
+  }
+  if (changed & NODE_CFG_HEARTBEAT) reportGate.setHeartbeat(cfg.heartbeat);
+  #ifdef SHT31_ENABLED
+  if (changed & NODE_CFG_OFFSETS) sensors.get<ShtSensor>().setOffsets(cfg.temperatureOffset, cfg.humidityOffset);
+  #endif
+  if (changed & NODE_CFG_ROUNDS) isRoundsChanged = true;
+  if (changed & NODE_CFG_TIMEOUT) isConfigured = false;  // Re-published by pollTask() with the new expiry
+}
+
+/**
+ * Limit moisture sampling rounds to what fits in a batch
+ * params: uint16_t rounds: configured rounds
+ * returns: uint16_t: rounds that finish within sampleLead, the DMA sampler limits rounds to its buffer itself
+*/
+uint16_t mstRoundsLimit(uint16_t rounds) {
+  #ifdef MST_ADC_DMA
+  return rounds;
+  #else
+  uint16_t limit = sampleLead / mstInterval;
+  return rounds < limit ? rounds : limit;
+  #endif
+}
+
+/**
+ * Publish discovery configs for all enabled sensors
+*/
+void configureDiscovery() {
+  #ifdef DEVICE_DISCOVERY
+  mqttUtility.configureDevice(device, discovery, nodeConfig.get().sensorTimeout);
+  #else
+  mqttUtility.configureTopic(device, discovery, nodeConfig.get().sensorTimeout);
+  #endif
+  isConfigured = true;
+}
+
 /**
  * WiFiNINA boards, MKR 1010 WiFi: control built-in RGB LED
  * params: uint8_t r, g, b: per-color write values to use
@@ -350,76 +689,3 @@ void rgbLed(uint8_t r, uint8_t g, uint8_t b) {
   WiFiDrv::analogWrite(RGB_G_PIN, g);
   WiFiDrv::analogWrite(RGB_B_PIN, b);
 }
-
-/**
- * Count enabled moisture sensor pins and create a new array of sensor definitions.
-*/
-void makeSenArray() {
-
-  int c = 0;
-  #ifdef MST_PIN_1
-  c++;
-  #endif
-  #ifdef MST_PIN_2
-  c++;
-  #endif
-  #ifdef MST_PIN_3
-  c++;
-  #endif
-  #ifdef MST_PIN_4
-  c++;
-  #endif
-  #ifdef MST_PIN_5
-  c++;
-  #endif
-  #ifdef MST_PIN_6
-  c++;
-  #endif
-  #ifdef MST_PIN_7
-  c++;
-  #endif
-
-  // Gather pin assignments
-  uint8_t pin_arr[c];
-  int n = 0;
-  #ifdef MST_PIN_1
-  pin_arr[n]=MST_PIN_1;
-  n++;
-  #endif
-  #ifdef MST_PIN_2
-  pin_arr[n]=MST_PIN_2;
-  n++;
-  #endif
-  #ifdef MST_PIN_3
-  pin_arr[n]=MST_PIN_3;
-  n++;
-  #endif
-  #ifdef MST_PIN_4
-  pin_arr[n]=MST_PIN_4;
-  n++;
-  #endif
-  #ifdef MST_PIN_5
-  pin_arr[n]=MST_PIN_5;
-  n++;
-  #endif
-  #ifdef MST_PIN_6
-  pin_arr[n]=MST_PIN_6;
-  n++;
-  #endif
-  #ifdef MST_PIN_7
-  pin_arr[n]=MST_PIN_7;
-  n++;
-  #endif
-
-  // Allocate and populate new sensor array
-  mst_sen_arr* newMstArray = (mst_sen_arr*)malloc(c * sizeof(mst_sen));
-  for(int k = 0; k<c; k++){
-    (*newMstArray)[k] = { pin_arr[k], 0, 0, 0, 0 };
-    snprintf((*newMstArray)[k].id, sizeof((*newMstArray)[k].id), "%d", k+1);
-    snprintf((*newMstArray)[k].val_id, sizeof((*newMstArray)[k].val_id), "%s%d", "smst", k+1);
-  }
-
-  mstArraySize = c; // Save array size to global
-  mstArray = newMstArray;  // Save new array to global
-  return;
-}
\ No newline at end of file
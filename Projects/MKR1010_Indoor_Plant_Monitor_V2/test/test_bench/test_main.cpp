@@ -0,0 +1,193 @@
+/*
+  Author: Ilari Mattsson
+  project: MKR1010_Indoor_Plant_Monitor
+  File: test_bench/test_main.cpp
+
+  Per call cost of the publish, discovery and measurement paths, pio test -e native -v prints one
+  "bench" line per path (Native_Bench.h). Cycle counts are host numbers and only printed; copied
+  bytes, write() calls and heap allocations do not depend on the host and are asserted where the
+  path is meant to stay without heap use or intermediate buffers.
+*/
+
+#include <Native_Mocks.h>
+#include <Native_Bench.h>
+#include <Mqtt_Utility.h>
+#include <Moisture_Sampler.h>
+#include "local_utils.h"
+#include "discovery_table.h"
+#include <unity.h>
+
+#define BENCH_CALLS 1000
+
+const char stateTopic[] = MQTTU_STATE_TOPIC(DEVICE_ID);
+const size_t discoveryCount = sizeof(discovery) / sizeof(discovery[0]);
+
+mst_sen mstArray[] = {
+  MST_PROBES(MST_SENSOR)
+};
+const int mstArraySize = sizeof(mstArray) / sizeof(mstArray[0]);
+
+static int probes(uint8_t pin) {
+  return 500 + pin * 7 + (random(8) & 7);
+}
+
+static void connect(MqttUtility& util) {
+  util.start();
+  util.tick();
+  util.tick();
+  TEST_ASSERT_EQUAL_INT(CONN_STATE_CONNECTED, util.getState());
+}
+
+/**
+ * State report of the project with every sensor enabled, as built in sendData()
+*/
+static void fillFrame(StateFrame& frame, ReportGate& gate) {
+  frame.clear();
+  for (int i = 0; i < mstArraySize; i++) frame.setFixed(mstArray[i].val_id, 435 + i, 1);
+  frame.set("temp", 21.46f, 2);
+  frame.set("humi", 40.2f, 2);
+  frame.set("sun", 120, 0);
+  gate.addStats(frame);
+}
+
+static void fillDocument(JsonDocument& doc) {
+  doc.clear();
+  for (int i = 0; i < mstArraySize; i++) doc[mstArray[i].val_id] = (435 + i) * 0.1f;
+  doc["temp"] = 21.46f;
+  doc["humi"] = 40.2f;
+  doc["sun"] = 120;
+}
+
+void setUp() {
+  mockReset();
+  mockAnalog(probes);
+}
+
+void tearDown() {
+}
+
+void test_bench_send_frame() {
+  WiFiClient wifiClient;
+  MqttClient mqttClient(wifiClient);
+  MqttUtility util(wifiClient, mqttClient, "ssid", "psk", "broker", 1883);
+  connect(util);
+
+  static StateFrame frame;
+  ReportGate gate(60000);
+  gate.addChannel("temp", 0.5f);
+  gate.addChannel("humi", 2.0f);
+  gate.update(0, 21.0f);
+  gate.update(0, 21.5f);
+  gate.update(1, 40.0f);
+  fillFrame(frame, gate);
+  size_t len = frame.render();
+
+  bench_res r = benchRun("sendFrame", BENCH_CALLS, [&]() { util.sendFrame(frame, stateTopic); });
+  TEST_ASSERT_EQUAL_FLOAT(0, r.allocs);
+  TEST_ASSERT_EQUAL_FLOAT(1, r.writes);
+  TEST_ASSERT_EQUAL_FLOAT((float)len, r.bytes);
+
+  r = benchRun("StateFrame::render", BENCH_CALLS, [&]() { frame.render(); });
+  TEST_ASSERT_EQUAL_FLOAT(0, r.allocs);
+
+  uint8_t packed[STATE_FRAME_SIZE];
+  r = benchRun("StateFrame::pack", BENCH_CALLS, [&]() { frame.pack(packed, sizeof(packed)); });
+  TEST_ASSERT_EQUAL_FLOAT(0, r.allocs);
+
+  r = benchRun("fill frame + sendFrame", BENCH_CALLS, [&]() {
+    fillFrame(frame, gate);
+    util.sendFrame(frame, stateTopic);
+  });
+  TEST_ASSERT_EQUAL_FLOAT(0, r.allocs);
+}
+
+void test_bench_send_packets() {
+  WiFiClient wifiClient;
+  MqttClient mqttClient(wifiClient);
+  MqttUtility util(wifiClient, mqttClient, "ssid", "psk", "broker", 1883);
+  connect(util);
+
+  JsonDocument doc;
+  fillDocument(doc);
+  size_t len = measureJson(doc);
+
+  // Serialized straight into the MqttClient, the document is only read
+  bench_res r = benchRun("sendPackets", BENCH_CALLS, [&]() { util.sendPackets(doc, stateTopic); });
+  TEST_ASSERT_EQUAL_FLOAT(0, r.allocs);
+  TEST_ASSERT_EQUAL_FLOAT((float)len, r.bytes);
+
+  // For comparison with "fill frame + sendFrame"
+  benchRun("fill document + sendPackets", BENCH_CALLS, [&]() {
+    fillDocument(doc);
+    util.sendPackets(doc, stateTopic);
+  });
+}
+
+void test_bench_discovery() {
+  WiFiClient wifiClient;
+  MqttClient mqttClient(wifiClient);
+  MqttUtility util(wifiClient, mqttClient, "ssid", "psk", "broker", 1883);
+  connect(util);
+
+  bench_res single = benchRun("configureTopic(mdev)", BENCH_CALLS, [&]() {
+    util.configureTopic(discovery[5], sensorTimeout);
+  });
+  bench_res table = benchRun("configureTopic(table)", BENCH_CALLS / 10, [&]() {
+    util.configureTopic(discovery, sensorTimeout);
+  });
+  bench_res devices = benchRun("configureTopic(device, table)", BENCH_CALLS / 10, [&]() {
+    util.configureTopic(device, discovery, sensorTimeout);
+  });
+  bench_res batched = benchRun("configureDevice", BENCH_CALLS / 10, [&]() {
+    util.configureDevice(device, discovery, sensorTimeout);
+  });
+
+  // Sized messages, nothing but the payloads is written
+  TEST_ASSERT_GREATER_THAN(0, single.bytes);
+  TEST_ASSERT_TRUE(table.bytes > single.bytes);
+  // Same components with the device object added to each
+  TEST_ASSERT_TRUE(devices.bytes > table.bytes);
+  TEST_ASSERT_TRUE(batched.bytes < devices.bytes);
+}
+
+void test_bench_measure_data() {
+  MoistureSampler mstSampler;
+  for (int i = 0; i < mstArraySize; i++) setCalibration(mstArray[i], 800, 400);
+  mstSampler.begin(mstArray, mstArraySize, 10);
+
+  ReportGate reportGate(60000);
+  int8_t mstFirstChannel = -1;
+  for (int i = 0; i < mstArraySize; i++) {
+    int8_t channel = reportGate.addChannel(mstArray[i].val_id, 10, false);
+    if (i == 0) mstFirstChannel = channel;
+  }
+
+  // A batch of readings as the sampling task takes them, then measureData()
+  bench_res r = benchRun("sample batch + measureData", BENCH_CALLS, [&]() {
+    mstSampler.start();
+    while (!mstSampler.tick());
+    if (mstSampler.reduce()) {
+      for (int i = 0; i < mstArraySize; i++) reportGate.update(mstFirstChannel + i, mstArray[i].val);
+    }
+  });
+  TEST_ASSERT_EQUAL_FLOAT(0, r.allocs);
+  TEST_ASSERT_EQUAL_FLOAT(0, r.bytes);
+
+  FixedScale scale;
+  scale.set(800, 400, 0, 1000);
+  scale.setCount(10);
+  volatile int32_t sink = 0;
+  int32_t sum = 6005;
+  r = benchRun("FixedScale::applyMean", BENCH_CALLS, [&]() { sink = scale.applyMean(sum++); });
+  TEST_ASSERT_EQUAL_FLOAT(0, r.allocs);
+  (void)sink;
+}
+
+int main(int argc, char** argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_bench_send_frame);
+  RUN_TEST(test_bench_send_packets);
+  RUN_TEST(test_bench_discovery);
+  RUN_TEST(test_bench_measure_data);
+  return UNITY_END();
+}
@@ -0,0 +1,229 @@
+/*
+  Author: Ilari Mattsson
+  project: MKR1010_Indoor_Plant_Monitor
+  File: test_discovery/test_main.cpp
+
+  Discovery payloads of the configureTopic() overloads and configureDevice(), pio test -e native.
+  The device and table are the firmware's (discovery_table.h), without MQTTU_LOW_POWER and MQTTU_DIAGNOSTICS.
+*/
+
+#include <Native_Mocks.h>
+#include <Mqtt_Utility.h>
+#include "discovery_table.h"
+#include <unity.h>
+
+const char availabilityTopic[] = MQTTU_AVAILABILITY_TOPIC(DEVICE_ID);
+const size_t discoveryCount = sizeof(discovery) / sizeof(discovery[0]);
+const mdev& temperature = discovery[5];
+
+static void connect(MqttUtility& util) {
+  util.start();
+  util.tick();
+  util.tick();
+  TEST_ASSERT_EQUAL_INT(CONN_STATE_CONNECTED, util.getState());
+}
+
+/**
+ * Parse a logged discovery message, discovery configs are retained and sent as sized messages
+*/
+static void parse(JsonDocument& doc, const mock_message* msg) {
+  TEST_ASSERT_NOT_NULL(msg);
+  TEST_ASSERT_TRUE(msg->retain);
+  TEST_ASSERT_EQUAL_UINT32(msg->length, msg->announced);
+  TEST_ASSERT_TRUE(deserializeJson(doc, (const char*)msg->payload, msg->length) == DeserializationError::Ok);
+}
+
+static void assertComponent(JsonObjectConst obj, const mdev& config, uint16_t expiresAfter) {
+  TEST_ASSERT_EQUAL_STRING(config.device_class, obj["dev_cla"].as<const char*>());
+  TEST_ASSERT_EQUAL_INT(expiresAfter, obj["exp_aft"].as<int>());
+  TEST_ASSERT_EQUAL_STRING(config.name, obj["name"].as<const char*>());
+  TEST_ASSERT_EQUAL_STRING(config.unique_id, obj["uniq_id"].as<const char*>());
+  TEST_ASSERT_EQUAL_STRING(config.unit_of_measurement, obj["unit_of_meas"].as<const char*>());
+  TEST_ASSERT_EQUAL_STRING(config.value_template, obj["val_tpl"].as<const char*>());
+}
+
+void setUp() {
+  mockReset();
+}
+
+void tearDown() {
+}
+
+void test_table_strings() {
+  TEST_ASSERT_EQUAL_STRING("homeassistant/sensor/greenAmst1/config", discovery[0].configuration_topic);
+  TEST_ASSERT_EQUAL_STRING("greenAsoil1", discovery[0].unique_id);
+  TEST_ASSERT_EQUAL_STRING("{{ value_json.smst1 }}", discovery[0].value_template);
+  TEST_ASSERT_EQUAL_STRING("GreenA Air Temperature", temperature.name);
+  TEST_ASSERT_EQUAL_STRING("homeassistant/sensor/greenA/state", temperature.state_topic);
+  TEST_ASSERT_EQUAL_STRING("{{ value_json.temp | round(1) }}", temperature.value_template);
+  TEST_ASSERT_EQUAL_STRING("{{ value_json.sht }}", temperature.availability_template);
+  TEST_ASSERT_EQUAL_STRING("homeassistant/device/greenA/config", device.configuration_topic);
+}
+
+void test_configure_topic_single() {
+  WiFiClient wifiClient;
+  MqttClient mqttClient(wifiClient);
+  MqttUtility util(wifiClient, mqttClient, "ssid", "psk", "broker", 1883);
+  connect(util);
+
+  util.configureTopic(temperature);
+  TEST_ASSERT_EQUAL_UINT16(1, mqttClient.getMessageCount());
+  const mock_message* msg = mqttClient.getMessage(0);
+  TEST_ASSERT_EQUAL_STRING("homeassistant/sensor/greenAtemp/config", msg->topic);
+
+  JsonDocument doc;
+  parse(doc, msg);
+  assertComponent(doc.as<JsonObjectConst>(), temperature, sensorTimeout);
+  TEST_ASSERT_EQUAL_STRING(temperature.state_topic, doc["stat_t"].as<const char*>());
+  // Availability is left out until the project sets an availability topic
+  TEST_ASSERT_TRUE(doc["avty_t"].isNull());
+  TEST_ASSERT_TRUE(doc["dev"].isNull());
+}
+
+void test_configure_topic_availability_and_expiry() {
+  WiFiClient wifiClient;
+  MqttClient mqttClient(wifiClient);
+  MqttUtility util(wifiClient, mqttClient, "ssid", "psk", "broker", 1883);
+  util.setAvailabilityTopic(availabilityTopic);
+  connect(util);
+
+  util.configureTopic(temperature, 900);
+  JsonDocument doc;
+  parse(doc, mqttClient.getMessage(mqttClient.getMessageCount() - 1));
+  TEST_ASSERT_EQUAL_INT(900, doc["exp_aft"].as<int>());
+  TEST_ASSERT_EQUAL_STRING(availabilityTopic, doc["avty_t"].as<const char*>());
+  TEST_ASSERT_EQUAL_STRING("{{ value_json.sht }}", doc["avty_tpl"].as<const char*>());
+}
+
+void test_configure_topic_none_device_class() {
+  WiFiClient wifiClient;
+  MqttClient mqttClient(wifiClient);
+  MqttUtility util(wifiClient, mqttClient, "ssid", "psk", "broker", 1883);
+  connect(util);
+
+  const mdev generic = MQTTU_SENSOR(DEVICE_NAME, DEVICE_ID, "Counter", "cnt", "None", NULL, "", 60);
+  util.configureTopic(generic);
+  JsonDocument doc;
+  parse(doc, mqttClient.getMessage(0));
+  TEST_ASSERT_TRUE(doc["dev_cla"].isNull());
+  TEST_ASSERT_TRUE(doc["unit_of_meas"].isNull());
+  TEST_ASSERT_EQUAL_INT(60, doc["exp_aft"].as<int>());
+}
+
+void test_configure_topic_table() {
+  WiFiClient wifiClient;
+  MqttClient mqttClient(wifiClient);
+  MqttUtility util(wifiClient, mqttClient, "ssid", "psk", "broker", 1883);
+  connect(util);
+
+  util.configureTopic(discovery);
+  TEST_ASSERT_EQUAL_UINT16(discoveryCount, mqttClient.getMessageCount());
+  for (size_t i = 0; i < discoveryCount; i++) {
+    const mock_message* msg = mqttClient.getMessage(i);
+    TEST_ASSERT_EQUAL_STRING(discovery[i].configuration_topic, msg->topic);
+    JsonDocument doc;
+    parse(doc, msg);
+    assertComponent(doc.as<JsonObjectConst>(), discovery[i], sensorTimeout);
+    TEST_ASSERT_TRUE(doc["dev"].isNull());
+  }
+}
+
+void test_configure_topic_device_table() {
+  WiFiClient wifiClient;
+  MqttClient mqttClient(wifiClient);
+  MqttUtility util(wifiClient, mqttClient, "ssid", "psk", "broker", 1883);
+  connect(util);
+
+  util.configureTopic(device, discovery, 600);
+  TEST_ASSERT_EQUAL_UINT16(discoveryCount, mqttClient.getMessageCount());
+  for (size_t i = 0; i < discoveryCount; i++) {
+    const mock_message* msg = mqttClient.getMessage(i);
+    TEST_ASSERT_EQUAL_STRING(discovery[i].configuration_topic, msg->topic);
+    JsonDocument doc;
+    parse(doc, msg);
+    assertComponent(doc.as<JsonObjectConst>(), discovery[i], 600);
+    TEST_ASSERT_EQUAL_STRING(DEVICE_ID, doc["dev"]["ids"].as<const char*>());
+    TEST_ASSERT_EQUAL_STRING(DEVICE_NAME, doc["dev"]["name"].as<const char*>());
+    TEST_ASSERT_EQUAL_STRING("MKR1010 Indoor Plant Monitor", doc["dev"]["mdl"].as<const char*>());
+    TEST_ASSERT_EQUAL_STRING(FW_VERSION, doc["dev"]["sw"].as<const char*>());
+    TEST_ASSERT_TRUE(doc["dev"]["mf"].isNull());
+  }
+}
+
+void test_configure_device() {
+  WiFiClient wifiClient;
+  MqttClient mqttClient(wifiClient);
+  MqttUtility util(wifiClient, mqttClient, "ssid", "psk", "broker", 1883);
+  connect(util);
+
+  util.configureDevice(device, discovery, 600);
+  TEST_ASSERT_EQUAL_UINT16(1, mqttClient.getMessageCount());
+  const mock_message* msg = mqttClient.getMessage(0);
+  TEST_ASSERT_EQUAL_STRING(device.configuration_topic, msg->topic);
+  TEST_ASSERT_TRUE(msg->length < MOCK_MQTT_PAYLOAD);
+
+  JsonDocument doc;
+  parse(doc, msg);
+  TEST_ASSERT_EQUAL_STRING(DEVICE_ID, doc["dev"]["ids"].as<const char*>());
+  TEST_ASSERT_EQUAL_STRING("Mqtt Utility", doc["o"]["name"].as<const char*>());
+  TEST_ASSERT_EQUAL_STRING(device.state_topic, doc["stat_t"].as<const char*>());
+
+  JsonObjectConst components = doc["cmps"].as<JsonObjectConst>();
+  TEST_ASSERT_EQUAL_UINT32(discoveryCount, components.size());
+  for (size_t i = 0; i < discoveryCount; i++) {
+    JsonObjectConst component = components[discovery[i].unique_id].as<JsonObjectConst>();
+    TEST_ASSERT_EQUAL_STRING("sensor", component["p"].as<const char*>());
+    assertComponent(component, discovery[i], 600);
+    // Components share the device state topic
+    TEST_ASSERT_TRUE(component["stat_t"].isNull());
+  }
+}
+
+void test_configure_topic_document() {
+  WiFiClient wifiClient;
+  MqttClient mqttClient(wifiClient);
+  MqttUtility util(wifiClient, mqttClient, "ssid", "psk", "broker", 1883);
+  connect(util);
+
+  JsonDocument config;
+  config["name"] = "GreenA Custom";
+  config["stat_t"] = temperature.state_topic;
+  util.configureTopic(config, "homeassistant/sensor/greenAcustom/config");
+
+  const mock_message* msg = mqttClient.getMessage(0);
+  TEST_ASSERT_NOT_NULL(msg);
+  TEST_ASSERT_TRUE(msg->retain);
+  TEST_ASSERT_EQUAL_STRING("homeassistant/sensor/greenAcustom/config", msg->topic);
+  TEST_ASSERT_EQUAL_STRING("{\"name\":\"GreenA Custom\",\"stat_t\":\"homeassistant/sensor/greenA/state\"}",
+                           (const char*)msg->payload);
+}
+
+void test_configure_offline() {
+  WiFiClient wifiClient;
+  MqttClient mqttClient(wifiClient);
+  MqttUtility util(wifiClient, mqttClient, "ssid", "psk", "broker", 1883);
+
+  JsonDocument config;
+  config["name"] = "GreenA Custom";
+  util.configureTopic(temperature);
+  util.configureTopic(discovery);
+  util.configureTopic(device, discovery);
+  util.configureDevice(device, discovery);
+  util.configureTopic(config, "homeassistant/sensor/greenAcustom/config");
+  TEST_ASSERT_EQUAL_UINT16(0, mqttClient.getMessageCount());
+  TEST_ASSERT_EQUAL_UINT32(0, mockIo.bytes);
+}
+
+int main(int argc, char** argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_table_strings);
+  RUN_TEST(test_configure_topic_single);
+  RUN_TEST(test_configure_topic_availability_and_expiry);
+  RUN_TEST(test_configure_topic_none_device_class);
+  RUN_TEST(test_configure_topic_table);
+  RUN_TEST(test_configure_topic_device_table);
+  RUN_TEST(test_configure_device);
+  RUN_TEST(test_configure_topic_document);
+  RUN_TEST(test_configure_offline);
+  return UNITY_END();
+}
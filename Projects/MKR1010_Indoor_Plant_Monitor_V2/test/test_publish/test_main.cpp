@@ -0,0 +1,160 @@
+/*
+  Author: Ilari Mattsson
+  project: MKR1010_Indoor_Plant_Monitor
+  File: test_publish/test_main.cpp
+
+  MqttUtility::sendPackets() and sendFrame() against the mock clients, pio test -e native
+*/
+
+#include <Native_Mocks.h>
+#include <Mqtt_Utility.h>
+#include <unity.h>
+
+static const char* stateTopic = "greenA/state";
+static const char* backfillTopic = "greenA/backfill";
+
+static void connect(MqttUtility& util) {
+  util.start();
+  util.tick();
+  util.tick();
+  TEST_ASSERT_EQUAL_INT(CONN_STATE_CONNECTED, util.getState());
+}
+
+static void assertPayload(const char* expected, const mock_message* msg) {
+  TEST_ASSERT_NOT_NULL(msg);
+  TEST_ASSERT_EQUAL_UINT32(strlen(expected), msg->length);
+  TEST_ASSERT_EQUAL_STRING(expected, (const char*)msg->payload);
+}
+
+void setUp() {
+  mockReset();
+}
+
+void tearDown() {
+}
+
+void test_send_packets() {
+  WiFiClient wifiClient;
+  MqttClient mqttClient(wifiClient);
+  MqttUtility util(wifiClient, mqttClient, "ssid", "psk", "broker", 1883);
+  connect(util);
+
+  JsonDocument doc;
+  doc["temp"] = 21.5;
+  doc["humi"] = 40;
+  TEST_ASSERT_EQUAL_INT(PUB_OK, util.sendPackets(doc, stateTopic));
+
+  TEST_ASSERT_EQUAL_UINT16(1, mqttClient.getMessageCount());
+  const mock_message* msg = mqttClient.getMessage(0);
+  assertPayload("{\"temp\":21.5,\"humi\":40}", msg);
+  TEST_ASSERT_EQUAL_STRING(stateTopic, msg->topic);
+  // Sized message, the payload is streamed into the socket as announced
+  TEST_ASSERT_EQUAL_UINT32(msg->length, msg->announced);
+  TEST_ASSERT_FALSE(msg->retain);
+  TEST_ASSERT_EQUAL_UINT8(0, msg->qos);
+}
+
+void test_send_packets_unacknowledged_is_buffered() {
+  WiFiClient wifiClient;
+  MqttClient mqttClient(wifiClient);
+  MqttUtility util(wifiClient, mqttClient, "ssid", "psk", "broker", 1883);
+  util.setBackfillTopic(backfillTopic);
+  TEST_ASSERT_TRUE(util.setTopicQos(stateTopic, 1));
+  connect(util);
+
+  JsonDocument doc;
+  doc["temp"] = 21.5;
+  mqttClient.mockAck = 0;
+  TEST_ASSERT_EQUAL_INT(PUB_BUFFERED, util.sendPackets(doc, stateTopic));
+  TEST_ASSERT_EQUAL_UINT8(1, mqttClient.getMessage(0)->qos);
+  TEST_ASSERT_EQUAL_UINT16(1, util.getBackfillCount());
+}
+
+void test_send_packets_offline() {
+  WiFiClient wifiClient;
+  MqttClient mqttClient(wifiClient);
+  MqttUtility util(wifiClient, mqttClient, "ssid", "psk", "broker", 1883);
+
+  JsonDocument doc;
+  doc["temp"] = 21.5;
+  TEST_ASSERT_EQUAL_INT(PUB_DROPPED, util.sendPackets(doc, stateTopic));
+  util.setBackfillTopic(backfillTopic);
+  TEST_ASSERT_EQUAL_INT(PUB_BUFFERED, util.sendPackets(doc, stateTopic));
+  TEST_ASSERT_EQUAL_UINT16(0, mqttClient.getMessageCount());
+  TEST_ASSERT_EQUAL_UINT32(0, mockIo.bytes);
+}
+
+void test_send_frame_single_write() {
+  WiFiClient wifiClient;
+  MqttClient mqttClient(wifiClient);
+  MqttUtility util(wifiClient, mqttClient, "ssid", "psk", "broker", 1883);
+  connect(util);
+
+  StateFrame frame;
+  frame.set("temp", 21.5f, 1);
+  frame.setFixed("smst1", 499, 1);
+  frame.setStats("temp", 21.0f, 21.25f, 21.5f);
+  uint32_t writes = mockIo.writes;
+  TEST_ASSERT_EQUAL_INT(PUB_OK, util.sendFrame(frame, stateTopic));
+
+  const char expected[] = "{\"temp\":21.5,\"smst1\":49.9,\"stats\":{\"temp\":[21.0,21.3,21.5]}}";
+  const mock_message* msg = mqttClient.getMessage(0);
+  assertPayload(expected, msg);
+  TEST_ASSERT_EQUAL_UINT32(msg->length, msg->announced);
+  // The rendered frame goes to the socket as is, one write() without an intermediate buffer
+  TEST_ASSERT_EQUAL_UINT32(1, mockIo.writes - writes);
+}
+
+void test_send_frame_backfill() {
+  WiFiClient wifiClient;
+  MqttClient mqttClient(wifiClient);
+  MqttUtility util(wifiClient, mqttClient, "ssid", "psk", "broker", 1883);
+  util.setBackfillTopic(backfillTopic);
+
+  StateFrame frame;
+  frame.set("temp", 21.5f, 1);
+  TEST_ASSERT_EQUAL_INT(PUB_BUFFERED, util.sendFrame(frame, stateTopic));
+  TEST_ASSERT_EQUAL_UINT16(1, util.getBackfillCount());
+
+  mockAdvance(30000);
+  connect(util);
+  mockAdvance(MQTTU_BACKFILL_INTERVAL);
+  util.tick();
+
+  TEST_ASSERT_EQUAL_UINT16(0, util.getBackfillCount());
+  TEST_ASSERT_EQUAL_UINT16(1, mqttClient.getMessageCount());
+  const mock_message* msg = mqttClient.getMessage(0);
+  TEST_ASSERT_EQUAL_STRING(backfillTopic, msg->topic);
+  // No network time in the mock, readings are sent with their age in seconds
+  assertPayload("[{\"temp\":21.5,\"age\":31}]", msg);
+}
+
+void test_send_frame_too_large() {
+  WiFiClient wifiClient;
+  MqttClient mqttClient(wifiClient);
+  MqttUtility util(wifiClient, mqttClient, "ssid", "psk", "broker", 1883);
+  connect(util);
+
+  StateFrame frame;
+  static const char* keys[] = {
+    "k00_xxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxx", "k01_xxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxx",
+    "k02_xxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxx", "k03_xxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxx",
+    "k04_xxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxx", "k05_xxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxx",
+    "k06_xxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxx", "k07_xxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxx",
+    "k08_xxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxx", "k09_xxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxx",
+  };
+  for (uint8_t i = 0; i < 10; i++) frame.set(keys[i], 1.0f);
+  TEST_ASSERT_EQUAL_INT(PUB_DROPPED, util.sendFrame(frame, stateTopic));
+  TEST_ASSERT_EQUAL_UINT16(0, mqttClient.getMessageCount());
+}
+
+int main(int argc, char** argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_send_packets);
+  RUN_TEST(test_send_packets_unacknowledged_is_buffered);
+  RUN_TEST(test_send_packets_offline);
+  RUN_TEST(test_send_frame_single_write);
+  RUN_TEST(test_send_frame_backfill);
+  RUN_TEST(test_send_frame_too_large);
+  return UNITY_END();
+}
@@ -0,0 +1,138 @@
+/*
+  Author: Ilari Mattsson
+  project: MKR1010_Indoor_Plant_Monitor
+  File: test_reduce/test_main.cpp
+
+  Moisture batch sampling and reduction as in measureData(), pio test -e native
+*/
+
+#include <Native_Mocks.h>
+#include <Mqtt_Utility.h>
+#include <Moisture_Sampler.h>
+#include "local_utils.h"
+#include <unity.h>
+
+static mst_sen mstArray[] = {
+  MST_SENSOR("1", A0)
+  MST_SENSOR("2", A1)
+};
+static const int mstArraySize = sizeof(mstArray) / sizeof(mstArray[0]);
+
+static MoistureSampler mstSampler;
+static uint16_t reads[NUM_PINS];
+
+// A0 alternates 600/601, A1 reads above the dry calibration
+static int probes(uint8_t pin) {
+  if (pin == A0) return 600 + (reads[pin]++ & 1);
+  if (pin == A1) return 1023;
+  return 0;
+}
+
+static void runBatch(uint16_t rounds) {
+  mstSampler.begin(mstArray, mstArraySize, rounds);
+  mstSampler.start();
+  for (uint16_t i = 0; i < rounds; i++) mstSampler.tick();
+}
+
+void setUp() {
+  mockReset();
+  mockAnalog(probes);
+  memset(reads, 0, sizeof(reads));
+  for (int i = 0; i < mstArraySize; i++) {
+    mstArray[i].val = 0;
+    setCalibration(mstArray[i], 800, 400);
+  }
+}
+
+void tearDown() {
+}
+
+void test_reduce_keeps_fraction_of_mean() {
+  runBatch(10);
+  TEST_ASSERT_EQUAL_INT32(6005, mstArray[0].sum);
+  TEST_ASSERT_TRUE(mstSampler.reduce());
+  // Mean 600.5 is 49.875 %, truncating the mean first would give 50.0 %
+  TEST_ASSERT_EQUAL_INT16(499, mstArray[0].val);
+}
+
+void test_readings_constrained_to_calibration() {
+  runBatch(4);
+  TEST_ASSERT_EQUAL_INT32(4 * 800, mstArray[1].sum);
+  mstSampler.reduce();
+  TEST_ASSERT_EQUAL_INT16(0, mstArray[1].val);
+
+  setCalibration(mstArray[0], 900, 700);
+  runBatch(4);
+  mstSampler.reduce();
+  TEST_ASSERT_EQUAL_INT16(1000, mstArray[0].val);
+}
+
+void test_calibration_after_begin() {
+  // setCalibration() keeps the batch length begin() set on the scale
+  mstSampler.begin(mstArray, mstArraySize, 10);
+  setCalibration(mstArray[0], 800, 400);
+  mstSampler.start();
+  for (uint8_t i = 0; i < 10; i++) mstSampler.tick();
+  TEST_ASSERT_TRUE(mstSampler.reduce());
+  TEST_ASSERT_EQUAL_INT16(499, mstArray[0].val);
+}
+
+void test_reduce_waits_for_batch() {
+  mstSampler.begin(mstArray, mstArraySize, 10);
+  mstSampler.start();
+  for (uint8_t i = 0; i < 9; i++) TEST_ASSERT_FALSE(mstSampler.tick());
+  TEST_ASSERT_FALSE(mstSampler.reduce());
+  TEST_ASSERT_EQUAL_INT16(0, mstArray[0].val);
+  TEST_ASSERT_TRUE(mstSampler.tick());
+  TEST_ASSERT_TRUE(mstSampler.reduce());
+  // A reduced batch is not reduced again
+  TEST_ASSERT_FALSE(mstSampler.reduce());
+}
+
+static void measureData(ReportGate& reportGate, int8_t mstFirstChannel) {
+  if (mstSampler.reduce()) {
+    for (int i = 0; i < mstArraySize; i++) reportGate.update(mstFirstChannel + i, mstArray[i].val);
+  }
+}
+
+void test_measure_data_to_frame() {
+  ReportGate reportGate(60000);
+  // Deadband in tenths, as the values
+  int8_t mstFirstChannel = reportGate.addChannel(mstArray[0].val_id, 10, false);
+  reportGate.addChannel(mstArray[1].val_id, 10, false);
+
+  runBatch(10);
+  measureData(reportGate, mstFirstChannel);
+  TEST_ASSERT_TRUE(reportGate.isDue(1000));
+
+  StateFrame frame;
+  for (int i = 0; i < mstArraySize; i++) frame.setFixed(mstArray[i].val_id, mstArray[i].val, 1);
+  reportGate.addStats(frame);
+  reportGate.markReported(1000);
+  const char expected[] = "{\"smst1\":49.9,\"smst2\":0.0}";
+  size_t len = frame.render();
+  TEST_ASSERT_EQUAL_UINT32(strlen(expected), len);
+  TEST_ASSERT_EQUAL_MEMORY(expected, frame.getPayload(), len);
+
+  // Same readings stay inside the deadband
+  runBatch(10);
+  measureData(reportGate, mstFirstChannel);
+  TEST_ASSERT_FALSE(reportGate.isDue(2000));
+
+  // 49.9 % -> 100.0 % crosses it
+  setCalibration(mstArray[0], 900, 700);
+  runBatch(10);
+  measureData(reportGate, mstFirstChannel);
+  TEST_ASSERT_TRUE(reportGate.isTriggered());
+  TEST_ASSERT_TRUE(reportGate.isDue(3000));
+}
+
+int main(int argc, char** argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_reduce_keeps_fraction_of_mean);
+  RUN_TEST(test_readings_constrained_to_calibration);
+  RUN_TEST(test_calibration_after_begin);
+  RUN_TEST(test_reduce_waits_for_batch);
+  RUN_TEST(test_measure_data_to_frame);
+  return UNITY_END();
+}
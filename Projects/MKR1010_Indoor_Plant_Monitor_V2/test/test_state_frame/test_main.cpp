@@ -0,0 +1,124 @@
+/*
+  Author: Ilari Mattsson
+  project: MKR1010_Indoor_Plant_Monitor
+  File: test_state_frame/test_main.cpp
+
+  StateFrame JSON rendering and MessagePack encoding, pio test -e native
+*/
+
+#include <Native_Mocks.h>
+#include <Mqtt_Utility.h>
+#include <unity.h>
+
+static StateFrame frame;
+
+void setUp() {
+  mockReset();
+  frame.clear();
+}
+
+void tearDown() {
+}
+
+static void assertPayload(const char* expected, size_t len) {
+  TEST_ASSERT_EQUAL_UINT32(strlen(expected), len);
+  TEST_ASSERT_EQUAL_MEMORY(expected, frame.getPayload(), len);
+}
+
+void test_render_float_and_fixed_fields() {
+  frame.set("temp", 21.456f);
+  frame.setFixed("smst1", 435, 1);
+  frame.setFixed("neg", -5, 1);
+  frame.set("sun", 120, 0);
+  assertPayload("{\"temp\":21.46,\"smst1\":43.5,\"neg\":-0.5,\"sun\":120}", frame.render());
+}
+
+void test_render_fixed_keeps_leading_zeros() {
+  frame.setFixed("a", 1005, 3);
+  frame.setFixed("b", 7, 2);
+  assertPayload("{\"a\":1.005,\"b\":0.07}", frame.render());
+}
+
+void test_render_nan_as_null() {
+  frame.set("humi", NAN);
+  assertPayload("{\"humi\":null}", frame.render());
+}
+
+void test_set_overwrites_key() {
+  frame.set("temp", 20.0f, 1);
+  frame.set("temp", 22.5f, 1);
+  TEST_ASSERT_EQUAL_UINT8(1, frame.size());
+  assertPayload("{\"temp\":22.5}", frame.render());
+}
+
+void test_render_stats() {
+  frame.set("temp", 21.0f, 1);
+  frame.set("sun", 120, 0);
+  frame.setStats("temp", 20.5f, 21.0f, 21.5f);
+  frame.setStats("sun", 100, 112.5f, 130);
+  TEST_ASSERT_EQUAL_UINT8(3, frame.size());
+  assertPayload("{\"temp\":21.0,\"sun\":120,\"stats\":{\"temp\":[20.5,21.0,21.5],\"sun\":[100.0,112.5,130.0]}}",
+                frame.render());
+}
+
+void test_stats_without_value() {
+  // An unavailable sensor keeps its stats, its value is left out
+  frame.setStats("humi", 40, 41, 42);
+  assertPayload("{\"stats\":{\"humi\":[40.00,41.00,42.00]}}", frame.render());
+}
+
+void test_overflow_renders_nothing() {
+  static const char* keys[] = {
+    "key_with_a_long_name_00_xxxxxxxxxxxxxxxxxx", "key_with_a_long_name_01_xxxxxxxxxxxxxxxxxx",
+    "key_with_a_long_name_02_xxxxxxxxxxxxxxxxxx", "key_with_a_long_name_03_xxxxxxxxxxxxxxxxxx",
+    "key_with_a_long_name_04_xxxxxxxxxxxxxxxxxx", "key_with_a_long_name_05_xxxxxxxxxxxxxxxxxx",
+    "key_with_a_long_name_06_xxxxxxxxxxxxxxxxxx", "key_with_a_long_name_07_xxxxxxxxxxxxxxxxxx",
+    "key_with_a_long_name_08_xxxxxxxxxxxxxxxxxx", "key_with_a_long_name_09_xxxxxxxxxxxxxxxxxx",
+    "key_with_a_long_name_10_xxxxxxxxxxxxxxxxxx", "key_with_a_long_name_11_xxxxxxxxxxxxxxxxxx",
+  };
+  for (uint8_t i = 0; i < STATE_FRAME_FIELDS; i++) TEST_ASSERT_TRUE(frame.set(keys[i], 1.0f));
+  TEST_ASSERT_FALSE(frame.set("one_more", 1.0f));
+  TEST_ASSERT_EQUAL_UINT32(0, frame.render());
+}
+
+void test_pack() {
+  frame.setFixed("a", 1, 0);
+  frame.set("b", 2.5f);
+  frame.set("c", 300, 0);
+  frame.setStats("a", 0, 1, 2);
+  uint8_t packed[64];
+  size_t len = frame.pack(packed, sizeof(packed));
+  const uint8_t expected[] = {
+    0x84,                                      // map of 4
+    0xa1, 'a', 0x01,                           // fixint
+    0xa1, 'b', 0xca, 0x40, 0x20, 0x00, 0x00,   // float32 2.5
+    0xa1, 'c', 0xd2, 0x00, 0x00, 0x01, 0x2c,   // int32 300
+    0xa5, 's', 't', 'a', 't', 's', 0x81,
+    0xa1, 'a', 0x93,
+    0xca, 0x00, 0x00, 0x00, 0x00,              // 0.0
+    0xca, 0x3f, 0x80, 0x00, 0x00,              // 1.0
+    0xca, 0x40, 0x00, 0x00, 0x00,              // 2.0
+  };
+  TEST_ASSERT_EQUAL_UINT32(sizeof(expected), len);
+  TEST_ASSERT_EQUAL_UINT8_ARRAY(expected, packed, len);
+}
+
+void test_pack_overflow() {
+  frame.set("temp", 21.0f);
+  uint8_t packed[4];
+  TEST_ASSERT_EQUAL_UINT32(0, frame.pack(packed, sizeof(packed)));
+}
+
+int main(int argc, char** argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_render_float_and_fixed_fields);
+  RUN_TEST(test_render_fixed_keeps_leading_zeros);
+  RUN_TEST(test_render_nan_as_null);
+  RUN_TEST(test_set_overwrites_key);
+  RUN_TEST(test_render_stats);
+  RUN_TEST(test_stats_without_value);
+  RUN_TEST(test_overflow_renders_nothing);
+  RUN_TEST(test_pack);
+  RUN_TEST(test_pack_overflow);
+  return UNITY_END();
+}
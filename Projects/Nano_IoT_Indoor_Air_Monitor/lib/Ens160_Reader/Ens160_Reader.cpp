@@ -0,0 +1,74 @@
+/*
+  Author: Ilari Mattsson
+  Library: Ens160 Reader
+  File: Ens160_Reader.cpp
+  Version: 1.0
+*/
+
+#include "Ens160_Reader.h"
+#include <Arduino.h>
+
+
+Ens160Reader::Ens160Reader(TwoWire* wire, uint8_t address):
+  _wire(wire),
+  _address(address),
+  _status(0),
+  _aqi(0),
+  _tvoc(0),
+  _eco2(0) {
+}
+
+// ================================ Class public methods ========================================
+
+bool Ens160Reader::compensate(float temperature, float humidity) {
+  if (isnan(temperature) || isnan(humidity)) return false;
+
+  // TEMP_IN: Kelvin * 64, RH_IN: %RH * 512, little endian
+  uint16_t t = (uint16_t)((temperature + 273.15f) * 64.0f + 0.5f);
+  uint16_t h = (uint16_t)(constrain(humidity, 0.0f, 100.0f) * 512.0f + 0.5f);
+  uint8_t data[4] = { (uint8_t)t, (uint8_t)(t >> 8), (uint8_t)h, (uint8_t)(h >> 8) };
+
+  _wire->beginTransmission(_address);
+  _wire->write(ENS160_REG_TEMP_IN);
+  _wire->write(data, sizeof(data));
+  return _wire->endTransmission() == 0;
+}
+
+bool Ens160Reader::read() {
+  uint8_t data[ENS160_DATA_LENGTH];
+
+  // Register address auto-increments, repeated start keeps the bus between write and read
+  _wire->beginTransmission(_address);
+  _wire->write(ENS160_REG_DEVICE_STATUS);
+  if (_wire->endTransmission(false) != 0) return false;
+  if (_wire->requestFrom(_address, (size_t)ENS160_DATA_LENGTH) != ENS160_DATA_LENGTH) return false;
+  for (uint8_t i = 0; i < ENS160_DATA_LENGTH; i++) data[i] = _wire->read();
+
+  _status = data[0];
+  if (!(_status & ENS160_STATUS_NEWDAT)) return false;
+  if (ENS160_STATUS_VALIDITY(_status) == ENS160_VALIDITY_INVALID) return false;
+
+  uint8_t aqi = data[1] & 0x07;
+  if (aqi < 1 || aqi > 5) return false;
+
+  _aqi = aqi;
+  _tvoc = (uint16_t)data[2] | ((uint16_t)data[3] << 8);
+  _eco2 = (uint16_t)data[4] | ((uint16_t)data[5] << 8);
+  return true;
+}
+
+uint8_t Ens160Reader::getStatus() const {
+  return _status;
+}
+
+uint8_t Ens160Reader::getAQI() const {
+  return _aqi;
+}
+
+uint16_t Ens160Reader::getTVOC() const {
+  return _tvoc;
+}
+
+uint16_t Ens160Reader::getECO2() const {
+  return _eco2;
+}
@@ -0,0 +1,72 @@
+/*
+  Register level data path for the ENS160 air quality sensor.
+  Start-up and operating mode are still handled by DFRobot_ENS160, this reader replaces the
+  per value getters, which take one I2C transaction each and do not look at the data-ready flag.
+
+  > Implements:
+    - Burst read of DEVICE_STATUS, DATA_AQI, DATA_TVOC and DATA_ECO2 (0x20..0x25) in one transaction
+    - Data-ready gating: a sample is only accepted when DEVICE_STATUS.NEWDAT is set,
+      reading the data registers clears the flag
+    - Validity check: samples flagged invalid output are rejected, warm-up samples are kept
+    - Temperature and humidity compensation written to TEMP_IN and RH_IN (0x13..0x16) in one transaction
+
+  Author: Ilari Mattsson
+  Library: Ens160 Reader
+  File: Ens160_Reader.h
+  Version: 1.0
+*/
+
+#ifndef ENS160_READER_H
+#define ENS160_READER_H
+
+#include <Arduino.h>
+#include <Wire.h>
+
+#define ENS160_READER_VERSION "1.0"
+
+#define ENS160_REG_TEMP_IN 0x13
+#define ENS160_REG_DEVICE_STATUS 0x20
+#define ENS160_DATA_LENGTH 6            // DEVICE_STATUS, DATA_AQI, DATA_TVOC (2), DATA_ECO2 (2)
+#define ENS160_STATUS_NEWDAT 0x02
+#define ENS160_STATUS_VALIDITY(status) (((status) >> 2) & 0x03)
+#define ENS160_VALIDITY_INVALID 3
+
+class Ens160Reader {
+public:
+  Ens160Reader(TwoWire* wire, uint8_t address);
+
+  /**
+   * Write ambient conditions used by the sensor for compensation. The sensor updates its
+   * readings once a second in standard mode, the next sample uses the new values.
+   * params:
+   *   float temperature: °C
+   *   float humidity: %RH
+   * returns: bool: false if the values are not numbers or the write was not acknowledged
+   */
+  bool compensate(float temperature, float humidity);
+
+  /**
+   * Read status and all data registers in one transaction.
+   * returns: bool: true if a new valid sample was read, false on bus error, no new data or invalid output
+   */
+  bool read();
+
+  /**
+   * DEVICE_STATUS from the last read(), also set when the sample was rejected
+   */
+  uint8_t getStatus() const;
+
+  uint8_t getAQI() const;
+  uint16_t getTVOC() const;
+  uint16_t getECO2() const;
+
+private:
+  TwoWire* _wire;
+  uint8_t _address;
+  uint8_t _status;
+  uint8_t _aqi;
+  uint16_t _tvoc;
+  uint16_t _eco2;
+};
+
+#endif  // ENS160_READER_H
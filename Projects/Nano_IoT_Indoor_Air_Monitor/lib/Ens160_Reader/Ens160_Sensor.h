@@ -0,0 +1,74 @@
+/*
+  SensorSet policy for the ENS160 (common/libraries/Sensors/Sensor_Set.h).
+  Start-up and operating mode go through DFRobot_ENS160, samples are read with Ens160Reader.
+  Emits "aqi", "tvoc" (ppb), "co2c" (ppm) and "co2l", a 1..5 eCO2 level.
+
+  Author: Ilari Mattsson
+  Library: Ens160 Reader
+  File: Ens160_Sensor.h
+  Version: 1.1
+*/
+
+#ifndef ENS160_SENSOR_H
+#define ENS160_SENSOR_H
+
+#include <Arduino.h>
+#include <Wire.h>
+#include <DFRobot_ENS160.h>
+#include <Sensor_Convert.h>
+#include "Ens160_Reader.h"
+
+// eCO2 ppm where levels 2..5 start, below the first limit is level 1
+constexpr uint16_t ENS160_CO2_LEVELS[] = { 600, 800, 1000, 1500 };
+static_assert(isAscending(ENS160_CO2_LEVELS), "ENS160_CO2_LEVELS must be ascending");
+
+template <uint8_t Address = 0x53>
+class Ens160Sensor {
+public:
+  Ens160Sensor():
+    _ens(&Wire, Address),
+    _reader(&Wire, Address),
+    _co2Level(0) {
+  }
+
+  static const char* name() {
+    return "ens";
+  }
+
+  bool begin() {
+    if (_ens.begin() != NO_ERR) return false;
+    _ens.setPWRMode(ENS160_STANDARD_MODE);  // ENS160_SLEEP_MODE | ENS160_IDLE_MODE | ENS160_STANDARD_MODE
+    return true;
+  }
+
+  /**
+   * Waits for the next sample if the current one has been read already, invalid output is rejected
+  */
+  bool read() {
+    if (!_reader.read()) return false;
+    _co2Level = 1 + bandOf(_reader.getECO2(), ENS160_CO2_LEVELS);
+    return true;
+  }
+
+  /**
+   * Ambient conditions for compensation of the next sample
+  */
+  bool compensate(float temperature, float humidity) {
+    return _reader.compensate(temperature, humidity);
+  }
+
+  template <typename F>
+  void emit(F& sink) const {
+    sink.set("aqi", _reader.getAQI(), 0);
+    sink.set("tvoc", _reader.getTVOC(), 0);
+    sink.set("co2c", _reader.getECO2(), 0);
+    sink.set("co2l", _co2Level, 0);
+  }
+
+private:
+  DFRobot_ENS160_I2C _ens;
+  Ens160Reader _reader;
+  uint8_t _co2Level;
+};
+
+#endif // ENS160_SENSOR_H
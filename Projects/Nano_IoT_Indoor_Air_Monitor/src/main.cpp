@@ -8,7 +8,62 @@
   - BME280 Humidity readout is consistently too low (~14%) compared to a known good DHT22 sensor
 
   Changes:
-  none
+  [1.12] --------------
+  > Firmware updates over MQTT
+    - With MQTTU_OTA, firmware is uploaded with common/scripts/ota_send.py. The image is streamed into the
+      upper flash half and applied after its CRC checks, sampling and reports pause during the download
+  [1.11] --------------
+  > Integer conversions
+    - The eCO2 level is classified against a threshold table checked at compile time (Sensor_Convert.h)
+  [1.10] --------------
+  > Network selection
+    - S_SSID_2 in arduino_secrets.h adds a second network, the stronger one is joined from a scan. A weak
+      link (MQTTU_ROAM_RSSI) is re-evaluated every few minutes and the node moves to a clearly stronger network
+  [1.9] --------------
+  > Publish acknowledgements
+    - State and backfill messages are published at QoS 1. A reading that is neither published nor buffered
+      for backfill leaves the report gate due and is reported again at the next sample
+  [1.8] --------------
+  > Persistent MQTT session
+    - Connects under the device id with clean session off, a dropped broker connection recovers with
+      one CONNECT when the broker answers the first attempt. Commands sent while offline are queued (QoS 1)
+  [1.7] --------------
+  > Sensor set
+    - Sensors are driver policies in a SensorSet (common/libraries/Sensors), reads, availability and
+      payload fields are expanded at compile time
+    - ENS160 policy (lib/Ens160_Reader/Ens160_Sensor.h) owns start-up, reads and the CO2 level
+  [1.6] --------------
+  > State frame
+    - State payloads are set in a static StateFrame and serialized once by Mqtt_Utility, sendData()
+      no longer measures, serializes and copies a JsonDocument
+  [1.5] --------------
+  > Runtime configuration
+    - interval, heartbeat, sensor timeout and calibration offsets can be changed with a JSON document on
+      the command topic, e.g. {"interval": 120, "temp_offset": -3.2}. Changes apply live and are saved to flash
+  [1.4] --------------
+  > Change-based reporting
+    - Sensors are sampled every interval, a report is published when a value crosses its deadband
+      (e.g. a CO2 level change) or when heartbeat has elapsed since the last report
+    - Reports carry min/mean/max of the samples since the previous report under "stats"
+  [1.3] --------------
+  > ENS160 data path
+    - ENS160 data is read in one burst I2C transaction per cycle (Ens160_Reader) instead of one per value
+    - Samples are only accepted when the sensor flags new data
+    - Latest BME280 temperature and humidity are written to the ENS160 for compensation every cycle,
+      not only at boot (the boot-time write also had temperature and humidity swapped)
+    - BME280 and compensation are handled in sampleTask, the ENS160 is read in publishTask on a sample taken after compensation
+  [1.2] --------------
+  > Supervisor
+    - A sensor that does not start is retried with backoff, the node runs without it instead of halting
+    - Boot continues without WiFi/MQTT, discovery is configured on the first connection
+    - Watchdog resets are counted per boot stage, a stage that keeps crashing is skipped (SENSORS_WATCHDOG)
+    - Reset reason and crash count are published on the availability topic
+  [1.1] --------------
+  > Bounded sensor reads
+    - BME280 and ENS160 reads are retried for SENSOR_TIMEOUT ms instead of forever, last good values are kept
+    - ENS160 readings are rejected while the sensor reports invalid output
+    - Per sensor availability is published on the availability topic, values are left out while unavailable
+    - Optional hardware watchdog (SENSORS_WATCHDOG)
 
   Board(s):
     - Arduino MKR WiFi 1010 (platformio.ini env not configured)
@@ -21,185 +76,358 @@
   Author: Ilari Mattsson
   Project Nano IoT Indroor Air Sensor
   File: main.cpp
-  Version: 1.0
+  Version: 1.12
 */
 
 #include <Arduino.h>
 #include <WiFiNINA.h>
-#include <DFRobot_ENS160.h>
-#include "DFRobot_BME280.h"
 #include <Mqtt_Utility.h>
+#include <Task_Scheduler.h>
+#include <Sensor_Set.h>
+#include <drivers/bme280_sensor.h>
+#include <Ens160_Sensor.h>
+#include <Supervisor.h>
+#include <Node_Config.h>
 #include "arduino_secrets.h"
 
 // ------- Globals ------------
 // > Macros
+#define FW_VERSION "1.12"  // Version in the header above, published as the device sw_version
 #define CASE_LED 2 // LED_BUILTIN
+// #define DEVICE_DISCOVERY  // Single device-based discovery message, remove old per-sensor configs from the broker first
 #define ENS_ADDR 0x53
 #define BME_ADDR 0x76
 
 // > Secrets
 char ssid[] = S_SSID;
 char psk[] = S_PASS;
+// The strongest network in range is joined, S_SSID_2 is e.g. a repeater with its own SSID
+const wifi_cred networks[] = {
+  { ssid, psk },
+  #ifdef S_SSID_2
+  { S_SSID_2, S_PASS_2 },
+  #endif
+};
 char host[] = S_MQTT_ADDR;
 uint16_t port = S_MQTT_PORT;
 char user[] = S_MQTT_USER;
 char pass[] = S_MQTT_PASS;
 
 // > Configuration variables
-const uint32_t interval = 300000;
-uint32_t previous = 0;
+#ifdef MQTTU_LOW_POWER
+const uint32_t interval = 300000;   // Sampling period, every wake reconnects WiFi so sample at the heartbeat
+#else
+const uint32_t interval = 60000;    // Sampling period
+#endif
+const uint32_t heartbeat = 300000;  // Longest time between reports while readings stay within their deadbands
+const uint32_t sample_lead = 2000;  // Sample sensors this many ms before publishing
+#ifdef MQTTU_LOW_POWER
+const uint32_t wake_lead = 10000;   // Wake up this many ms before sampling to reconnect
+const uint32_t sleep_min = 30000;   // Stay awake if the board would sleep less than this
+#endif
+const uint32_t poll_interval = 10;
+const uint32_t led_interval = 500;
 const uint16_t sensor_timeout = 3600;
 
 // > Sensors
-DFRobot_ENS160_I2C ens(&Wire, ENS_ADDR);
-DFRobot_BME280_IIC bme(&Wire, BME_ADDR);
-float temperature;
-uint32_t humidity, pressure;
-uint16_t volatite_organic_compounds, co2_concentration;
-uint8_t air_quality_index, co2_level;
+typedef Bme280Sensor<BME_ADDR> BmeSensor;
+typedef Ens160Sensor<ENS_ADDR> EnsSensor;
+SensorSet<BmeSensor, EnsSensor> sensors;
 
 // > Calibration offsets
 const float temperature_offset = -3.6;
 const int humidity_offset = 14;
 
+// > Runtime configuration, the constants above are defaults for a config document on the command topic
+const node_cfg config_defaults = { interval, heartbeat, sensor_timeout, 1, temperature_offset, humidity_offset };
+NodeConfig node_config(config_defaults);
+
+// > Reporting deadbands, a change this large since the last report is published immediately
+const float temperature_deadband = 0.5, humidity_deadband = 3, pressure_deadband = 100;  // °C, %, Pa
+const float aqi_deadband = 1, tvoc_deadband = 100, co2_deadband = 100, co2_level_deadband = 1;
+ReportGate report_gate(heartbeat);
+StateFrame state_frame;  // State payload, rendered once per report
+
 // > Clients
 // Uncomment one wifiClient declaration (standard / SSL)
 WiFiClient wifiClient;
 //WiFiSSLClient wifiClient;
 MqttUtility mqttUtility(wifiClient);
+TaskScheduler scheduler;
+int8_t sample_task_id, publish_task_id;
+Supervisor supervisor;
+bool is_configured = false;  // Discovery sent, deferred until the first connection
+
+// > Boot stages, a stage that crashes SUPERVISOR_MAX_CRASHES boots in a row is skipped
+enum boot_stage { STAGE_BME = 1, STAGE_ENS };
 
 // > Sensor const variables
-const char state_topic[] = "homeassistant/sensor/blueC/state";
-const char device_name[] = "BlueC";
-const char device_name_lower[] = "blueC";
-const uint8_t num_of_sensors = 7;
+#define DEVICE_NAME "BlueC"
+#define DEVICE_ID "blueC"
+const char state_topic[] = MQTTU_STATE_TOPIC(DEVICE_ID);
+const char command_topic[] = MQTTU_COMMAND_TOPIC(DEVICE_ID);
+const char availability_topic[] = MQTTU_AVAILABILITY_TOPIC(DEVICE_ID);
+const char backfill_topic[] = MQTTU_BACKFILL_TOPIC(DEVICE_ID);  // Readings missed while offline
+const char packed_topic[] = MQTTU_PACKED_TOPIC(DEVICE_ID);
+const char diag_topic[] = MQTTU_DIAGNOSTICS_TOPIC(DEVICE_ID);
+const char ota_topic[] = MQTTU_OTA_TOPIC(DEVICE_ID);
+const char ota_status_topic[] = MQTTU_OTA_STATUS_TOPIC(DEVICE_ID);
+const mdev_info device = MQTTU_DEVICE(DEVICE_NAME, DEVICE_ID, "Nano IoT Indoor Air Monitor", FW_VERSION);
 
 // Homeassistant sensor device classes: https://www.home-assistant.io/integrations/sensor/#device-class
 // Homeassistant JSON templating: https://www.home-assistant.io/docs/configuration/templating
 
-const char *sensors[5][num_of_sensors] = { /*{{long name}, {short name}, {device class}, {unit}, {formatting}}*/
-  { "Temperature", "Humidity", "Pressure", "AQI", "TVOC", "CO2 Concentration", "CO2 Level" },                     
-  { "temp", "humi", "pres", "aqi", "tvoc", "co2c", "co2l" },                                                      
-  { "temperature", "humidity", "pressure", "aqi", "volatile_organic_compounds_parts", "carbon_dioxide", "None" },
-  { "°C", "%", "hPa", NULL, "ppb", "ppm", NULL },
-  { " | round(1)", " | round(1)", " | float / 100 | round(2)" , "", "", "", "" }
+const mdev discovery[] = { /* expires_after is replaced by the configured sensor timeout when published. MQTTU_SENSOR(device name, device id, {long name}, {short name}, {device class}, {unit}, {formatting}, expire after) */
+  MQTTU_SENSOR_AVTY(DEVICE_NAME, DEVICE_ID, "Temperature", "temp", "temperature", "°C", " | round(1)", sensor_timeout, "bme"),
+  MQTTU_SENSOR_AVTY(DEVICE_NAME, DEVICE_ID, "Humidity", "humi", "humidity", "%", " | round(1)", sensor_timeout, "bme"),
+  MQTTU_SENSOR_AVTY(DEVICE_NAME, DEVICE_ID, "Pressure", "pres", "pressure", "hPa", " | float / 100 | round(2)", sensor_timeout, "bme"),
+  MQTTU_SENSOR_AVTY(DEVICE_NAME, DEVICE_ID, "AQI", "aqi", "aqi", NULL, "", sensor_timeout, "ens"),
+  MQTTU_SENSOR_AVTY(DEVICE_NAME, DEVICE_ID, "TVOC", "tvoc", "volatile_organic_compounds_parts", "ppb", "", sensor_timeout, "ens"),
+  MQTTU_SENSOR_AVTY(DEVICE_NAME, DEVICE_ID, "CO2 Concentration", "co2c", "carbon_dioxide", "ppm", "", sensor_timeout, "ens"),
+  MQTTU_SENSOR_AVTY(DEVICE_NAME, DEVICE_ID, "CO2 Level", "co2l", "None", NULL, "", sensor_timeout, "ens"),
+  #ifdef MQTTU_LOW_POWER
+  MQTTU_SENSOR(DEVICE_NAME, DEVICE_ID, "Average Current", "icur", "current", "mA", " | round(2)", sensor_timeout),
+  #endif
+  #ifdef MQTTU_DIAGNOSTICS
+  MQTTU_DIAGNOSTIC_SENSORS(DEVICE_NAME, DEVICE_ID, sensor_timeout),
+  #endif
 };
 
 // Function declarations
 void measureData();
+void measureAirQuality();
 void sendData();
+void sendAvailability();
+void configureDiscovery();
+void onConfig(JsonObjectConst config);
+void onOta(util_ota_state state);
+void applyConfig(uint8_t changed);
+void pollTask();
+void sampleTask();
+void publishTask();
+void ledTask();
+void sleepCycle();
 
 void setup() {
+  supervisor.begin();
   pinMode(CASE_LED, OUTPUT);
   digitalWrite(CASE_LED, HIGH);
   delay(50);
 
-  // Initialize sensors
-  while (bme.begin() != DFRobot_BME280_IIC::eStatusOK) delay(2000);
-  // while (!bme.init()) delay(1000);
-  while (ens.begin() != NO_ERR) delay(3000);
-  ens.setPWRMode(ENS160_STANDARD_MODE);  // ENS160_SLEEP_MODE | ENS160_IDLE_MODE | ENS160_STANDARD_MODE
-  ens.setTempAndHum(bme.getHumidity() + humidity_offset, bme.getTemperature() + temperature_offset);
+  // Initialize sensors, continue without a sensor that does not start
+  supervisor.setStage(STAGE_BME);
+  if (!supervisor.isSuspect(STAGE_BME)) supervisor.retry([]() { return sensors.begin<BmeSensor>(); });
+  supervisor.setStage(STAGE_ENS);
+  if (!supervisor.isSuspect(STAGE_ENS)) supervisor.retry([]() { return sensors.begin<EnsSensor>(); });
+  sensors.get<BmeSensor>().setKeys("temp", "humi");
+  supervisor.setStage(SUPERVISOR_STAGE_RUN);
+  node_config.load();
+  applyConfig(NODE_CFG_HEARTBEAT | NODE_CFG_TIMEOUT | NODE_CFG_OFFSETS);
+  // Sensors emit into the channels by key
+  report_gate.addChannel("temp", temperature_deadband);
+  report_gate.addChannel("humi", humidity_deadband);
+  report_gate.addChannel("pres", pressure_deadband);
+  report_gate.addChannel("aqi", aqi_deadband);
+  report_gate.addChannel("tvoc", tvoc_deadband);
+  report_gate.addChannel("co2c", co2_deadband);
+  report_gate.addChannel("co2l", co2_level_deadband);
 
   // Initialize WiFi & MQTT
-  mqttUtility.setWiFiNetwork(ssid, psk);
+  mqttUtility.setWiFiNetworks(networks, sizeof(networks) / sizeof(networks[0]));
   mqttUtility.setMqttHost(host, port);
-  mqttUtility.setWifiRetry(5);
+  mqttUtility.setWifiRetry(5);  // Then WiFi off for MQTTU_RETRY_REST, a new round follows
+  mqttUtility.setBackfillTopic(backfill_topic);
+  mqttUtility.setAvailabilityTopic(availability_topic);
+  #ifdef MQTTU_PACKED_STATE  // Also publish state payloads as MessagePack, JSON topic is kept
+  mqttUtility.setPackedTopic(packed_topic);
+  #endif
+  #ifdef MQTTU_DIAGNOSTICS
+  mqttUtility.setDiagnosticsTopic(diag_topic);
+  #endif
   if (strlen(user) > 0 && strlen(pass) > 0) {
     mqttUtility.setMqttUser(user, pass);
     delay(50);
   }
-  if(mqttUtility.begin() != CONN_CONNECTED) {
-    while(1) {
-      digitalWrite(CASE_LED, LOW);
-      delay(800);
-      digitalWrite(CASE_LED, HIGH);
-      delay(200);
-    }
-  }
+  mqttUtility.setPersistentSession(DEVICE_ID);  // Fast reconnects, the broker keeps the subscription
+  mqttUtility.setTopicQos(state_topic, 1);  // Readings count as published once the broker has acknowledged them
+  mqttUtility.setTopicQos(backfill_topic, 1);
+  // Connect in the background, readings are buffered for backfill until connected
+  mqttUtility.setConfigCallback(command_topic, onConfig);
+  #ifdef MQTTU_OTA
+  mqttUtility.setOtaTopics(ota_topic, ota_status_topic, onOta);
+  #endif
+  mqttUtility.start();
   delay(50);
 
-  // Configure MQTT topics
-  for (int i=0; i<num_of_sensors;i++) {
-    String name = String(device_name) + " " + String(sensors[0][i]);
-    String uid = String(device_name_lower) + String(sensors[1][i]);
-    String val_tpl = String("{{ value_json.") + String(sensors[1][i]) + String(sensors[4][i]) + String(" }}");
-    String conf_topic = "homeassistant/sensor/" + uid + "/config";
-    mdevs dev = {String(sensors[2][i]), sensor_timeout, name, String(state_topic), uid, String(sensors[3][i]), val_tpl, conf_topic};
-    mqttUtility.configureTopic(&dev);
-  }
+  // Schedule tasks
+  scheduler.addTask(pollTask, poll_interval);
+  uint32_t period = node_config.get().interval;
+  sample_task_id = scheduler.addTask(sampleTask, period, period - sample_lead);
+  publish_task_id = scheduler.addTask(publishTask, period, period);
+  scheduler.addTask(ledTask, led_interval);
   
   digitalWrite(CASE_LED, LOW);
 }
 
 void loop() {
-  mqttUtility.pollMqtt();
-  unsigned long current = millis();
-  
-  if (current - previous >= interval) {
-    previous = current;
-    digitalWrite(CASE_LED, HIGH);
-    mqttUtility.checkConnection();
-    measureData();
-    sendData();
-    digitalWrite(CASE_LED, LOW);
+  supervisor.kick();
+  scheduler.run();
+}
+
+void pollTask() {
+  if (mqttUtility.tick() == CONN_STATE_CONNECTED && !is_configured) configureDiscovery();
+}
+
+/**
+ * Configure MQTT topics
+*/
+void configureDiscovery() {
+  #ifdef DEVICE_DISCOVERY
+  mqttUtility.configureDevice(device, discovery, node_config.get().sensorTimeout);
+  #else
+  mqttUtility.configureTopic(device, discovery, node_config.get().sensorTimeout);
+  #endif
+  is_configured = true;
+}
+
+void sampleTask() {
+  digitalWrite(CASE_LED, HIGH);
+  #ifdef MQTTU_DIAGNOSTICS
+  PhaseTimer timer(mqttUtility.getPhase(PHASE_SENSOR));
+  #endif
+  measureData();
+}
+
+void publishTask() {
+  {
+    #ifdef MQTTU_DIAGNOSTICS
+    PhaseTimer timer(mqttUtility.getPhase(PHASE_SENSOR));
+    #endif
+    measureAirQuality();
+  }
+  // Samples between reports only go to the statistics
+  if (report_gate.isDue(mqttUtility.monotonicMs()) || sensors.isChanged()) sendData();
+  supervisor.markHealthy();
+  digitalWrite(CASE_LED, LOW);
+  #ifdef MQTTU_LOW_POWER
+  sleepCycle();
+  #endif
+}
+
+/**
+ * Blink case LED while WiFi/MQTT is not connected
+*/
+void ledTask() {
+  static bool isLedOn = false;
+  if (mqttUtility.getState() == CONN_STATE_CONNECTED) {
+    if (isLedOn) digitalWrite(CASE_LED, LOW);
+    isLedOn = false;
+    return;
   }
-  delay(1000);
+  isLedOn = !isLedOn;
+  digitalWrite(CASE_LED, isLedOn ? HIGH : LOW);
 }
 
+/**
+ * Read BME280 and pass the values to the ENS160 for compensation of its next sample
+*/
 void measureData() {
-  /*uint8_t ensStatus = ens.getENS160Status();
-  DFRobot_BME280::eStatus_t bmeStatus = bme.lastOperateStatus;
-  if (bmeStatus != DFRobot_BME280::eStatusOK);*/
-
-  float temp, humi;
-  uint32_t pres;
-
-  do {
-    temp = bme.getTemperature();
-    humi = bme.getHumidity();
-    pres = bme.getPressure();
-  } while (isnan(temp) || isnan(humi) || isnan(pres));
-
-  temperature = temp + temperature_offset;
-  humidity = humi + humidity_offset;
-  pressure = bme.getPressure();
-
-  uint16_t tvoc, eco2;
-  uint8_t aqi;
-
-  do {
-    tvoc = ens.getTVOC();
-    eco2 = ens.getECO2();
-    aqi = ens.getAQI();
-  } while (isnan(tvoc) || isnan(eco2) || isnan(aqi));
-
-  volatite_organic_compounds = tvoc;
-  co2_concentration = eco2;
-  air_quality_index = aqi;
-
-  if(co2_concentration < 600) co2_level = 1;
-  else if (co2_concentration < 800) co2_level = 2;
-  else if (co2_concentration < 1000) co2_level = 3;
-  else if (co2_concentration < 1500) co2_level = 4;
-  else co2_level = 5;
+  // Previous values are kept if a sensor does not answer, sensors that did not start are skipped
+  if (!sensors.acquire<BmeSensor>(report_gate)) return;
+
+  const BmeSensor& bme = sensors.get<BmeSensor>();
+  if (sensors.isEnabled<EnsSensor>()) sensors.get<EnsSensor>().compensate(bme.getTemperature(), bme.getHumidity());
+
+  return;
+}
 
+/**
+ * Read ENS160, runs sample_lead ms after measureData() so the sample is compensated
+*/
+void measureAirQuality() {
+  // Waits for the next sample if the current one has been read already, invalid output is rejected
+  sensors.acquire<EnsSensor>(report_gate);
   return;
 }
 
 void sendData() {
-    JsonDocument doc;
-    doc[sensors[1][0]] = temperature;
-    doc[sensors[1][1]] = humidity;
-    doc[sensors[1][2]] = pressure;
-    doc[sensors[1][3]] = air_quality_index;
-    doc[sensors[1][4]] = volatite_organic_compounds;
-    doc[sensors[1][5]] = co2_concentration;
-    doc[sensors[1][6]] = co2_level;
-    int len = measureJson(doc);
-    char output[len++];
-    serializeJson(doc, output, len);
+    state_frame.clear();
+    sensors.emit(state_frame);
+    #ifdef MQTTU_LOW_POWER
+    state_frame.set("icur", mqttUtility.getAverageCurrent());
+    #endif
+    report_gate.addStats(state_frame);
     mqttUtility.checkConnection();
-    mqttUtility.sendPackets(doc, state_topic);
+    // A dropped reading leaves the gate due, it is reported again at the next sample
+    if (mqttUtility.sendFrame(state_frame, state_topic) != PUB_DROPPED) report_gate.markReported(mqttUtility.monotonicMs());
+    sendAvailability();
     return;
 }
+
+/**
+ * Apply a config document from the command topic, changed settings are saved to flash
+*/
+void onConfig(JsonObjectConst config) {
+  uint8_t changed = node_config.apply(config);
+  if (changed == 0) return;
+  applyConfig(changed);
+  node_config.save();
+}
+
+#ifdef MQTTU_OTA
+/**
+ * Pause sampling and reports while a firmware image is received, NINA only serves the download
+*/
+void onOta(util_ota_state state) {
+  bool is_idle = state != OTA_RECEIVING;
+  // Resumed with the sampling run sample_lead ahead of the report, as scheduled in setup()
+  uint32_t period = node_config.get().interval;
+  scheduler.setEnabled(sample_task_id, is_idle, period - sample_lead);
+  scheduler.setEnabled(publish_task_id, is_idle, period);
+  if (state == OTA_APPLYING) supervisor.pause();  // The flash copy runs without kicks
+}
+#endif
+
+/**
+ * Apply changed settings live. Offsets go to the sensor policies, rounds is not used.
+ * params: uint8_t changed: NODE_CFG_* flags
+*/
+void applyConfig(uint8_t changed) {
+  const node_cfg& cfg = node_config.get();
+  if (changed & NODE_CFG_INTERVAL) {
+    scheduler.setPeriod(sample_task_id, cfg.interval);
+    scheduler.setPeriod(publish_task_id, cfg.interval);
+  }
+  if (changed & NODE_CFG_HEARTBEAT) report_gate.setHeartbeat(cfg.heartbeat);
+  if (changed & NODE_CFG_OFFSETS) sensors.get<BmeSensor>().setOffsets(cfg.temperatureOffset, cfg.humidityOffset);
+  if (changed & NODE_CFG_TIMEOUT) is_configured = false;  // Re-published by pollTask() with the new expiry
+}
+
+/**
+ * Publish sensor availability when it has changed, the retained message holds every sensor and the last reset reason
+*/
+void sendAvailability() {
+  if (!sensors.isChanged()) return;
+  JsonDocument doc;
+  sensors.addAvailability(doc);
+  doc["rst"] = supervisor.getResetReason();
+  doc["crash"] = supervisor.getCrashCount();
+  if (mqttUtility.sendAvailability(doc)) sensors.markReported();
+}
+
+
+#ifdef MQTTU_LOW_POWER
+/**
+ * Sleep until wake_lead ms before the next sampling run, then reconnect in the background
+*/
+void sleepCycle() {
+  #ifdef MQTTU_OTA
+  if (mqttUtility.isOtaActive()) return;
+  #endif
+  int32_t idle = scheduler.timeUntil(sample_task_id) - (int32_t)wake_lead;
+  if (idle < (int32_t)sleep_min) return;
+  supervisor.pause();  // WDT keeps running in standby
+  scheduler.advance(mqttUtility.sleep(idle));
+  supervisor.resume();
+}
+#endif
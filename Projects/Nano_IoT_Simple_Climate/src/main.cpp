@@ -4,6 +4,56 @@
   Implements MQTT Discovery protocol for automatic device discovery and configuration on supported platforms.
 
   Changes:
+  [1.11] -------------
+  > Firmware updates over MQTT
+    - With MQTTU_OTA, firmware is uploaded with common/scripts/ota_send.py. The image is streamed into the
+      upper flash half and applied after its CRC checks, sampling and reports pause during the download
+  [1.10] -------------
+  > BLE leaf node
+    - With BLE_RELAY_NODE, readings are sent over BLE to a gateway node (common/libraries/Ble_Relay) that
+      publishes them on this node's state topic. WiFi is not started, a report is one short BLE connection
+    - Discovery, availability and commands need WiFi: flash once without BLE_RELAY_NODE to publish the
+      retained discovery configs
+  [1.9] --------------
+  > Network selection
+    - S_SSID_2 in arduino_secrets.h adds a second network, the stronger one is joined from a scan. A weak
+      link (MQTTU_ROAM_RSSI) is re-evaluated every few minutes and the node moves to a clearly stronger network
+  [1.8] --------------
+  > Publish acknowledgements
+    - State and backfill messages are published at QoS 1. A reading that is neither published nor buffered
+      for backfill leaves the report gate due and is reported again at the next sample
+  [1.7] --------------
+  > Persistent MQTT session
+    - Connects under the device id with clean session off, a dropped broker connection recovers with
+      one CONNECT when the broker answers the first attempt. Commands sent while offline are queued (QoS 1)
+  [1.6] --------------
+  > Sensor set
+    - Sensors are driver policies in a SensorSet (common/libraries/Sensors), reads, availability and
+      payload fields are expanded at compile time
+  [1.5] --------------
+  > State frame
+    - State payloads are set in a static StateFrame and serialized once by Mqtt_Utility, sendData()
+      no longer measures, serializes and copies a JsonDocument
+  [1.4] --------------
+  > Runtime configuration
+    - interval, heartbeat, sensor timeout and calibration offsets can be changed with a JSON document on
+      the command topic, e.g. {"interval": 120, "temp_offset": -0.4}. Changes apply live and are saved to flash
+  [1.3] --------------
+  > Change-based reporting
+    - Sensors are sampled every interval, a report is published when a value crosses its deadband
+      or when heartbeat has elapsed since the last report
+    - Reports carry min/mean/max of the samples since the previous report under "stats"
+  [1.2] --------------
+  > Supervisor
+    - A sensor that does not start is retried with backoff, the node runs without it instead of halting
+    - Boot continues without WiFi/MQTT, discovery is configured on the first connection
+    - Watchdog resets are counted per boot stage, a stage that keeps crashing is skipped (SENSORS_WATCHDOG)
+    - Reset reason and crash count are published on the availability topic
+  [1.1] --------------
+  > Bounded sensor reads
+    - SHT31 reads are retried for SENSOR_TIMEOUT ms instead of forever, last good values are kept
+    - SHT31 availability is published on the availability topic, values are left out while unavailable
+    - Optional hardware watchdog (SENSORS_WATCHDOG)
 
   Board(s):
     - Arduino MKR WiFi 1010 (platformio.ini env not configured)
@@ -16,150 +66,352 @@
   Author: Ilari Mattsson
   Project Nano IoT Simple Climate
   File: main.cpp
-  Version: 1.0
+  Version: 1.11
 */
 
 #include <Arduino.h>
 #include <WiFiNINA.h>
-#include <SHT31.h>
 #include <Mqtt_Utility.h>
+#include <Task_Scheduler.h>
+#include <Sensor_Set.h>
+#include <drivers/grove_sht31_sensor.h>
+#include <Supervisor.h>
+#include <Node_Config.h>
+#ifdef BLE_RELAY_NODE
+#include <Ble_Relay.h>
+#endif
 #include "arduino_secrets.h"
 
 
 // ------- Globals --------------------------
 // > Macros
+#define FW_VERSION "1.11"  // Version in the header above, published as the device sw_version
 #define CASE_LED 2
+// #define DEVICE_DISCOVERY  // Single device-based discovery message, remove old per-sensor configs from the broker first
 
 // > Secrets
 char ssid[] = S_SSID;
 char psk[] = S_PASS;
+// The strongest network in range is joined, S_SSID_2 is e.g. a repeater with its own SSID
+const wifi_cred networks[] = {
+  { ssid, psk },
+  #ifdef S_SSID_2
+  { S_SSID_2, S_PASS_2 },
+  #endif
+};
 char host[] = S_MQTT_ADDR;
 uint16_t port = S_MQTT_PORT;
 char user[] = S_MQTT_USER;
 char pass[] = S_MQTT_PASS;
 
 // > Configuration variables
-const uint32_t interval = 300000;
-uint32_t previous = 0;
+#ifdef MQTTU_LOW_POWER
+const uint32_t interval = 300000;   // Sampling period, every wake reconnects WiFi so sample at the heartbeat
+#else
+const uint32_t interval = 60000;    // Sampling period
+#endif
+const uint32_t heartbeat = 300000;  // Longest time between reports while readings stay within their deadbands
+const uint32_t sample_lead = 2000;  // Sample sensors this many ms before publishing
+#ifdef MQTTU_LOW_POWER
+const uint32_t wake_lead = 10000;   // Wake up this many ms before sampling to reconnect
+const uint32_t sleep_min = 30000;   // Stay awake if the board would sleep less than this
+#endif
+const uint32_t poll_interval = 10;
+const uint32_t led_interval = 500;
 const uint16_t sensor_timeout = 3600;
 
 // > Sensors
-SHT31 sht31 = SHT31();
-float temperature, humidity;
+typedef GroveSht31Sensor<> ShtSensor;
+SensorSet<ShtSensor> sensors;
 
 // > Calibration offsets
 const float temperature_offset = 0, humidity_offset = 0;
 
+// > Runtime configuration, the constants above are defaults for a config document on the command topic
+const node_cfg config_defaults = { interval, heartbeat, sensor_timeout, 1, temperature_offset, humidity_offset };
+NodeConfig node_config(config_defaults);
+
+// > Reporting deadbands, a change this large since the last report is published immediately
+const float temperature_deadband = 0.5, humidity_deadband = 3;
+ReportGate report_gate(heartbeat);
+StateFrame state_frame;  // State payload, rendered once per report
+
 // > Clients
 // Uncomment only one Client
 WiFiClient wifiClient;
 //WiFiSSLClient wifiClient;
 MqttUtility mqttUtility(wifiClient);
+TaskScheduler scheduler;
+int8_t sample_task_id, publish_task_id;
+Supervisor supervisor;
+bool is_configured = false;  // Discovery sent, deferred until the first connection
+
+// > Boot stages, a stage that crashes SUPERVISOR_MAX_CRASHES boots in a row is skipped
+enum boot_stage { STAGE_SHT = 1 };
 
 // > Sensor const variables
-const char state_topic[] = "homeassistant/sensor/blueA/state";
-const char device_name[] = "BlueA";
-const char device_name_lower[] = "blueA";
-const uint8_t num_of_sensors = 2;
+#define DEVICE_NAME "BlueA"
+#define DEVICE_ID "blueA"
+const char state_topic[] = MQTTU_STATE_TOPIC(DEVICE_ID);
+const char command_topic[] = MQTTU_COMMAND_TOPIC(DEVICE_ID);
+const char availability_topic[] = MQTTU_AVAILABILITY_TOPIC(DEVICE_ID);
+const char backfill_topic[] = MQTTU_BACKFILL_TOPIC(DEVICE_ID);  // Readings missed while offline
+const char packed_topic[] = MQTTU_PACKED_TOPIC(DEVICE_ID);
+const char diag_topic[] = MQTTU_DIAGNOSTICS_TOPIC(DEVICE_ID);
+const char ota_topic[] = MQTTU_OTA_TOPIC(DEVICE_ID);
+const char ota_status_topic[] = MQTTU_OTA_STATUS_TOPIC(DEVICE_ID);
+const mdev_info device = MQTTU_DEVICE(DEVICE_NAME, DEVICE_ID, "Nano IoT Simple Climate", FW_VERSION);
+#ifdef BLE_RELAY_NODE
+BleRelayNode ble_relay(DEVICE_ID);  // Published by the gateway on state_topic
+#endif
 
 // Homeassistant sensor device classes: https://www.home-assistant.io/integrations/sensor/#device-class
 // Homeassistant JSON templating: https://www.home-assistant.io/docs/configuration/templating
 
-// {{long name}, {short name}, {device class}, {unit}, {formatting}}
-const char *sensors[5][num_of_sensors] = { 
-  { "Temperature", "Humidity" },                     
-  { "temp", "humi" },                                                      
-  { "temperature", "humidity" },
-  { "°C", "%" },
-  { " | round(1)", " | round(1)" }
+// MQTTU_SENSOR(device name, device id, {long name}, {short name}, {device class}, {unit}, {formatting}, expire after)
+const mdev discovery[] = {  // expires_after is replaced by the configured sensor timeout when published
+  MQTTU_SENSOR_AVTY(DEVICE_NAME, DEVICE_ID, "Temperature", "temp", "temperature", "°C", " | round(1)", sensor_timeout, "sht"),
+  MQTTU_SENSOR_AVTY(DEVICE_NAME, DEVICE_ID, "Humidity", "humi", "humidity", "%", " | round(1)", sensor_timeout, "sht"),
+  #ifdef MQTTU_LOW_POWER
+  MQTTU_SENSOR(DEVICE_NAME, DEVICE_ID, "Average Current", "icur", "current", "mA", " | round(2)", sensor_timeout),
+  #endif
+  #ifdef MQTTU_DIAGNOSTICS
+  MQTTU_DIAGNOSTIC_SENSORS(DEVICE_NAME, DEVICE_ID, sensor_timeout),
+  #endif
 };
 
 
 // ------- Function declarations ------------
 void measureData();
 void sendData();
+void sendAvailability();
+void configureDiscovery();
+void onConfig(JsonObjectConst config);
+void onOta(util_ota_state state);
+void applyConfig(uint8_t changed);
+void pollTask();
+void sampleTask();
+void publishTask();
+void ledTask();
+void sleepCycle();
 
 
 // ------- Implementation -------------------
 void setup() {
+  supervisor.begin();
   pinMode(CASE_LED, OUTPUT);
   digitalWrite(CASE_LED, HIGH);
   delay(50);
 
-  // Initialize sensors
-  while(!sht31.begin()) delay(1000);
+  // Initialize sensors, continue without a sensor that does not start
+  supervisor.setStage(STAGE_SHT);
+  if (!supervisor.isSuspect(STAGE_SHT)) supervisor.retry([]() { return sensors.begin<ShtSensor>(); });
+  sensors.get<ShtSensor>().setKeys("temp", "humi");
+  supervisor.setStage(SUPERVISOR_STAGE_RUN);
+  node_config.load();
+  applyConfig(NODE_CFG_HEARTBEAT | NODE_CFG_TIMEOUT | NODE_CFG_OFFSETS);
+  report_gate.addChannel("temp", temperature_deadband);  // Sensors emit into the channels by key
+  report_gate.addChannel("humi", humidity_deadband);
 
   // Initialize WiFi & MQTT
-  mqttUtility.setWiFiNetwork(ssid, psk);
+  mqttUtility.setWiFiNetworks(networks, sizeof(networks) / sizeof(networks[0]));
   mqttUtility.setMqttHost(host, port);
-  mqttUtility.setWifiRetry(5);
+  mqttUtility.setWifiRetry(5);  // Then WiFi off for MQTTU_RETRY_REST, a new round follows
+  mqttUtility.setBackfillTopic(backfill_topic);
+  mqttUtility.setAvailabilityTopic(availability_topic);
+  #ifdef MQTTU_PACKED_STATE  // Also publish state payloads as MessagePack, JSON topic is kept
+  mqttUtility.setPackedTopic(packed_topic);
+  #endif
+  #ifdef MQTTU_DIAGNOSTICS
+  mqttUtility.setDiagnosticsTopic(diag_topic);
+  #endif
   if (strlen(user) > 0 && strlen(pass) > 0) {
     mqttUtility.setMqttUser(user, pass);
   }
+  mqttUtility.setPersistentSession(DEVICE_ID);  // Fast reconnects, the broker keeps the subscription
+  mqttUtility.setTopicQos(state_topic, 1);  // Readings count as published once the broker has acknowledged them
+  mqttUtility.setTopicQos(backfill_topic, 1);
   delay(50);
-  if (mqttUtility.begin() != CONN_CONNECTED) {
-    while(1) {
-      digitalWrite(CASE_LED, LOW);
-      delay(800);
-      digitalWrite(CASE_LED, HIGH);
-      delay(200);
-    }
-  }
+  // Connect in the background, readings are buffered for backfill until connected
+  mqttUtility.setConfigCallback(command_topic, onConfig);
+  #ifdef MQTTU_OTA
+  mqttUtility.setOtaTopics(ota_topic, ota_status_topic, onOta);
+  #endif
+  #ifndef BLE_RELAY_NODE
+  mqttUtility.start();
+  #endif
   delay(50);
 
-  // Configure MQTT topics
-  for (int i=0; i<num_of_sensors; i++) {
-    String name = String(device_name) + " " + String(sensors[0][i]);
-    String uid = String(device_name_lower) + String(sensors[1][i]);
-    String val_tpl = String("{{ value_json.") + String(sensors[1][i]) + String(sensors[4][i]) + String(" }}");
-    String conf_topic = "homeassistant/sensor/" + uid + "/config";
-    mdevs dev = {String(sensors[2][i]), sensor_timeout, name, String(state_topic), uid, String(sensors[3][i]), val_tpl, conf_topic};
-    mqttUtility.configureTopic(&dev);
-  }
+  // Schedule tasks
+  scheduler.addTask(pollTask, poll_interval);
+  uint32_t period = node_config.get().interval;
+  sample_task_id = scheduler.addTask(sampleTask, period, period - sample_lead);
+  publish_task_id = scheduler.addTask(publishTask, period, period);
+  #ifndef BLE_RELAY_NODE  // No connection to show
+  scheduler.addTask(ledTask, led_interval);
+  #endif
   
   digitalWrite(CASE_LED, LOW);
 }
 
 
 void loop() {
-  mqttUtility.pollMqtt();
-  unsigned long current = millis();
-  
-  if (current - previous >= interval) {
-    previous = current;
-    digitalWrite(CASE_LED, HIGH);
-    mqttUtility.checkConnection();
-    measureData();
-    sendData();
-    digitalWrite(CASE_LED, LOW);
-  }
-  delay(1000);
+  supervisor.kick();
+  scheduler.run();
 }
 
 
-void measureData() {
-  float temperature_raw, humidity_raw;
+void pollTask() {
+  if (mqttUtility.tick() == CONN_STATE_CONNECTED && !is_configured) configureDiscovery();
+}
+
 
-  do {
-    temperature_raw = sht31.getTemperature();
-    humidity_raw = sht31.getHumidity();
-  } while (isnan(temperature_raw) || isnan(humidity_raw));
+/**
+ * Configure MQTT topics
+*/
+void configureDiscovery() {
+  #ifdef DEVICE_DISCOVERY
+  mqttUtility.configureDevice(device, discovery, node_config.get().sensorTimeout);
+  #else
+  mqttUtility.configureTopic(device, discovery, node_config.get().sensorTimeout);
+  #endif
+  is_configured = true;
+}
+
+
+void sampleTask() {
+  digitalWrite(CASE_LED, HIGH);
+  #ifdef MQTTU_DIAGNOSTICS
+  PhaseTimer timer(mqttUtility.getPhase(PHASE_SENSOR));
+  #endif
+  measureData();
+}
+
+
+void publishTask() {
+  // Samples between reports only go to the statistics
+  if (report_gate.isDue(mqttUtility.monotonicMs()) || sensors.isChanged()) sendData();
+  supervisor.markHealthy();
+  digitalWrite(CASE_LED, LOW);
+  #ifdef MQTTU_LOW_POWER
+  sleepCycle();
+  #endif
+}
+
+
+/**
+ * Blink case LED while WiFi/MQTT is not connected
+*/
+void ledTask() {
+  static bool isLedOn = false;
+  if (mqttUtility.getState() == CONN_STATE_CONNECTED) {
+    if (isLedOn) digitalWrite(CASE_LED, LOW);
+    isLedOn = false;
+    return;
+  }
+  isLedOn = !isLedOn;
+  digitalWrite(CASE_LED, isLedOn ? HIGH : LOW);
+}
 
-  temperature = temperature_raw + temperature_offset;
-  humidity = humidity_raw + humidity_offset;
 
+void measureData() {
+  // Previous values are kept if the sensor does not answer, sensors that did not start are skipped
+  sensors.acquireAll(report_gate);
   return;
 }
 
 
 void sendData() {
-    JsonDocument doc;
-    doc[sensors[1][0]] = temperature;
-    doc[sensors[1][1]] = humidity;
-    int len = measureJson(doc);
-    char output[len++];
-    serializeJson(doc, output, len);
+    state_frame.clear();
+    sensors.emit(state_frame);
+    #ifdef MQTTU_LOW_POWER
+    state_frame.set("icur", mqttUtility.getAverageCurrent());
+    #endif
+    report_gate.addStats(state_frame);
+    #ifdef BLE_RELAY_NODE
+    // No gateway in range leaves the gate due, it is reported again at the next sample.
+    // Availability is not relayed, the frame leaves out values of unavailable sensors instead
+    if (ble_relay.send(state_frame)) {
+      report_gate.markReported(mqttUtility.monotonicMs());
+      sensors.markReported();
+    }
+    #else
     mqttUtility.checkConnection();
-    mqttUtility.sendPackets(doc, state_topic);
+    // A dropped reading leaves the gate due, it is reported again at the next sample
+    if (mqttUtility.sendFrame(state_frame, state_topic) != PUB_DROPPED) report_gate.markReported(mqttUtility.monotonicMs());
+    sendAvailability();
+    #endif
     return;
 }
+
+
+/**
+ * Apply a config document from the command topic, changed settings are saved to flash
+*/
+void onConfig(JsonObjectConst config) {
+  uint8_t changed = node_config.apply(config);
+  if (changed == 0) return;
+  applyConfig(changed);
+  node_config.save();
+}
+
+
+#ifdef MQTTU_OTA
+/**
+ * Pause sampling and reports while a firmware image is received, NINA only serves the download
+*/
+void onOta(util_ota_state state) {
+  bool is_idle = state != OTA_RECEIVING;
+  // Resumed with the sampling run sample_lead ahead of the report, as scheduled in setup()
+  uint32_t period = node_config.get().interval;
+  scheduler.setEnabled(sample_task_id, is_idle, period - sample_lead);
+  scheduler.setEnabled(publish_task_id, is_idle, period);
+  if (state == OTA_APPLYING) supervisor.pause();  // The flash copy runs without kicks
+}
+#endif
+
+
+/**
+ * Apply changed settings live. Offsets go to the sensor policies, rounds is not used.
+ * params: uint8_t changed: NODE_CFG_* flags
+*/
+void applyConfig(uint8_t changed) {
+  const node_cfg& cfg = node_config.get();
+  if (changed & NODE_CFG_INTERVAL) {
+    scheduler.setPeriod(sample_task_id, cfg.interval);
+    scheduler.setPeriod(publish_task_id, cfg.interval);
+  }
+  if (changed & NODE_CFG_HEARTBEAT) report_gate.setHeartbeat(cfg.heartbeat);
+  if (changed & NODE_CFG_OFFSETS) sensors.get<ShtSensor>().setOffsets(cfg.temperatureOffset, cfg.humidityOffset);
+  if (changed & NODE_CFG_TIMEOUT) is_configured = false;  // Re-published by pollTask() with the new expiry
+}
+
+
+/**
+ * Publish sensor availability when it has changed, with the reason of the last reset
+*/
+void sendAvailability() {
+  if (!sensors.isChanged()) return;
+  JsonDocument doc;
+  sensors.addAvailability(doc);
+  doc["rst"] = supervisor.getResetReason();
+  doc["crash"] = supervisor.getCrashCount();
+  if (mqttUtility.sendAvailability(doc)) sensors.markReported();
+}
+
+
+#ifdef MQTTU_LOW_POWER
+/**
+ * Sleep until wake_lead ms before the next sampling run, then reconnect in the background
+*/
+void sleepCycle() {
+  #ifdef MQTTU_OTA
+  if (mqttUtility.isOtaActive()) return;
+  #endif
+  int32_t idle = scheduler.timeUntil(sample_task_id) - (int32_t)wake_lead;
+  if (idle < (int32_t)sleep_min) return;
+  supervisor.pause();  // WDT keeps running in standby
+  scheduler.advance(mqttUtility.sleep(idle));
+  supervisor.resume();
+}
+#endif
@@ -0,0 +1,223 @@
+/*
+  Author: Ilari Mattsson
+  Library: Ble Relay
+  File: Ble_Relay.cpp
+  Version: 1.0
+*/
+
+#include "Ble_Relay.h"
+#include <ArduinoJson.h>
+
+#define BLE_RELAY_LAST_CHUNK 0x80
+
+BleRelayGateway* BleRelayGateway::_instance = NULL;
+
+/**
+ * Record header: [id length][node id]
+ * returns: size_t: header length, 0 if the id is empty or too long
+*/
+static size_t writeRecordId(const char* nodeId, uint8_t* record) {
+  size_t idLen = strlen(nodeId);
+  if (idLen == 0 || idLen > BLE_RELAY_ID_MAX) return 0;
+  record[0] = idLen;
+  memcpy(record + 1, nodeId, idLen);
+  return 1 + idLen;
+}
+
+// ================================ Node public methods ========================================
+
+BleRelayNode::BleRelayNode(const char* nodeId):
+  _nodeId(nodeId) {
+}
+
+bool BleRelayNode::send(const StateFrame& frame) {
+  uint8_t record[BLE_RELAY_RECORD_MAX];
+  size_t head = writeRecordId(_nodeId, record);
+  if (head == 0) return false;
+  size_t len = frame.pack(record + head, sizeof(record) - head);
+  if (len == 0) return false;
+
+  if (!BLE.begin()) return false;
+  bool sent = deliver(record, head + len);
+  BLE.end();
+  return sent;
+}
+
+// ================================ Node private methods ========================================
+
+bool BleRelayNode::deliver(const uint8_t* record, size_t len) {
+  BLE.scanForUuid(BLE_RELAY_SERVICE_UUID);
+  BLEDevice gateway;
+  uint32_t since = millis();
+  while (!gateway && millis() - since < BLE_RELAY_SCAN_TIMEOUT) {
+    BLE.poll();
+    gateway = BLE.available();
+  }
+  BLE.stopScan();
+  if (!gateway || !gateway.connect()) return false;
+
+  bool sent = false;
+  BLECharacteristic frameChar;
+  if (gateway.discoverService(BLE_RELAY_SERVICE_UUID)) frameChar = gateway.characteristic(BLE_RELAY_FRAME_UUID);
+  if (frameChar) {
+    uint8_t chunk[1 + BLE_RELAY_CHUNK];
+    size_t offset = 0;
+    uint8_t index = 0;
+    sent = true;
+    while (sent && offset < len) {
+      size_t n = len - offset < BLE_RELAY_CHUNK ? len - offset : BLE_RELAY_CHUNK;
+      chunk[0] = index++ | (offset + n == len ? BLE_RELAY_LAST_CHUNK : 0);
+      memcpy(chunk + 1, record + offset, n);
+      // Write with response, the gateway acknowledges every chunk
+      sent = frameChar.writeValue(chunk, 1 + n, true);
+      offset += n;
+    }
+  }
+  gateway.disconnect();
+  return sent;
+}
+
+// ================================ Gateway public methods ========================================
+
+BleRelayGateway::BleRelayGateway(MqttUtility& mqtt):
+  _mqtt(mqtt),
+  _service(BLE_RELAY_SERVICE_UUID),
+  _frameChar(BLE_RELAY_FRAME_UUID, BLEWrite, 1 + BLE_RELAY_CHUNK),
+  _name(NULL),
+  _state(RELAY_IDLE),
+  _stateSince(0),
+  _connectedAt(0),
+  _assemblyLen(0),
+  _nextChunk(0xFF),
+  _queue(_queueData, sizeof(_queueData)) {
+}
+
+bool BleRelayGateway::begin(const char* localName) {
+  _name = localName;
+  _instance = this;
+  _service.addCharacteristic(_frameChar);
+  _frameChar.setEventHandler(BLEWritten, onWritten);
+  return listen();
+}
+
+void BleRelayGateway::tick() {
+  uint32_t now = millis();
+  switch (_state) {
+    case RELAY_IDLE:
+      break;
+
+    case RELAY_LISTEN:
+      BLE.poll();
+      if (now - _stateSince >= BLE_RELAY_LISTEN_TIME) goOnline();
+      break;
+
+    case RELAY_ONLINE: {
+      bool drained = false;
+      if (_mqtt.getState() == CONN_STATE_CONNECTED) {
+        if (_connectedAt == 0) _connectedAt = now | 1;
+        publishNext();
+        drained = _queue.count() == 0 && now - _connectedAt >= BLE_RELAY_ONLINE_MIN;
+      }
+      #ifdef MQTTU_OTA
+      if (_mqtt.isOtaActive()) break;  // Stay online until the image is applied or abandoned
+      #endif
+      if (drained || now - _stateSince >= BLE_RELAY_ONLINE_TIME) listen();
+      break;
+    }
+  }
+}
+
+bool BleRelayGateway::enqueue(const char* nodeId, const StateFrame& frame) {
+  uint8_t record[BLE_RELAY_RECORD_MAX];
+  size_t head = writeRecordId(nodeId, record);
+  if (head == 0) return false;
+  size_t len = frame.pack(record + head, sizeof(record) - head);
+  if (len == 0) return false;
+  return _queue.push(millis(), record, head + len);
+}
+
+uint16_t BleRelayGateway::getQueued() const {
+  return _queue.count();
+}
+
+relay_state BleRelayGateway::getState() const {
+  return _state;
+}
+
+// ================================ Gateway private methods ========================================
+
+bool BleRelayGateway::listen() {
+  // NINA runs one radio stack at a time, WiFi has to be down before BLE starts
+  _mqtt.end();
+  if (!BLE.begin()) {
+    // Stay on WiFi for this cycle, queued records still go out
+    goOnline();
+    return false;
+  }
+  BLE.setLocalName(_name);
+  BLE.setAdvertisedService(_service);
+  BLE.addService(_service);
+  BLE.advertise();
+  _nextChunk = 0xFF;
+  _stateSince = millis();
+  _state = RELAY_LISTEN;
+  return true;
+}
+
+void BleRelayGateway::goOnline() {
+  BLE.end();
+  _mqtt.start();
+  _stateSince = millis();
+  _connectedAt = 0;
+  _state = RELAY_ONLINE;
+}
+
+void BleRelayGateway::receive(const uint8_t* data, size_t len) {
+  if (len < 2) return;
+  uint8_t index = data[0] & ~BLE_RELAY_LAST_CHUNK;
+  // A new record starts at chunk 0, a lost or repeated chunk drops the partial record
+  if (index == 0) {
+    _assemblyLen = 0;
+    _nextChunk = 0;
+  }
+  if (index != _nextChunk || _assemblyLen + len - 1 > sizeof(_assembly)) {
+    _nextChunk = 0xFF;
+    return;
+  }
+  memcpy(_assembly + _assemblyLen, data + 1, len - 1);
+  _assemblyLen += len - 1;
+  _nextChunk++;
+
+  if (!(data[0] & BLE_RELAY_LAST_CHUNK)) return;
+  _nextChunk = 0xFF;
+  uint8_t idLen = _assembly[0];
+  if (idLen == 0 || idLen > BLE_RELAY_ID_MAX || (size_t)idLen + 1 >= _assemblyLen) return;
+  _queue.push(millis(), _assembly, _assemblyLen);
+}
+
+void BleRelayGateway::publishNext() {
+  uint8_t record[BLE_RELAY_RECORD_MAX];
+  uint32_t time;
+  uint8_t len;
+  if (!_queue.read(0, &time, record, &len)) return;
+
+  char nodeId[BLE_RELAY_ID_MAX + 1];
+  uint8_t idLen = record[0];
+  memcpy(nodeId, record + 1, idLen);
+  nodeId[idLen] = '\0';
+
+  JsonDocument doc;
+  if (deserializeMsgPack(doc, record + 1 + idLen, len - 1 - idLen)) {
+    _queue.pop(1);  // Drop corrupted records
+    return;
+  }
+  char topic[sizeof(MQTTU_DISCOVERY_PREFIX) + BLE_RELAY_ID_MAX + sizeof("/state")];
+  snprintf(topic, sizeof(topic), MQTTU_DISCOVERY_PREFIX "%s/state", nodeId);
+  // Keep the record if the publish fails, retried on the next tick
+  if (_mqtt.publish(doc, topic)) _queue.pop(1);
+}
+
+void BleRelayGateway::onWritten(BLEDevice central, BLECharacteristic characteristic) {
+  if (_instance == NULL) return;
+  _instance->receive(characteristic.value(), characteristic.valueLength());
+}
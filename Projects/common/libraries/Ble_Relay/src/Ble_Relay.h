@@ -0,0 +1,156 @@
+/*
+  BLE relay for NINA-W102 boards (MKR WiFi 1010, Nano 33 IoT).
+  Leaf nodes send their state frames over BLE to one gateway node, the gateway publishes them to the
+  leaves' own state topics through its MqttUtility connection. Leaves never bring up WiFi.
+
+  > Implements:
+    - BleRelayNode: scans for a listening gateway, connects, writes one record and disconnects.
+      BLE is only on during send()
+    - BleRelayGateway: GATT peripheral with a write characteristic, received records are queued
+      in a SampleRing and published as JSON on homeassistant/sensor/<node id>/state
+    - Time multiplexing on the gateway: NINA runs either BLE or WiFi, the gateway listens over BLE
+      for BLE_RELAY_LISTEN_TIME, then ends BLE and starts MqttUtility for up to BLE_RELAY_ONLINE_TIME
+
+  Record: [id length][node id][MessagePack state frame, StateFrame::pack()]
+  Writes: [header][up to BLE_RELAY_CHUNK record bytes], header = chunk index, bit 7 set on the last chunk.
+  Chunks fit the default 23 byte ATT MTU, each is a write with response.
+
+  Usage, gateway (MqttUtility is ticked by the project as usual, the gateway starts and ends it):
+    BleRelayGateway gateway(mqttUtility);
+    gateway.begin("greenA-gw");
+    gateway.tick();                           // From loop()
+    gateway.enqueue("greenA", stateFrame);    // The gateway's own readings go through the queue too
+  Usage, leaf:
+    BleRelayNode relay("blueA");
+    if (relay.send(stateFrame)) gate.markReported(now);
+
+  Discovery configs and availability are not relayed. Publish a leaf's discovery configs once over WiFi,
+  the broker keeps them retained.
+
+  Author: Ilari Mattsson
+  Library: Ble Relay
+  File: Ble_Relay.h
+  Version: 1.0
+*/
+
+#ifndef BLE_RELAY_H
+#define BLE_RELAY_H
+
+#include <Arduino.h>
+#include <ArduinoBLE.h>
+#include <Mqtt_Utility.h>
+#include "utils/sample_ring.h"
+
+#define BLE_RELAY_VERSION "1.0"
+
+#define BLE_RELAY_SERVICE_UUID "8e7634a0-7a0d-4b53-9d35-6a1c5e2f0001"
+#define BLE_RELAY_FRAME_UUID "8e7634a0-7a0d-4b53-9d35-6a1c5e2f0002"
+
+#ifndef BLE_RELAY_CHUNK
+#define BLE_RELAY_CHUNK 19              // Record bytes per write, header + chunk fit the default ATT MTU
+#endif
+#ifndef BLE_RELAY_ID_MAX
+#define BLE_RELAY_ID_MAX 24             // Max node id length
+#endif
+#ifndef BLE_RELAY_QUEUE_SIZE
+#define BLE_RELAY_QUEUE_SIZE 2048       // bytes of queued records on the gateway, oldest are dropped
+#endif
+#ifndef BLE_RELAY_LISTEN_TIME
+#define BLE_RELAY_LISTEN_TIME 45000     // ms the gateway listens over BLE per cycle
+#endif
+#ifndef BLE_RELAY_ONLINE_TIME
+#define BLE_RELAY_ONLINE_TIME 20000     // ms the gateway stays on WiFi at most, records left are kept
+#endif
+#ifndef BLE_RELAY_ONLINE_MIN
+#define BLE_RELAY_ONLINE_MIN 3000       // ms connected before going back to BLE, for the project's own traffic
+#endif
+#ifndef BLE_RELAY_SCAN_TIMEOUT
+#define BLE_RELAY_SCAN_TIMEOUT 4000     // ms a leaf scans for a gateway
+#endif
+
+#define BLE_RELAY_RECORD_MAX 255
+
+typedef enum {
+  RELAY_IDLE = 0,   // Not started
+  RELAY_LISTEN,     // BLE on, receiving records
+  RELAY_ONLINE      // WiFi/MQTT on, publishing queued records
+} relay_state;
+
+class BleRelayNode {
+public:
+  /**
+   * params: const char* nodeId: device id of the leaf, records are published on its state topic. Not copied.
+  */
+  BleRelayNode(const char* nodeId);
+
+  /**
+   * Send frame to a listening gateway. Starts BLE, scans up to BLE_RELAY_SCAN_TIMEOUT and ends BLE.
+   * returns: bool: true if the gateway accepted every chunk
+  */
+  bool send(const StateFrame& frame);
+
+private:
+  bool deliver(const uint8_t* record, size_t len);
+
+  const char* _nodeId;
+};
+
+class BleRelayGateway {
+public:
+  BleRelayGateway(MqttUtility& mqtt);
+
+  /**
+   * Start listening over BLE
+   * params: const char* localName: advertised name. Not copied.
+   * returns: bool: false if BLE did not start, begin() can be called again
+  */
+  bool begin(const char* localName);
+
+  /**
+   * Advance listen/online cycle, handles BLE events and publishes one queued record per call.
+   * Call often, e.g. from loop(). While listening, nothing else may talk to NINA over SPI
+   * (WiFi.status(), WiFiDrv LED writes, MqttUtility::checkConnection())
+  */
+  void tick();
+
+  /**
+   * Queue a frame for nodeId, published in the next online window
+   * returns: bool: false if the record does not fit in BLE_RELAY_RECORD_MAX
+  */
+  bool enqueue(const char* nodeId, const StateFrame& frame);
+
+  uint16_t getQueued() const;
+
+  relay_state getState() const;
+
+private:
+  bool listen();
+
+  void goOnline();
+
+  void receive(const uint8_t* data, size_t len);
+
+  void publishNext();
+
+  static void onWritten(BLEDevice central, BLECharacteristic characteristic);
+
+  MqttUtility& _mqtt;
+  BLEService _service;
+  BLECharacteristic _frameChar;
+  const char* _name;
+
+  relay_state _state;
+  uint32_t _stateSince;    // millis() at last state change
+  uint32_t _connectedAt;   // millis() when MQTT connected in this online window, 0 = not yet
+
+  uint8_t _assembly[BLE_RELAY_RECORD_MAX];
+  size_t _assemblyLen;
+  uint8_t _nextChunk;      // Expected chunk index, 0xFF = waiting for a first chunk
+
+  uint8_t _queueData[BLE_RELAY_QUEUE_SIZE];
+  SampleRing _queue;
+
+  static BleRelayGateway* _instance;  // setEventHandler() takes a plain function
+};
+
+#endif // BLE_RELAY_H
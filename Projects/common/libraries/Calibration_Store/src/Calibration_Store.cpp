@@ -0,0 +1,77 @@
+/*
+  Author: Ilari Mattsson
+  Library: Calibration Store
+  File: Calibration_Store.cpp
+  Version: 1.0
+*/
+
+#include "Calibration_Store.h"
+#include <Arduino.h>
+#include <FlashStorage.h>
+#include <Flash_Layout.h>
+
+typedef struct calibration_record {
+  uint32_t magic;
+  uint8_t count;
+  cal_entry entries[CAL_STORE_MAX_ENTRIES];
+  uint32_t checksum;  // FNV-1a over all preceding bytes
+} cal_record;
+
+static_assert(sizeof(cal_record) <= FLASH_ROW_SIZE, "cal_record must fit in one flash row");
+FlashStorageClass<cal_record> calibrationFlash(FLASH_RECORD_ADDRESS(FLASH_ROW_CALIBRATION));
+
+
+CalibrationStore::CalibrationStore() {
+}
+
+// ================================ Class public methods ========================================
+
+bool CalibrationStore::load(cal_entry* entries, uint8_t count) {
+  cal_record record;
+  calibrationFlash.read(&record);
+
+  if (record.magic != CAL_STORE_MAGIC || record.count != count) return false;
+  if (record.checksum != checksum(&record, offsetof(cal_record, checksum))) return false;
+  for (uint8_t i = 0; i < count; i++) {
+    if (record.entries[i].pin != entries[i].pin) return false;
+  }
+
+  for (uint8_t i = 0; i < count; i++) {
+    entries[i].base = record.entries[i].base;
+    entries[i].cap = record.entries[i].cap;
+  }
+  return true;
+}
+
+bool CalibrationStore::save(const cal_entry* entries, uint8_t count) {
+  if (count > CAL_STORE_MAX_ENTRIES) return false;
+
+  // Zeroed so struct padding does not change the checksum
+  cal_record record;
+  memset(&record, 0, sizeof(record));
+  record.magic = CAL_STORE_MAGIC;
+  record.count = count;
+  memcpy(record.entries, entries, count * sizeof(cal_entry));
+  record.checksum = checksum(&record, offsetof(cal_record, checksum));
+
+  calibrationFlash.write(record);
+  return true;
+}
+
+void CalibrationStore::clear() {
+  cal_record record;
+  memset(&record, 0, sizeof(record));
+  calibrationFlash.write(record);
+}
+
+// ================================ Class private methods ========================================
+
+uint32_t CalibrationStore::checksum(const void* data, size_t len) {
+  const uint8_t* bytes = (const uint8_t*)data;
+  uint32_t hash = 2166136261UL;
+  for (size_t i = 0; i < len; i++) {
+    hash ^= bytes[i];
+    hash *= 16777619UL;
+  }
+  return hash;
+}
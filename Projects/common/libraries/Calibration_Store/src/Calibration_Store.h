@@ -0,0 +1,67 @@
+/*
+  Persistent analog sensor calibration for SAMD boards.
+  Stores per-pin base/cap calibration values in flash (FlashStorage) so devices
+  can boot without manual calibration after a reset or brown-out.
+
+  > Implements:
+    - Fixed-size calibration record: magic, entry count, entries, checksum
+    - Record validation against the current pin configuration on load
+    - FNV-1a checksum over the record
+
+  Flash is only written by save(). The record lives in a reserved row at the top of flash
+  (Flash_Layout.h), it is kept over MQTTU_OTA updates and erased by a USB upload.
+
+  Author: Ilari Mattsson
+  Library: Calibration Store
+  File: Calibration_Store.h
+  Version: 1.0
+*/
+
+#ifndef CALIBRATION_STORE_H
+#define CALIBRATION_STORE_H
+
+#include <Arduino.h>
+
+#define CALIBRATION_STORE_VERSION "1.0"
+
+#ifndef CAL_STORE_MAX_ENTRIES
+#define CAL_STORE_MAX_ENTRIES 8
+#endif
+
+#define CAL_STORE_MAGIC 0x43414C31  // "CAL1", change when the record layout changes
+
+typedef struct calibration_entry {
+  uint8_t pin;
+  int16_t base;
+  int16_t cap;
+} cal_entry;
+
+class CalibrationStore {
+public:
+  CalibrationStore();
+
+  /**
+   * Load stored calibration values into entries. Pins must be set by the caller and match the stored record.
+   * params:
+   *   cal_entry* entries: calibration entries, base and cap are written on success
+   *   uint8_t count: number of entries
+   * returns: bool: true if a valid record matching count and pins was found
+  */
+  bool load(cal_entry* entries, uint8_t count);
+
+  /**
+   * Write calibration values to flash.
+   * returns: bool: false if count exceeds CAL_STORE_MAX_ENTRIES
+  */
+  bool save(const cal_entry* entries, uint8_t count);
+
+  /**
+   * Invalidate the stored record, next load() fails
+  */
+  void clear();
+
+private:
+  static uint32_t checksum(const void* data, size_t len);
+};
+
+#endif // CALIBRATION_STORE_H
@@ -0,0 +1,83 @@
+/*
+  Flash map of the SAMD21 boards (MKR WiFi 1010, Nano 33 IoT), shared by the libraries that keep
+  records in flash and by MQTTU_OTA firmware updates.
+
+  > Implements:
+    - Record rows at the top of flash, one erase row per persistent record. The rows are outside the
+      sketch and outside the OTA staging area, records are kept when new firmware is applied over MQTT
+    - Sketch and staging areas: the flash between the bootloader and the record rows, split in two.
+      MQTTU_OTA receives an image into the staging area and copies it over the sketch
+
+    0x00000                  SAM-BA bootloader, 8 kB
+    flashSketchStart()       Sketch, at most flashAreaSize() with MQTTU_OTA
+    flashStagingStart()      OTA staging area, flashAreaSize()
+    FLASH_RECORDS_START      Record rows, FLASH_RECORD_ROWS * FLASH_ROW_SIZE up to the end of flash
+
+  Records are declared at their row instead of with the FlashStorage() macro, which places them
+  inside the sketch image:
+    FlashStorageClass<cfg_record> nodeConfigFlash(FLASH_RECORD_ADDRESS(FLASH_ROW_NODE_CONFIG));
+  A USB upload (bossac) erases the application flash, records included. Without MQTTU_OTA the sketch
+  may grow up to the record rows, size_report.py fails the build when an image reaches them.
+
+  Author: Ilari Mattsson
+  Library: Flash Layout
+  File: Flash_Layout.h
+  Version: 1.0
+*/
+
+#ifndef FLASH_LAYOUT_H
+#define FLASH_LAYOUT_H
+
+#include <Arduino.h>
+
+#define FLASH_LAYOUT_VERSION "1.0"
+
+#define FLASH_RECORD_ROWS 4                   // Reserved rows, size_report.py uses the same count
+#define FLASH_ROW_SIZE (FLASH_PAGE_SIZE * 4)  // NVMCTRL erases rows of four pages
+#define FLASH_RECORDS_START (FLASH_ADDR + FLASH_SIZE - FLASH_RECORD_ROWS * FLASH_ROW_SIZE)
+#define FLASH_RECORD_ADDRESS(row) ((const void*)(FLASH_RECORDS_START + (row) * FLASH_ROW_SIZE))
+
+/* Record rows, a record must fit in one row */
+typedef enum {
+  FLASH_ROW_DISCOVERY = 0,  // Mqtt_Utility discovery hash cache
+  FLASH_ROW_NODE_CONFIG,    // Node_Config settings
+  FLASH_ROW_CALIBRATION,    // Calibration_Store moisture calibration
+  FLASH_ROW_COUNT
+} flash_row;
+
+static_assert(FLASH_ROW_COUNT <= FLASH_RECORD_ROWS, "FLASH_RECORD_ROWS is too small for the record rows");
+
+// Linker symbols of the core's flash_with_bootloader.ld
+extern "C" {
+  extern uint32_t __text_start__;
+  extern uint32_t __etext;
+  extern uint32_t __data_start__;
+  extern uint32_t __data_end__;
+}
+
+/**
+ * First sketch address, behind the bootloader
+*/
+inline uint32_t flashSketchStart() {
+  return (uintptr_t)&__text_start__;
+}
+
+/**
+ * End of the running image: code and constants, then the initial values of .data
+*/
+inline uint32_t flashImageEnd() {
+  return (uintptr_t)&__etext + ((uintptr_t)&__data_end__ - (uintptr_t)&__data_start__);
+}
+
+/**
+ * Size of the sketch area and of the staging area above it, whole rows
+*/
+inline uint32_t flashAreaSize() {
+  return (FLASH_RECORDS_START - flashSketchStart()) / 2 / FLASH_ROW_SIZE * FLASH_ROW_SIZE;
+}
+
+inline uint32_t flashStagingStart() {
+  return flashSketchStart() + flashAreaSize();
+}
+
+#endif // FLASH_LAYOUT_H
@@ -0,0 +1,1228 @@
+/*
+  Author: Ilari Mattsson
+  Library: Mqtt Utility
+  File: Mqtt_Utility.cpp
+  Version: 1.2
+  
+  Changes from version 1:
+    - adds Arduino::String -based topic configuration for better reliability and QoL (MQTTU_STRING_MDEVS)
+    - adds C string safety measures implemented in MKR1010_Indoor_Plant_Monitor topic configuration
+    - Renamed some class variables and method args to be more consistent
+    - Project specific copies merged back into this shared library, features selected with build flags
+*/
+
+#include "Mqtt_Utility.h"
+#include <ArduinoMqttClient.h>
+#include <ArduinoJson.h>
+#include <Client.h>
+#include <WiFi.h>
+#ifdef MQTTU_LOW_POWER
+#include <ArduinoLowPower.h>
+#endif
+#ifdef MQTTU_DISCOVERY_CACHE
+#include <FlashStorage.h>
+#include <Flash_Layout.h>
+#endif
+
+#ifdef MQTTU_DIAGNOSTICS
+#ifdef ARDUINO_ARCH_SAMD
+extern "C" char* sbrk(int incr);
+#endif
+#endif
+
+#define MQTTU_FNV_OFFSET 2166136261UL
+#define MQTTU_FNV_PRIME 16777619UL
+
+namespace {
+// Print sink hashing everything written to it (FNV-1a), serialized JSON is hashed without a buffer
+class HashPrint : public Print {
+public:
+  HashPrint(): hash(MQTTU_FNV_OFFSET) {}
+  size_t write(uint8_t c) {
+    hash = (hash ^ c) * MQTTU_FNV_PRIME;
+    return 1;
+  }
+  size_t write(const uint8_t* buffer, size_t size) {
+    for (size_t i = 0; i < size; i++) write(buffer[i]);
+    return size;
+  }
+  uint32_t hash;
+};
+}
+
+#ifdef MQTTU_DISCOVERY_CACHE
+#define MQTTU_DISCOVERY_MAGIC 0x44495343  // "DISC", change when the record layout changes
+
+typedef struct discovery_cache_record {
+  uint32_t magic;
+  uint8_t count;
+  disc_slot slots[MQTTU_DISCOVERY_SLOTS];
+  uint32_t checksum;  // FNV-1a over all preceding bytes
+} disc_record;
+
+static_assert(sizeof(disc_record) <= FLASH_ROW_SIZE, "MQTTU_DISCOVERY_SLOTS do not fit in one flash row");
+FlashStorageClass<disc_record> discoveryFlash(FLASH_RECORD_ADDRESS(FLASH_ROW_DISCOVERY));
+#endif
+
+MqttUtility* MqttUtility::_instance = NULL;
+
+MqttUtility::MqttUtility(Client* client):
+  _wifiClient(client),
+  _mqttClient(new MqttClient(client)),
+  _ssid(NULL),
+  _psk(NULL),
+  _retry(0),
+  _networks(NULL),
+  _networkCount(0),
+  _network(0),
+  _scanNeeded(false),
+  _lastRoam(0),
+  _host("0.0.0.0"),
+  _port(1883),
+  _started(false),
+  _ownsMqttClient(true),
+  _mqttErr(CONN_NO_ERR),
+  _status(CONN_NO_ERR),
+  _state(CONN_STATE_IDLE),
+  _stateSince(0),
+  _backoffDelay(0),
+  _attempts(0),
+  _rng(0),
+  _cmdTopic(NULL),
+  _cmdCallback(NULL),
+  _cfgCallback(NULL),
+  _avtyTopic(NULL),
+  _persistent(false),
+  _sessionValid(false),
+  _qosCount(0),
+  #ifdef MQTTU_PACKED_STATE
+  _packedTopic(NULL),
+  #endif
+  _epoch(0),
+  _epochAt(0)
+  #ifdef MQTTU_BACKFILL
+  , _backfill(_backfillData, MQTTU_BACKFILL_SIZE),
+  _backfillTopic(NULL),
+  _lastBackfill(0)
+  #endif
+  #ifdef MQTTU_DISCOVERY_CACHE
+  , _discCount(0),
+  _discLoaded(false),
+  _discDirty(false)
+  #ifdef MQTTU_DISCOVERY_VERIFY
+  , _verifyTopic(NULL),
+  _verifyHash(0),
+  _verifyDone(false)
+  #endif
+  #endif
+  #ifdef MQTTU_LOW_POWER
+  , _leaseSince(0),
+  _leaseValid(false),
+  _awakeMs(0),
+  _sleepMs(0),
+  _wakeSince(0)
+  #endif
+  #ifdef MQTTU_DIAGNOSTICS
+  , _diagTopic(NULL),
+  _lastDiag(0),
+  _reconnects(0),
+  _pubFailures(0)
+  #endif
+  #ifdef MQTTU_OTA
+  , _otaTopic(NULL),
+  _otaStatusTopic(NULL),
+  _otaCallback(NULL),
+  _otaEvent(OTA_IDLE),
+  _otaError(NULL),
+  _otaLast(0),
+  _otaAckDue(false),
+  _otaApplyDue(false)
+  #endif
+  {
+}
+
+MqttUtility::MqttUtility(Client& wifiClient):
+  MqttUtility(&wifiClient){
+}
+
+MqttUtility::MqttUtility(Client* wifiClient, MqttClient* mqttClient, const char* ssid, const char* psk, const char* mqtt, uint16_t port):
+  _wifiClient(wifiClient),
+  _mqttClient(mqttClient),
+  _ssid(ssid),
+  _psk(psk),
+  _retry(0),
+  _networks(NULL),
+  _networkCount(0),
+  _network(0),
+  _scanNeeded(false),
+  _lastRoam(0),
+  _host(mqtt),
+  _port(port),
+  _started(false),
+  _ownsMqttClient(false),
+  _mqttErr(CONN_NO_ERR),
+  _status(CONN_NO_ERR),
+  _state(CONN_STATE_IDLE),
+  _stateSince(0),
+  _backoffDelay(0),
+  _attempts(0),
+  _rng(0),
+  _cmdTopic(NULL),
+  _cmdCallback(NULL),
+  _cfgCallback(NULL),
+  _avtyTopic(NULL),
+  _persistent(false),
+  _sessionValid(false),
+  _qosCount(0),
+  #ifdef MQTTU_PACKED_STATE
+  _packedTopic(NULL),
+  #endif
+  _epoch(0),
+  _epochAt(0)
+  #ifdef MQTTU_BACKFILL
+  , _backfill(_backfillData, MQTTU_BACKFILL_SIZE),
+  _backfillTopic(NULL),
+  _lastBackfill(0)
+  #endif
+  #ifdef MQTTU_DISCOVERY_CACHE
+  , _discCount(0),
+  _discLoaded(false),
+  _discDirty(false)
+  #ifdef MQTTU_DISCOVERY_VERIFY
+  , _verifyTopic(NULL),
+  _verifyHash(0),
+  _verifyDone(false)
+  #endif
+  #endif
+  #ifdef MQTTU_LOW_POWER
+  , _leaseSince(0),
+  _leaseValid(false),
+  _awakeMs(0),
+  _sleepMs(0),
+  _wakeSince(0)
+  #endif
+  #ifdef MQTTU_DIAGNOSTICS
+  , _diagTopic(NULL),
+  _lastDiag(0),
+  _reconnects(0),
+  _pubFailures(0)
+  #endif
+  #ifdef MQTTU_OTA
+  , _otaTopic(NULL),
+  _otaStatusTopic(NULL),
+  _otaCallback(NULL),
+  _otaEvent(OTA_IDLE),
+  _otaError(NULL),
+  _otaLast(0),
+  _otaAckDue(false),
+  _otaApplyDue(false)
+  #endif
+  {
+}
+
+MqttUtility::MqttUtility(Client& wifiClient, MqttClient& mqttClient, const char* ssid, const char* psk, const char* mqtt, uint16_t port):
+  MqttUtility(&wifiClient, &mqttClient, ssid, psk, mqtt, port){
+}
+
+MqttUtility::~MqttUtility(){
+  if (_ownsMqttClient) {
+    delete _mqttClient;
+  }
+}
+
+// ================================ Class public methods ========================================
+
+int MqttUtility::begin(){
+  if (!start()) return CONN_NO_PARAMS;
+
+  // Blocking start-up: run the connection engine until connected or out of WiFi attempts
+  while (tick() != CONN_STATE_CONNECTED) {
+    if (retriesUsed()) return _status;
+    delay(10);
+  }
+  return _status;
+}
+
+bool MqttUtility::start(){
+  if (_ssid == NULL || _host == NULL) return false;
+
+  _started = true;
+  _attempts = 0;
+  connectWifi();
+  return true;
+}
+
+util_conn_state MqttUtility::tick(){
+  if (!_started) return _state;
+  uint32_t now = millis();
+
+  switch (_state) {
+    case CONN_STATE_IDLE:
+      connectWifi();
+      break;
+    case CONN_STATE_WIFI: {
+      uint8_t wifiStatus = WiFi.status();
+      if (wifiStatus == WL_CONNECTED) {
+        setState(CONN_STATE_MQTT);
+      } else if (wifiStatus == WL_CONNECT_FAILED || now - _stateSince >= MQTTU_WIFI_TIMEOUT) {
+        _scanNeeded = _networkCount > 1;  // The network may be out of range, pick again
+        backoff(CONN_WIFI_TIMEOUT);
+      }
+      break;
+    }
+    case CONN_STATE_MQTT:
+      // MqttClient::connect() blocks until the broker answers or the connection times out
+      if (WiFi.status() != WL_CONNECTED) {
+        connectWifi();
+      } else if (connectMqtt()) {
+        _attempts = 0;
+        _mqttErr = CONN_NO_ERR;
+        _status = CONN_CONNECTED;
+        setState(CONN_STATE_CONNECTED);
+        // Stays subscribed in a persistent session unless the broker was unreachable or WiFi was lost
+        if (!_sessionValid) subscribeCommands();
+        _sessionValid = _persistent;
+        syncTime();
+      } else {
+        _mqttErr = _mqttClient->connectError();
+        backoff(CONN_ERR_MQTT);
+      }
+      break;
+    case CONN_STATE_CONNECTED:
+      switch (getConnectionStatus()) {
+        case CONN_OK:
+          _mqttClient->poll();
+          #ifdef MQTTU_BACKFILL
+          drainBackfill(now);
+          #endif
+          if (_networkCount > 1 && monotonicMs() - _lastRoam >= MQTTU_ROAM_INTERVAL) roam();
+          #ifdef MQTTU_DIAGNOSTICS
+          if (_diagTopic != NULL && now - _lastDiag >= MQTTU_DIAGNOSTICS_INTERVAL) {
+            _lastDiag = now;
+            publishDiagnostics();
+          }
+          #endif
+          break;
+        case CONN_NO_MQTT:
+          #ifdef MQTTU_DIAGNOSTICS
+          _reconnects++;
+          #endif
+          setState(CONN_STATE_MQTT);
+          break;
+        default:
+          #ifdef MQTTU_DIAGNOSTICS
+          _reconnects++;
+          #endif
+          connectWifi();
+          break;
+      }
+      break;
+    case CONN_STATE_BACKOFF:
+      if (now - _stateSince >= _backoffDelay) {
+        bool rested = retriesUsed();  // End of a rest, WiFi is off
+        if (rested) _attempts = 0;
+        if (!rested && WiFi.status() == WL_CONNECTED) setState(CONN_STATE_MQTT);
+        else connectWifi();
+      }
+      break;
+  }
+
+  #ifdef MQTTU_OTA
+  serviceOta(now);
+  #endif
+  return _state;
+}
+
+util_conn_state MqttUtility::getState() const {
+  return _state;
+}
+
+void MqttUtility::end(){
+  if(getConnectionStatus() == CONN_OK) _mqttClient->stop();
+  WiFi.end();
+  _started = false;
+  setState(CONN_STATE_IDLE);
+}
+
+#ifdef MQTTU_LOW_POWER
+uint32_t MqttUtility::sleep(uint32_t ms){
+  if (_state == CONN_STATE_CONNECTED && !_leaseValid) cacheLease();
+  bool restart = _started;
+  end();
+
+  uint32_t before = millis();
+  _awakeMs += before - _wakeSince;
+  LowPower.deepSleep(ms);
+  _sleepMs += ms;
+  _wakeSince = millis();
+
+  if (restart) start();
+  uint32_t counted = _wakeSince - before;
+  return counted < ms ? ms - counted : 0;
+}
+
+uint32_t MqttUtility::getAwakeTime() const {
+  return (_awakeMs + (millis() - _wakeSince)) / 1000;
+}
+
+uint32_t MqttUtility::getSleepTime() const {
+  return _sleepMs / 1000;
+}
+
+float MqttUtility::getAverageCurrent() const {
+  float awake = _awakeMs + (millis() - _wakeSince);
+  float total = awake + _sleepMs;
+  if (total <= 0) return MQTTU_AWAKE_CURRENT;
+  return (awake * MQTTU_AWAKE_CURRENT + _sleepMs * MQTTU_SLEEP_CURRENT) / total;
+}
+#endif
+
+const char* MqttUtility::version(){
+  return LIB_VERSION;
+}
+
+util_pub_result MqttUtility::sendPackets(const JsonDocument& doc, const char* topic) {
+  if (_state == CONN_STATE_CONNECTED && publishJson(doc, topic, false)) {
+    #ifdef MQTTU_PACKED_STATE
+    if (_packedTopic != NULL) publishMsgPack(doc, _packedTopic, false);
+    #endif
+    return PUB_OK;
+  }
+  #ifdef MQTTU_BACKFILL
+  if (bufferSample(doc)) return PUB_BUFFERED;
+  #endif
+  return PUB_DROPPED;
+}
+
+util_pub_result MqttUtility::sendFrame(StateFrame& frame, const char* topic) {
+  size_t len;
+  {
+    #ifdef MQTTU_DIAGNOSTICS
+    PhaseTimer timer(_phases[PHASE_SERIALIZE]);
+    #endif
+    len = frame.render();
+  }
+  if (len == 0) return PUB_DROPPED;  // Larger than STATE_FRAME_SIZE
+
+  if (_state == CONN_STATE_CONNECTED && publishPayload(frame.getPayload(), len, topic, false)) {
+    #ifdef MQTTU_PACKED_STATE
+    if (_packedTopic != NULL) {
+      uint8_t packed[STATE_FRAME_SIZE];
+      size_t packedLen = frame.pack(packed, sizeof(packed));
+      if (packedLen > 0) publishPayload(packed, packedLen, _packedTopic, false);
+    }
+    #endif
+    return PUB_OK;
+  }
+  #ifdef MQTTU_BACKFILL
+  if (_backfillTopic != NULL) {
+    uint8_t data[255];
+    if (bufferRecord(data, frame.pack(data, sizeof(data)))) return PUB_BUFFERED;
+  }
+  #endif
+  return PUB_DROPPED;
+}
+
+bool MqttUtility::publish(const JsonDocument& doc, const char* topic) {
+  return _state == CONN_STATE_CONNECTED && publishJson(doc, topic, false);
+}
+
+bool MqttUtility::setTopicQos(const char* topic, uint8_t qos) {
+  if (topic == NULL || qos > 2) return false;
+  uint8_t i = 0;
+  while (i < _qosCount && strcmp(_qos[i].topic, topic) != 0) i++;
+  if (i == _qosCount) {
+    if (_qosCount >= MQTTU_QOS_SLOTS) return false;
+    _qos[_qosCount++].topic = topic;
+  }
+  _qos[i].qos = qos;
+  // The default 30 s wait for an acknowledgement outlasts the supervisor watchdog
+  if (qos > 0) _mqttClient->setConnectionTimeout(MQTTU_ACK_TIMEOUT);
+  return true;
+}
+
+void MqttUtility::setAvailabilityTopic(const char* topic) {
+  _avtyTopic = topic;
+}
+
+bool MqttUtility::sendAvailability(const JsonDocument& doc) {
+  if (_state != CONN_STATE_CONNECTED || _avtyTopic == NULL) return false;
+  return publishJson(doc, _avtyTopic, true);
+}
+
+#ifdef MQTTU_DIAGNOSTICS
+PhaseStats& MqttUtility::getPhase(util_phase phase) {
+  return _phases[phase];
+}
+
+void MqttUtility::setDiagnosticsTopic(const char* topic) {
+  _diagTopic = topic;
+  MemWatermark::paint();
+}
+#endif
+
+#ifdef MQTTU_OTA
+void MqttUtility::setOtaTopics(const char* topic, const char* statusTopic, util_ota_callback callback) {
+  _otaTopic = topic;
+  _otaStatusTopic = statusTopic;
+  _otaCallback = callback;
+  _instance = this;
+  _sessionValid = false;
+  _mqttClient->onMessage(onMqttMessage);
+  if (_state == CONN_STATE_CONNECTED) subscribeCommands();
+}
+
+bool MqttUtility::isOtaActive() const {
+  return _ota.isActive() || _otaApplyDue;
+}
+#endif
+
+void MqttUtility::setBackfillTopic(const char* topic) {
+  #ifdef MQTTU_BACKFILL
+  _backfillTopic = topic;
+  #endif
+}
+
+#ifdef MQTTU_PACKED_STATE
+void MqttUtility::setPackedTopic(const char* topic) {
+  _packedTopic = topic;
+}
+#endif
+
+uint16_t MqttUtility::getBackfillCount() const {
+  #ifdef MQTTU_BACKFILL
+  return _backfill.count();
+  #else
+  return 0;
+  #endif
+}
+
+uint16_t MqttUtility::checkConnection() {
+  if (!_started) return CONN_NOT_STARTED;
+  int status = getConnectionStatus();
+  return reconnect(status);
+}
+
+void MqttUtility::configureTopic(const mdev& device, uint16_t expiresAfter) {
+  if (_state != CONN_STATE_CONNECTED) return;
+
+  // Payload is streamed straight to the MqttClient, no intermediate output buffer is used.
+  // Device strings are read during publishDiscovery() and must stay valid until the method returns.
+  JsonDocument doc;
+  setComponent(doc.to<JsonObject>(), device, true, expiresAfter);
+  publishDiscovery(doc, device.configuration_topic);
+
+  return;
+}
+
+void MqttUtility::configureTopics(const mdev_info& device, const mdev* deviceConfigs, size_t count, uint16_t expiresAfter) {
+  if (_state != CONN_STATE_CONNECTED) return;
+
+  // One document is reused for every message, each payload is streamed straight to the MqttClient
+  JsonDocument doc;
+  for (size_t i = 0; i < count; i++) {
+    doc.clear();
+    setComponent(doc.to<JsonObject>(), deviceConfigs[i], true, expiresAfter);
+    setDevice(doc["dev"].to<JsonObject>(), device);
+    publishDiscovery(doc, deviceConfigs[i].configuration_topic);
+  }
+  saveDiscoveryCache();
+}
+
+void MqttUtility::configureComponents(const mdev_info& device, const mdev* deviceConfigs, size_t count, uint16_t expiresAfter) {
+  if (_state != CONN_STATE_CONNECTED) return;
+
+  // Device-based discovery: https://www.home-assistant.io/integrations/mqtt/#device-discovery-payload
+  JsonDocument doc;
+  setDevice(doc["dev"].to<JsonObject>(), device);
+  JsonObject origin = doc["o"].to<JsonObject>();
+  origin["name"] = "Mqtt Utility";
+  origin["sw"] = LIB_VERSION;
+  if (device.state_topic != NULL) doc["stat_t"] = device.state_topic;
+
+  JsonObject components = doc["cmps"].to<JsonObject>();
+  for (size_t i = 0; i < count; i++) {
+    JsonObject component = components[deviceConfigs[i].unique_id].to<JsonObject>();
+    component["p"] = "sensor";
+    // Components reading another topic than the device one (e.g. diagnostics) keep their own state topic
+    bool ownTopic = device.state_topic == NULL || strcmp(deviceConfigs[i].state_topic, device.state_topic) != 0;
+    setComponent(component, deviceConfigs[i], ownTopic, expiresAfter);
+  }
+  publishDiscovery(doc, device.configuration_topic);
+  saveDiscoveryCache();
+}
+
+#ifdef MQTTU_STRING_MDEVS
+void MqttUtility::configureTopic(mdevs* device) {
+  if (_state != CONN_STATE_CONNECTED) return;
+
+  JsonDocument doc;
+  // Do not set device class when value is "None": Generic sensor https://www.home-assistant.io/integrations/sensor/#device-class
+  if(device->device_class != "None") doc["dev_cla"] = device->device_class;                              
+  doc["exp_aft"] = device->expires_after;                                       
+  doc["name"] = device->name;                     
+  doc["stat_t"] = device->state_topic;                                 
+  doc["uniq_id"] = device->unique_id;                             
+  doc["unit_of_meas"] = device->unit_of_measurement;                                  
+  doc["val_tpl"] = device->value_template;  
+  publishDiscovery(doc, device->configuration_topic.c_str());
+
+  return;
+}
+#endif
+
+void MqttUtility::configureTopic(const JsonDocument& doc, const char* topic) {
+  if (_state != CONN_STATE_CONNECTED) return;
+  publishDiscovery(doc, topic);
+  return;
+}
+
+void MqttUtility::saveDiscoveryCache() {
+  #ifdef MQTTU_DISCOVERY_CACHE
+  if (!_discDirty) return;
+
+  // Zeroed so struct padding does not change the checksum
+  disc_record record;
+  memset(&record, 0, sizeof(record));
+  record.magic = MQTTU_DISCOVERY_MAGIC;
+  record.count = _discCount;
+  memcpy(record.slots, _discSlots, _discCount * sizeof(disc_slot));
+  HashPrint hash;
+  hash.write((const uint8_t*)&record, offsetof(disc_record, checksum));
+  record.checksum = hash.hash;
+
+  discoveryFlash.write(record);
+  _discDirty = false;
+  #endif
+}
+
+void MqttUtility::clearDiscoveryCache() {
+  #ifdef MQTTU_DISCOVERY_CACHE
+  _discCount = 0;
+  _discLoaded = true;
+  _discDirty = true;
+  #endif
+}
+
+void MqttUtility::setCommandCallback(const char* topic, util_cmd_callback callback) {
+  _cmdTopic = topic;
+  _cmdCallback = callback;
+  _instance = this;
+  _sessionValid = false;
+  _mqttClient->onMessage(onMqttMessage);
+  if (_state == CONN_STATE_CONNECTED) subscribeCommands();
+}
+
+void MqttUtility::setConfigCallback(const char* topic, util_cfg_callback callback) {
+  _cmdTopic = topic;
+  _cfgCallback = callback;
+  _instance = this;
+  _sessionValid = false;
+  _mqttClient->onMessage(onMqttMessage);
+  if (_state == CONN_STATE_CONNECTED) subscribeCommands();
+}
+
+void MqttUtility::setPersistentSession(const char* clientId) {
+  _persistent = clientId != NULL && strlen(clientId) > 0;
+  _sessionValid = false;
+  // The default id is random per boot, the broker finds a session only under the same id
+  if (_persistent) _mqttClient->setId(clientId);
+  _mqttClient->setCleanSession(!_persistent);
+}
+
+void MqttUtility::setMqttHost(const char* address, uint16_t port) {
+  _host = address;
+  _port = port;
+}
+
+void MqttUtility::setWiFiNetwork(const char* ssid, const char* psk) {
+  _networks = NULL;
+  _networkCount = 0;
+  _scanNeeded = false;
+  _ssid = ssid;
+  _psk = psk;
+}
+
+void MqttUtility::setWiFiNetworks(const wifi_cred* networks, uint8_t count) {
+  if (networks == NULL || count == 0) return;
+  _networks = networks;
+  _networkCount = count;
+  _scanNeeded = count > 1;
+  useNetwork(0);
+}
+
+bool MqttUtility::setWifiRetry(short i) {
+  if (i > 100 || i < 0) return false;
+  _retry = i;
+  return true;
+}
+
+void MqttUtility::setMqttUser(const char* username, const char* password) {
+  _user = username;
+  _pass = password;
+  return _mqttClient->setUsernamePassword(_user, _pass);
+}
+
+void MqttUtility::pollMqtt() {
+  if (_state != CONN_STATE_CONNECTED) return;
+  return _mqttClient->poll();
+}
+
+int16_t MqttUtility::getStatus() {
+  return _status;
+}
+
+int16_t MqttUtility::getMqttError() {
+  return _mqttErr;
+}
+
+// ================================ Class private methods ========================================
+
+int16_t MqttUtility::getConnectionStatus() const {
+  if (WiFi.status() == WL_CONNECTED) {
+    if (_mqttClient->connected() == 1) return CONN_OK;
+    else return CONN_NO_MQTT;
+  } else return CONN_NO_WIFI;
+}
+
+bool MqttUtility::publishJson(const JsonDocument& doc, const char* topic, bool retain, int8_t qos) {
+  // Message size is known up front, MqttClient writes the payload directly to the socket
+  // instead of buffering it. serializeJson() then prints the document straight into the message.
+  size_t len;
+  {
+    #ifdef MQTTU_DIAGNOSTICS
+    PhaseTimer timer(_phases[PHASE_SERIALIZE]);
+    #endif
+    len = measureJson(doc);
+  }
+  #ifdef MQTTU_DIAGNOSTICS
+  PhaseTimer timer(_phases[PHASE_PUBLISH]);
+  #endif
+  if (!_mqttClient->beginMessage(topic, len, retain, qos < 0 ? topicQos(topic) : qos)) return false;
+  serializeJson(doc, *_mqttClient);
+  return endPublish();
+}
+
+bool MqttUtility::publishPayload(const uint8_t* payload, size_t len, const char* topic, bool retain) {
+  #ifdef MQTTU_DIAGNOSTICS
+  PhaseTimer timer(_phases[PHASE_PUBLISH]);
+  #endif
+  if (!_mqttClient->beginMessage(topic, len, retain, topicQos(topic))) return false;
+  _mqttClient->write(payload, len);
+  return endPublish();
+}
+
+bool MqttUtility::connectMqtt() {
+  #ifdef MQTTU_DIAGNOSTICS
+  PhaseTimer timer(_phases[PHASE_CONNECT]);
+  #endif
+  return _mqttClient->connect(_host, _port);
+}
+
+uint8_t MqttUtility::topicQos(const char* topic) const {
+  for (uint8_t i = 0; i < _qosCount; i++) {
+    if (strcmp(_qos[i].topic, topic) == 0) return _qos[i].qos;
+  }
+  return 0;
+}
+
+bool MqttUtility::endPublish() {
+  // At QoS 1 and 2 the result includes the broker's acknowledgement
+  if (_mqttClient->endMessage() == 1) return true;
+  #ifdef MQTTU_DIAGNOSTICS
+  if (_pubFailures < UINT16_MAX) _pubFailures++;
+  #endif
+  return false;
+}
+
+#ifdef MQTTU_PACKED_STATE
+bool MqttUtility::publishMsgPack(const JsonDocument& doc, const char* topic, bool retain) {
+  // Numbers are written in binary instead of text, no quoting or separators
+  size_t len = measureMsgPack(doc);
+  if (!_mqttClient->beginMessage(topic, len, retain, topicQos(topic))) return false;
+  serializeMsgPack(doc, *_mqttClient);
+  return endPublish();
+}
+#endif
+
+void MqttUtility::setComponent(JsonObject obj, const mdev& device, bool withStateTopic, uint16_t expiresAfter) {
+  // Do not set device class when value is "None": Generic sensor https://www.home-assistant.io/integrations/sensor/#device-class
+  if(device.device_class != NULL && strcmp(device.device_class, "None") != 0) obj["dev_cla"] = device.device_class;
+  obj["exp_aft"] = expiresAfter != 0 ? expiresAfter : device.expires_after;
+  obj["name"] = device.name;
+  if(withStateTopic) obj["stat_t"] = device.state_topic;
+  if(device.entity_category != NULL) obj["ent_cat"] = device.entity_category;
+  if(device.availability_template != NULL && _avtyTopic != NULL) {
+    obj["avty_t"] = _avtyTopic;
+    obj["avty_tpl"] = device.availability_template;
+  }
+  obj["uniq_id"] = device.unique_id;
+  if(device.unit_of_measurement != NULL) obj["unit_of_meas"] = device.unit_of_measurement;
+  obj["val_tpl"] = device.value_template;
+}
+
+void MqttUtility::setDevice(JsonObject obj, const mdev_info& device) {
+  obj["ids"] = device.identifier;
+  obj["name"] = device.name;
+  if (device.manufacturer != NULL) obj["mf"] = device.manufacturer;
+  if (device.model != NULL) obj["mdl"] = device.model;
+  if (device.sw_version != NULL) obj["sw"] = device.sw_version;
+}
+
+bool MqttUtility::publishDiscovery(const JsonDocument& doc, const char* topic) {
+  #ifdef MQTTU_DISCOVERY_CACHE
+  if (!_discLoaded) loadDiscoveryCache();
+
+  HashPrint topicHash, payloadHash;
+  topicHash.print(topic);
+  serializeJson(doc, payloadHash);
+
+  int slot = findDiscoverySlot(topicHash.hash);
+  if (slot >= 0 && _discSlots[slot].payload == payloadHash.hash) {
+    #ifdef MQTTU_DISCOVERY_VERIFY
+    // Retained copy may be gone, e.g. after a broker restart without persistence
+    if (retainedHash(topic) == payloadHash.hash) return true;
+    #else
+    return true;
+    #endif
+  }
+
+  if (!publishJson(doc, topic, true)) return false;
+  if (slot < 0 && _discCount < MQTTU_DISCOVERY_SLOTS) slot = _discCount++;
+  if (slot >= 0) {
+    _discSlots[slot].topic = topicHash.hash;
+    _discSlots[slot].payload = payloadHash.hash;
+    _discDirty = true;
+  }
+  return true;
+  #else
+  return publishJson(doc, topic, true);
+  #endif
+}
+
+#ifdef MQTTU_DISCOVERY_CACHE
+void MqttUtility::loadDiscoveryCache() {
+  _discLoaded = true;
+  _discCount = 0;
+
+  disc_record record;
+  discoveryFlash.read(&record);
+  if (record.magic != MQTTU_DISCOVERY_MAGIC || record.count > MQTTU_DISCOVERY_SLOTS) return;
+  HashPrint hash;
+  hash.write((const uint8_t*)&record, offsetof(disc_record, checksum));
+  if (record.checksum != hash.hash) return;
+
+  memcpy(_discSlots, record.slots, record.count * sizeof(disc_slot));
+  _discCount = record.count;
+}
+
+int MqttUtility::findDiscoverySlot(uint32_t topicHash) {
+  for (uint8_t i = 0; i < _discCount; i++) {
+    if (_discSlots[i].topic == topicHash) return i;
+  }
+  return -1;
+}
+
+#ifdef MQTTU_DISCOVERY_VERIFY
+uint32_t MqttUtility::retainedHash(const char* topic) {
+  // The broker sends the retained message right after SUBACK, wait for it a short while
+  _verifyTopic = topic;
+  _verifyHash = 0;
+  _verifyDone = false;
+  _instance = this;
+  _mqttClient->onMessage(onMqttMessage);
+
+  if (_mqttClient->subscribe(topic)) {
+    uint32_t start = millis();
+    while (!_verifyDone && millis() - start < MQTTU_VERIFY_TIMEOUT) _mqttClient->poll();
+    _mqttClient->unsubscribe(topic);
+  }
+  _verifyTopic = NULL;
+  return _verifyHash;
+}
+#endif
+#endif
+
+int16_t MqttUtility::reconnect(int status) {
+  // Non-blocking: hand a lost connection over to the connection engine, tick() does the work
+  if (status == CONN_OK && _state == CONN_STATE_CONNECTED) return CONN_OK;
+  if (_state == CONN_STATE_CONNECTED) {
+    if (status == CONN_NO_MQTT) setState(CONN_STATE_MQTT);
+    else connectWifi();
+  }
+  if (tick() == CONN_STATE_CONNECTED) return CONN_OK;
+  if (_state == CONN_STATE_BACKOFF) return _status;
+  return getConnectionStatus();
+}
+
+void MqttUtility::connectWifi() {
+  _sessionValid = false;
+  // A zero timeout makes WiFi.begin() return as soon as the association request is sent,
+  // the result is then polled from tick() with WiFi.status()
+  WiFi.setTimeout(0);
+  #ifdef MQTTU_LOW_POWER
+  // Static config from the cached lease skips DHCP. NINA firmware gives no BSSID/channel hint to
+  // begin(), so the association itself still scans. DNS is assumed to be served by the gateway.
+  if (_leaseValid && uptime() - _leaseSince > MQTTU_LEASE_REUSE) _leaseValid = false;
+  if (_leaseValid) WiFi.config(_leaseIp, _leaseGateway, _leaseGateway, _leaseSubnet);
+  #endif
+  if (_scanNeeded) {
+    // Nothing from the list in range: try the next network, a failed association scans again
+    int8_t best = strongestNetwork(NULL);
+    useNetwork(best >= 0 ? best : (_network + 1) % _networkCount);
+    _scanNeeded = false;
+  }
+  if (_psk == NULL || strcmp(_psk, "") == 0) WiFi.begin(_ssid);
+  else WiFi.begin(_ssid, _psk);
+  setState(CONN_STATE_WIFI);
+}
+
+int8_t MqttUtility::strongestNetwork(int32_t* rssi) {
+  // Blocking scan. Hidden networks are not listed and are never chosen
+  int8_t found = WiFi.scanNetworks();
+  int8_t best = -1;
+  int32_t bestRssi = INT32_MIN;
+  for (int8_t i = 0; i < found; i++) {
+    int32_t level = WiFi.RSSI(i);
+    if (level <= bestRssi) continue;
+    const char* ssid = WiFi.SSID(i);
+    for (uint8_t k = 0; k < _networkCount; k++) {
+      if (strcmp(ssid, _networks[k].ssid) != 0) continue;
+      best = k;
+      bestRssi = level;
+      break;
+    }
+  }
+  if (rssi != NULL) *rssi = bestRssi;
+  return best;
+}
+
+void MqttUtility::useNetwork(uint8_t index) {
+  _network = index;
+  _ssid = _networks[index].ssid;
+  _psk = _networks[index].psk;
+}
+
+void MqttUtility::roam() {
+  _lastRoam = monotonicMs();
+  int32_t current = WiFi.RSSI();
+  if (current >= MQTTU_ROAM_RSSI) return;
+
+  // Margin keeps two networks of similar strength from trading the node back and forth
+  int32_t level;
+  int8_t best = strongestNetwork(&level);
+  if (best < 0 || best == _network || level < current + MQTTU_ROAM_MARGIN) return;
+  useNetwork(best);
+  _mqttClient->stop();
+  WiFi.disconnect();
+  connectWifi();
+}
+
+bool MqttUtility::retriesUsed() const {
+  return _retry > 0 && _attempts >= (uint16_t)_retry;
+}
+
+void MqttUtility::backoff(int16_t status) {
+  // The broker may have restarted and lost the session while it was unreachable
+  _sessionValid = false;
+  _status = status;
+  if (_attempts < UINT16_MAX) _attempts++;
+
+  if (retriesUsed()) {
+    // Round failed: radio off until the next one, tick() starts over from the first backoff step
+    WiFi.end();
+    #ifdef MQTTU_LOW_POWER
+    _leaseValid = false;
+    #endif
+    _backoffDelay = MQTTU_RETRY_REST;
+    setState(CONN_STATE_BACKOFF);
+    return;
+  }
+
+  #ifdef MQTTU_LOW_POWER
+  // A stale static config may be the cause, reset NINA to drop it and fall back to DHCP
+  if (_leaseValid) {
+    _leaseValid = false;
+    WiFi.end();
+  }
+  #endif
+
+  // Exponential backoff with equal jitter: wait between delay/2 and delay.
+  // Randomizing the wait spreads out reconnect attempts of nodes that lost the network at the same time.
+  uint8_t exp = _attempts - 1 > 16 ? 16 : _attempts - 1;
+  uint32_t wait = (uint32_t)MQTTU_BACKOFF_BASE << exp;
+  if (wait > MQTTU_BACKOFF_MAX) wait = MQTTU_BACKOFF_MAX;
+  _backoffDelay = wait / 2 + nextRandom() % (wait / 2 + 1);
+  setState(CONN_STATE_BACKOFF);
+}
+
+void MqttUtility::subscribeCommands() {
+  // Clean sessions drop subscriptions on disconnect, persistent ones queue QoS 1 commands while offline
+  if (_cmdTopic != NULL) _mqttClient->subscribe(_cmdTopic, _persistent ? 1 : 0);
+  #ifdef MQTTU_OTA
+  if (_otaTopic != NULL) _mqttClient->subscribe(_otaTopic, _persistent ? 1 : 0);
+  #endif
+}
+
+uint32_t MqttUtility::monotonicMs() const {
+  // millis() stops in standby, uptime() also counts time spent sleeping
+  #ifdef MQTTU_LOW_POWER
+  return (uint32_t)uptime();
+  #else
+  return millis();
+  #endif
+}
+
+void MqttUtility::syncTime() {
+  // NINA gets time over NTP after association, 0 until then
+  uint32_t time = WiFi.getTime();
+  if (time == 0) return;
+  _epoch = time;
+  _epochAt = monotonicMs();
+}
+
+#ifdef MQTTU_BACKFILL
+bool MqttUtility::bufferSample(const JsonDocument& doc) {
+  if (_backfillTopic == NULL) return false;
+
+  // MessagePack keeps records compact and schema free, readings can be restored to JSON as is
+  uint8_t data[255];
+  size_t len = measureMsgPack(doc);
+  if (len > sizeof(data)) return false;
+  serializeMsgPack(doc, data, sizeof(data));
+  return bufferRecord(data, len);
+}
+
+bool MqttUtility::bufferRecord(const uint8_t* data, size_t len) {
+  if (len == 0) return false;  // Did not fit in a record
+  return _backfill.push(monotonicMs(), data, len);
+}
+
+void MqttUtility::drainBackfill(uint32_t now) {
+  if (_backfillTopic == NULL || _backfill.count() == 0) return;
+  if (now - _lastBackfill < MQTTU_BACKFILL_INTERVAL) return;
+  _lastBackfill = now;
+  if (_epoch == 0) syncTime();
+
+  JsonDocument batch;
+  JsonArray readings = batch.to<JsonArray>();
+  uint8_t data[255];
+  uint32_t time, clock = monotonicMs();
+  uint8_t len;
+  uint16_t n = 0;
+  while (n < MQTTU_BACKFILL_BATCH && _backfill.read(n, &time, data, &len)) {
+    n++;
+    JsonDocument reading;
+    if (deserializeMsgPack(reading, data, len)) continue;  // Drop corrupted records
+    if (_epoch != 0) reading["ts"] = _epoch + (int32_t)(time - _epochAt) / 1000;
+    else reading["age"] = (clock - time) / 1000;
+    readings.add(reading);
+  }
+
+  // Keep readings buffered if the publish fails, tick() retries after the next interval
+  if (readings.size() == 0 || publishJson(batch, _backfillTopic, false)) _backfill.pop(n);
+}
+#endif
+
+#ifdef MQTTU_OTA
+void MqttUtility::receiveOta(int size) {
+  // Called from MqttClient::poll(), status and callbacks are deferred to serviceOta()
+  uint8_t head[9];
+  if (size < 1 || _mqttClient->read(head, 1) != 1) return;
+  _otaLast = millis();
+  _otaAckDue = true;
+
+  switch (head[0]) {
+    case 'B': {
+      if (size != 9 || _mqttClient->read(head + 1, 8) != 8) return failOta("format");
+      uint32_t imageSize, crc;
+      memcpy(&imageSize, head + 1, 4);   // Little-endian like the SAMD21
+      memcpy(&crc, head + 5, 4);
+      if (!_ota.begin(imageSize, crc)) return failOta("size");
+      _otaError = NULL;
+      _otaEvent = OTA_RECEIVING;
+      break;
+    }
+    case 'D': {
+      if (!_ota.isActive()) return;
+      uint32_t offset;
+      if (size < 5 || _mqttClient->read(head + 1, 4) != 4) return;
+      memcpy(&offset, head + 1, 4);
+      // Out of order, e.g. a lost acknowledgement: answer with the expected offset, payload is discarded
+      if (offset != _ota.getOffset() || size - 5 > MQTTU_OTA_CHUNK) return;
+
+      uint8_t buffer[64];
+      int left = size - 5;
+      while (left > 0) {
+        int n = _mqttClient->read(buffer, left < (int)sizeof(buffer) ? left : sizeof(buffer));
+        if (n <= 0) break;  // Resumed at the next acknowledged offset
+        if (!_ota.write(buffer, n)) return failOta("write");
+        left -= n;
+      }
+      break;
+    }
+    case 'E':
+      if (!_ota.isActive()) return;
+      if (!_ota.verify()) return failOta("crc");
+      _otaApplyDue = true;
+      break;
+    case 'A':
+      if (_ota.isActive()) failOta("aborted");
+      break;
+  }
+}
+
+void MqttUtility::failOta(const char* error) {
+  _ota.abort();
+  _otaError = error;
+  _otaEvent = OTA_FAILED;
+  _otaAckDue = true;
+}
+
+void MqttUtility::serviceOta(uint32_t now) {
+  if (_ota.isActive() && now - _otaLast >= MQTTU_OTA_TIMEOUT) failOta("timeout");
+
+  if (_otaEvent != OTA_IDLE) {
+    util_ota_state event = _otaEvent;
+    _otaEvent = OTA_IDLE;
+    if (_otaCallback != NULL) _otaCallback(event);
+  }
+  if (_otaApplyDue) {
+    if (_state == CONN_STATE_CONNECTED) {
+      // QoS 1 returns after the broker's PUBACK, a QoS 0 message could still be unsent when stop() closes the socket
+      publishOtaStatus("applying", 1);
+      _mqttClient->stop();
+    }
+    if (_otaCallback != NULL) _otaCallback(OTA_APPLYING);
+    _ota.apply();  // Does not return
+  }
+  if (_otaAckDue && _state == CONN_STATE_CONNECTED) {
+    _otaAckDue = false;
+    publishOtaStatus(_ota.isActive() ? "receiving" : _otaError != NULL ? "failed" : "idle");
+  }
+}
+
+bool MqttUtility::publishOtaStatus(const char* state, int8_t qos) {
+  if (_otaStatusTopic == NULL) return false;
+  JsonDocument doc;
+  doc["state"] = state;
+  doc["offset"] = _ota.getOffset();
+  doc["size"] = _ota.getSize();
+  doc["chunk"] = MQTTU_OTA_CHUNK;
+  if (_otaError != NULL && !_ota.isActive()) doc["error"] = _otaError;
+  return publishJson(doc, _otaStatusTopic, false, qos);
+}
+#endif
+
+#ifdef MQTTU_DIAGNOSTICS
+void MqttUtility::publishDiagnostics() {
+  static const char* const keys[PHASE_COUNT] = { "sens", "ser", "conn", "pub" };
+
+  JsonDocument doc;
+  for (int i = 0; i < PHASE_COUNT; i++) {
+    JsonObject phase = doc[keys[i]].to<JsonObject>();
+    phase["n"] = _phases[i].getCount();
+    phase["min"] = _phases[i].getMin();
+    phase["max"] = _phases[i].getMax();
+    phase["avg"] = _phases[i].getAvg();
+  }
+  doc["heap"] = freeMemory();
+  doc["hpk"] = MemWatermark::heapPeak();
+  doc["spk"] = MemWatermark::stackPeak();
+  doc["rssi"] = WiFi.RSSI();
+  doc["rcon"] = _reconnects;
+  doc["merr"] = _mqttErr;
+  doc["pubf"] = _pubFailures;
+
+  // Statistics cover one interval, reset before publishing so this message is timed in the next one
+  for (int i = 0; i < PHASE_COUNT; i++) _phases[i].reset();
+  publishJson(doc, _diagTopic, false);
+}
+
+uint32_t MqttUtility::freeMemory() const {
+  // Gap between the heap end and the stack pointer, memory freed inside the heap is not counted
+  #ifdef ARDUINO_ARCH_SAMD
+  char top;
+  return &top - sbrk(0);
+  #else
+  return 0;
+  #endif
+}
+#endif
+
+void MqttUtility::onMqttMessage(int size) {
+  MqttUtility* self = _instance;
+  if (self == NULL) return;
+
+  #ifdef MQTTU_DISCOVERY_VERIFY
+  if (self->_verifyTopic != NULL && self->_mqttClient->messageTopic() == self->_verifyTopic) {
+    HashPrint hash;
+    while (self->_mqttClient->available()) hash.write((uint8_t)self->_mqttClient->read());
+    self->_verifyHash = hash.hash;
+    self->_verifyDone = true;
+    return;
+  }
+  #endif
+
+  #ifdef MQTTU_OTA
+  if (self->_otaTopic != NULL && self->_mqttClient->messageTopic() == self->_otaTopic) {
+    self->receiveOta(size);
+    return;
+  }
+  #endif
+
+  if (self->_cmdCallback == NULL && self->_cfgCallback == NULL) return;
+
+  // Drop oversized or unrelated messages, the unread payload is discarded by MqttClient
+  if (size > MQTTU_COMMAND_MAX || self->_mqttClient->messageTopic() != self->_cmdTopic) return;
+
+  char payload[MQTTU_COMMAND_MAX + 1];
+  int len = self->_mqttClient->read((uint8_t*)payload, size);
+  if (len < 0) return;
+  payload[len] = '\0';
+
+  if (payload[0] == '{') {
+    if (self->_cfgCallback == NULL) return;
+    uint8_t buffer[MQTTU_CONFIG_POOL];
+    StaticPool pool(buffer, sizeof(buffer));
+    JsonDocument doc(&pool);
+    if (deserializeJson(doc, payload, len) || !doc.is<JsonObjectConst>()) return;
+    self->_cfgCallback(doc.as<JsonObjectConst>());
+    return;
+  }
+  if (self->_cmdCallback != NULL) self->_cmdCallback(payload, len);
+}
+
+void MqttUtility::setState(util_conn_state state) {
+  _state = state;
+  _stateSince = millis();
+}
+
+uint32_t MqttUtility::nextRandom() {
+  // xorshift32, seeded from the WiFi MAC address so each node gets its own sequence
+  if (_rng == 0) {
+    uint8_t mac[6];
+    WiFi.macAddress(mac);
+    _rng = micros();
+    for (int i = 0; i < 6; i++) _rng = (_rng << 5) ^ (_rng >> 27) ^ mac[i];
+    if (_rng == 0) _rng = 0x9E3779B9;
+  }
+  _rng ^= _rng << 13;
+  _rng ^= _rng >> 17;
+  _rng ^= _rng << 5;
+  return _rng;
+}
+
+#ifdef MQTTU_LOW_POWER
+uint64_t MqttUtility::uptime() const {
+  return _awakeMs + _sleepMs + (millis() - _wakeSince);
+}
+
+void MqttUtility::cacheLease() {
+  _leaseIp = WiFi.localIP();
+  _leaseGateway = WiFi.gatewayIP();
+  _leaseSubnet = WiFi.subnetMask();
+  _leaseSince = uptime();
+  _leaseValid = (uint32_t)_leaseIp != 0;
+}
+#endif
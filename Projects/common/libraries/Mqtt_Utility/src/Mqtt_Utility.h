@@ -0,0 +1,653 @@
+/*
+  Arduino utility library for WiFi capable boards.
+  A WiFi and Mqtt client wrapper class that implements commonly used methods used by
+  arduino-based sensors to communicate with MQTT brokers over WiFi.
+
+  [Version 1] Basic MQTT sender applications
+  > Implements: 
+    - Basic getter and setter methods
+    - Connecting to WiFi and MQTT broker, strongest of a static network list with roaming on a weak link
+    - Connection status checking and reconnecting, attempts in rounds with the radio off between rounds
+    - MQTT Discovery protocol device configuration publishing
+    - Discovery payload hash cache in flash, unchanged configs are not re-published
+    - Batched discovery with a shared device block, and device-based discovery in one message
+    - Publishing JSON payloads to MQTT topic, per topic QoS and publish results for the caller
+    - Command topic subscription with a payload callback
+    - Persistent MQTT sessions under a stable client id, a short outage reconnects with one CONNECT
+    - Per sensor availability on a retained availability topic
+    - Offline ring buffer of readings (MessagePack) with rate limited backfill after reconnect
+    - MessagePack copy of state payloads on a parallel topic (MQTTU_PACKED_STATE)
+    - Low-power duty cycling (MQTTU_LOW_POWER): standby sleep, NINA held in reset,
+      cached DHCP lease for fast reconnects, average current estimate
+    - Self-telemetry (MQTTU_DIAGNOSTICS): phase timings, free memory, RSSI and connection errors
+    - Change-based reporting (ReportGate): deadband triggered reports with a heartbeat, rolling min/max/mean
+    - Config documents on the command topic, parsed without heap allocation (StaticPool)
+    - Typed state frames (StateFrame), rendered once into a static buffer and written to the socket as is
+    - Firmware updates over MQTT (MQTTU_OTA): chunks streamed into the upper flash half with a CRC-32
+
+  [Version 1.2] Shared library
+  > One copy in common/libraries, linked by every project with a symlink:// lib_deps entry.
+    Optional features are selected with build_flags and are not compiled in when disabled:
+    - MQTTU_STRING_MDEVS: Arduino String based mdevs topic configuration (heap allocated)
+    - MQTTU_PACKED_STATE: setPackedTopic(), MessagePack state payloads
+    - MQTTU_NO_BACKFILL: No offline ring buffer (saves MQTTU_BACKFILL_SIZE bytes of RAM)
+    - MQTTU_NO_DISCOVERY_CACHE: No discovery hash cache in flash
+    - MQTTU_DISCOVERY_VERIFY: Check the cache against the broker's retained configs
+    - MQTTU_LOW_POWER: Deep-sleep duty cycling
+    - MQTTU_DIAGNOSTICS: Phase timers and a diagnostics topic
+    - MQTTU_OTA: Firmware updates on an OTA topic, staged in the upper half of the flash (Flash_Layout)
+    TLS is selected by the project: pass a WiFiSSLClient instead of a WiFiClient.
+
+  Author: Ilari Mattsson
+  Library: Mqtt Utility
+  File: Mqtt_Utility.h
+  Version: 1.2
+*/
+
+#ifndef MQTT_UTIL_H
+#define MQTT_UTIL_H
+
+#include <ArduinoMqttClient.h>
+#include <ArduinoJson.h>
+#include <Client.h>
+#include <WiFi.h>
+
+extern "C" {  // External definitions using C calling conventions
+	#include "utils/mqttutility_definitions.h"
+}
+
+// Offline backfill buffer, define MQTTU_NO_BACKFILL to drop readings published while offline
+#ifndef MQTTU_NO_BACKFILL
+#define MQTTU_BACKFILL
+#include "utils/sample_ring.h"
+#endif
+
+#ifdef MQTTU_DIAGNOSTICS
+#include "utils/phase_stats.h"
+#include "utils/mem_watermark.h"
+#endif
+
+#ifdef MQTTU_OTA
+#include "utils/ota_receiver.h"
+#endif
+
+#include "utils/state_frame.h"
+#include "utils/report_gate.h"
+#include "utils/static_pool.h"
+
+// JSON object received on the command topic, valid until the callback returns
+typedef void (*util_cfg_callback)(JsonObjectConst config);
+
+#define LIB_VERSION "1.2"
+
+#ifndef MQTTU_WIFI_TIMEOUT
+#define MQTTU_WIFI_TIMEOUT 15000   // ms to wait for WiFi association before backing off
+#endif
+#ifndef MQTTU_ROAM_RSSI
+#define MQTTU_ROAM_RSSI -75        // dBm, a link weaker than this scans the network list for a better one
+#endif
+#ifndef MQTTU_ROAM_MARGIN
+#define MQTTU_ROAM_MARGIN 8        // dB another network must be stronger by before the node moves to it
+#endif
+#ifndef MQTTU_ROAM_INTERVAL
+#define MQTTU_ROAM_INTERVAL 300000 // ms between link checks while connected, a scan blocks for ~2 s
+#endif
+#ifndef MQTTU_BACKOFF_BASE
+#define MQTTU_BACKOFF_BASE 2000    // ms, backoff after the first failed attempt
+#endif
+#ifndef MQTTU_BACKOFF_MAX
+#define MQTTU_BACKOFF_MAX 300000   // ms, backoff upper limit
+#endif
+#ifndef MQTTU_RETRY_REST
+#define MQTTU_RETRY_REST 900000    // ms with WiFi off after setWifiRetry() attempts in a row failed
+#endif
+
+// Discovery cache uses FlashStorage (SAMD), define MQTTU_NO_DISCOVERY_CACHE to always publish
+#if defined(ARDUINO_ARCH_SAMD) && !defined(MQTTU_NO_DISCOVERY_CACHE)
+#define MQTTU_DISCOVERY_CACHE
+#endif
+#ifndef MQTTU_DISCOVERY_SLOTS
+#define MQTTU_DISCOVERY_SLOTS 16   // Cached discovery topics, topics beyond this are always published. Max 30 (one flash row)
+#endif
+#ifndef MQTTU_VERIFY_TIMEOUT
+#define MQTTU_VERIFY_TIMEOUT 500   // ms to wait for a retained config with MQTTU_DISCOVERY_VERIFY
+#endif
+
+#ifndef MQTTU_BACKFILL_SIZE
+#define MQTTU_BACKFILL_SIZE 2048     // bytes, each reading takes 5 + its MessagePack size
+#endif
+#ifndef MQTTU_BACKFILL_BATCH
+#define MQTTU_BACKFILL_BATCH 5       // Readings per backfill message
+#endif
+#ifndef MQTTU_BACKFILL_INTERVAL
+#define MQTTU_BACKFILL_INTERVAL 1000 // ms between backfill messages
+#endif
+
+#ifndef MQTTU_DIAGNOSTICS_INTERVAL
+#define MQTTU_DIAGNOSTICS_INTERVAL 600000  // ms between diagnostics messages
+#endif
+
+#ifndef MQTTU_COMMAND_MAX
+#define MQTTU_COMMAND_MAX 128      // Max command payload length, longer messages are dropped
+#endif
+#ifndef MQTTU_QOS_SLOTS
+#define MQTTU_QOS_SLOTS 4          // Topics with a QoS set by setTopicQos(), other topics are QoS 0
+#endif
+#ifndef MQTTU_ACK_TIMEOUT
+#define MQTTU_ACK_TIMEOUT 5000     // ms to wait for a PUBACK (and CONNACK) once a topic uses QoS 1
+#endif
+#ifndef MQTTU_CONFIG_POOL
+#define MQTTU_CONFIG_POOL 1536     // bytes of stack for parsing a config document, ArduinoJson 7 takes a 1 kB slot pool first
+#endif
+
+#ifdef MQTTU_OTA
+#ifndef MQTTU_OTA_CHUNK
+#define MQTTU_OTA_CHUNK 1024       // Max image bytes per chunk message, announced to the sender in the status
+#endif
+#ifndef MQTTU_OTA_TIMEOUT
+#define MQTTU_OTA_TIMEOUT 30000    // ms without a chunk before an update is abandoned
+#endif
+#endif
+
+#ifdef MQTTU_LOW_POWER
+#ifndef MQTTU_LEASE_REUSE
+#define MQTTU_LEASE_REUSE 3600000  // ms, max age of a cached DHCP lease used as static IP config
+#endif
+#ifndef MQTTU_AWAKE_CURRENT
+#define MQTTU_AWAKE_CURRENT 45.0f  // mA, board average while awake with WiFi on
+#endif
+#ifndef MQTTU_SLEEP_CURRENT
+#define MQTTU_SLEEP_CURRENT 1.5f   // mA, board in standby with NINA in reset
+#endif
+#endif
+
+class MqttUtility {
+public:
+  MqttUtility(Client* client);
+  MqttUtility(Client& client);
+  MqttUtility(Client* wifiClient, MqttClient* mqttClient, const char* ssid, const char* psk, const char* host, uint16_t port);
+  MqttUtility(Client& wifiClient, MqttClient& mqttClient, const char* ssid, const char* psk, const char* host, uint16_t port);
+  ~MqttUtility();
+
+  /**
+   * Start connections, blocks until connected or WiFi retry attempts are used up
+  */
+  int begin();
+
+  /**
+   * Start connections without blocking, connection is advanced by tick()
+  */
+  bool start();
+
+  /**
+   * Advance connection state machine, polls MQTT when connected. Call from loop()
+  */
+  util_conn_state tick();
+
+  /**
+   * Get connection state machine state
+  */
+  util_conn_state getState() const;
+
+  /**
+   * ms since boot, also counts time spent in MQTTU_LOW_POWER standby. E.g. for ReportGate.
+  */
+  uint32_t monotonicMs() const;
+
+  /**
+   * End connections
+  */
+  void end();
+
+  #ifdef MQTTU_LOW_POWER
+  /**
+   * End connections and sleep in SAMD21 standby for ms milliseconds, WiFi.end() holds NINA in reset.
+   * Connections are restarted without blocking on wake, the first reconnect reuses the cached DHCP lease.
+   * Returns sleep time not counted by millis() (SysTick stops in standby), e.g. for TaskScheduler::advance()
+  */
+  uint32_t sleep(uint32_t ms);
+
+  /**
+   * Total awake time in seconds
+  */
+  uint32_t getAwakeTime() const;
+
+  /**
+   * Total sleep time in seconds
+  */
+  uint32_t getSleepTime() const;
+
+  /**
+   * Estimated average current in mA since boot, from awake/sleep time and MQTTU_*_CURRENT
+  */
+  float getAverageCurrent() const;
+  #endif
+
+  /**
+   * Library version
+  */
+  static const char* version();
+
+  /**
+   * Publish JSON payload to topic. Payloads that cannot be sent are buffered for backfill
+   * returns: util_pub_result: PUB_DROPPED if the reading is lost, e.g. report it again later
+  */
+  util_pub_result sendPackets(const JsonDocument& doc, const char* topic);
+
+  /**
+   * Publish a state frame to topic. The frame is rendered once and its buffer is written to the socket,
+   * the MessagePack copy and backfill record are encoded from the frame. Frames that cannot be sent
+   * are buffered for backfill
+   * returns: util_pub_result: PUB_DROPPED if the reading is lost, e.g. report it again later
+  */
+  util_pub_result sendFrame(StateFrame& frame, const char* topic);
+
+  /**
+   * Publish JSON payload to topic once, not buffered for backfill. For payloads the caller keeps
+   * and retries itself, e.g. readings relayed for other nodes.
+   * returns: bool: true if published
+  */
+  bool publish(const JsonDocument& doc, const char* topic);
+
+  /**
+   * Publish topic at QoS 0..2, up to MQTTU_QOS_SLOTS topics. A QoS 1 message counts as published only
+   * after its PUBACK: MqttClient::endMessage() waits for it, at most MQTTU_ACK_TIMEOUT, so one message
+   * is in flight at a time. Failed state and backfill messages stay buffered for backfill.
+   * returns: bool: false if qos is out of range or every slot is taken
+  */
+  bool setTopicQos(const char* topic, uint8_t qos);
+
+  /**
+   * Set topic for readings buffered while offline, NULL = do not buffer (default).
+   * After reconnect they are published from tick() as JSON arrays of up to MQTTU_BACKFILL_BATCH
+   * readings, one message per MQTTU_BACKFILL_INTERVAL. Each reading gets "ts" (unix time) or,
+   * if network time is not available, "age" (s).
+  */
+  void setBackfillTopic(const char* topic);
+
+  /**
+   * Number of buffered readings waiting for backfill
+  */
+  uint16_t getBackfillCount() const;
+
+  #ifdef MQTTU_PACKED_STATE
+  /**
+   * Set topic for a MessagePack copy of every state payload, NULL = JSON only (default).
+   * The JSON topic is always published so Home Assistant value templates keep working.
+   * The binary payload decodes to the same map as the JSON one with any MessagePack library,
+   * e.g. Python: msgpack.unpackb(payload) or Node-RED: node-red-contrib-msgpack.
+  */
+  void setPackedTopic(const char* topic);
+  #endif
+
+  /**
+   * Set the availability topic, used in discovery configs of mdevs with an availability_template.
+   * Call before configuring topics.
+  */
+  void setAvailabilityTopic(const char* topic);
+
+  /**
+   * Publish retained availability, e.g. {"sht": "online", "ens": "offline"}. Include every source,
+   * the retained message replaces the previous one.
+   * returns: bool: true if published
+  */
+  bool sendAvailability(const JsonDocument& doc);
+
+  #ifdef MQTTU_DIAGNOSTICS
+  /**
+   * Timing statistics of a cycle phase. Project code is timed with a scoped PhaseTimer:
+   *   PhaseTimer timer(mqttUtility.getPhase(PHASE_SENSOR));
+  */
+  PhaseStats& getPhase(util_phase phase);
+
+  /**
+   * Set topic for diagnostics, published from tick() every MQTTU_DIAGNOSTICS_INTERVAL ms.
+   * Payload: "sens", "ser", "conn", "pub": {"n", "min", "max", "avg"} in us over the interval,
+   * "heap": free bytes, "hpk": heap peak bytes, "spk": stack peak bytes, "rssi": dBm,
+   * "rcon": connection losses since boot, "merr": last getMqttError().
+   * Paints free RAM for the stack peak (MemWatermark), call early in setup().
+   * Entities are registered by adding MQTTU_DIAGNOSTIC_SENSORS() to the discovery table.
+  */
+  void setDiagnosticsTopic(const char* topic);
+  #endif
+
+  #ifdef MQTTU_OTA
+  /**
+   * Receive firmware updates on topic (binary, common/scripts/ota_send.py), progress is published as JSON
+   * on statusTopic: {"state", "offset", "size", "chunk", "error"}. Messages, integers little-endian:
+   *   'B' size:u32 crc:u32     Start an image, crc is CRC-32 (zlib) of the whole image
+   *   'D' offset:u32 data      Chunk of up to MQTTU_OTA_CHUNK bytes, acknowledged with the next offset.
+   *                            A chunk not at the expected offset is answered with it, the sender resumes there
+   *   'E'                      Verify and apply, the board resets into the new sketch
+   *   'A'                      Abort
+   * Chunks go straight to flash, the image is never buffered in RAM. callback is called from tick() when
+   * the state changes, e.g. to pause sampling while receiving and the watchdog before applying.
+  */
+  void setOtaTopics(const char* topic, const char* statusTopic, util_ota_callback callback);
+
+  /**
+   * True while an image is being received, e.g. to skip MQTTU_LOW_POWER sleep
+  */
+  bool isOtaActive() const;
+  #endif
+
+  /**
+   * Check connection status, lost connections are handed to the connection engine without blocking
+  */
+  uint16_t checkConnection();
+
+  /**
+   * Publish device configuration from simplified mdev struct.
+   * expiresAfter (s) overrides mdev.expires_after, e.g. a configured sensor timeout, so mdev tables
+   * stay const and in flash. 0 = use the table value. Same for the table overloads below.
+  */
+  void configureTopic(const mdev& deviceConfig, uint16_t expiresAfter = 0);
+
+  /**
+   * Publish device configurations from a table of mdev structs, e.g. built with MQTTU_SENSOR()
+  */
+  template <size_t N>
+  void configureTopic(const mdev (&deviceConfigs)[N], uint16_t expiresAfter = 0) {
+    for (size_t i = 0; i < N; i++) configureTopic(deviceConfigs[i], expiresAfter);
+    saveDiscoveryCache();
+  }
+
+  /**
+   * Publish device configurations from a table of mdev structs, one message per sensor.
+   * Each payload carries the shared device block so Home Assistant groups the sensors under one device.
+  */
+  template <size_t N>
+  void configureTopic(const mdev_info& device, const mdev (&deviceConfigs)[N], uint16_t expiresAfter = 0) {
+    configureTopics(device, deviceConfigs, N, expiresAfter);
+  }
+  void configureTopics(const mdev_info& device, const mdev* deviceConfigs, size_t count, uint16_t expiresAfter = 0);
+
+  /**
+   * Publish a device-based discovery config: one message on device.configuration_topic with
+   * every sensor as a component. Per-sensor configs from configureTopic() must be removed from
+   * the broker before switching, otherwise Home Assistant sees duplicate unique ids.
+  */
+  template <size_t N>
+  void configureDevice(const mdev_info& device, const mdev (&deviceConfigs)[N], uint16_t expiresAfter = 0) {
+    configureComponents(device, deviceConfigs, N, expiresAfter);
+  }
+  // Named apart from configureDevice(), an int expiresAfter would otherwise select this overload as the count
+  void configureComponents(const mdev_info& device, const mdev* deviceConfigs, size_t count, uint16_t expiresAfter = 0);
+
+  #ifdef MQTTU_STRING_MDEVS
+  /**
+   * Publish device configuration from String based mdevs struct
+  */
+  void configureTopic(mdevs* devConf);
+  #endif
+
+  /**
+   * Publish device configuration from JSON document
+  */
+  void configureTopic(const JsonDocument& doc, const char* topic);
+
+  /**
+   * Write changed discovery payload hashes to flash. Called by the table configureTopic(),
+   * call after single configureTopic() calls. Flash is only written when a hash changed.
+  */
+  void saveDiscoveryCache();
+
+  /**
+   * Forget cached discovery hashes, the next configureTopic() calls publish every payload.
+   * Use when the broker has lost its retained messages.
+  */
+  void clearDiscoveryCache();
+
+  /**
+   * Subscribe to a command topic. Payloads are passed to callback from tick()/pollMqtt().
+   * The subscription is renewed on every reconnect. Only one MqttUtility instance can receive commands.
+  */
+  void setCommandCallback(const char* topic, util_cmd_callback callback);
+
+  /**
+   * Subscribe to a command topic for config documents. Payloads starting with '{' are parsed into a
+   * MQTTU_CONFIG_POOL stack buffer and passed to callback as a JSON object, other payloads go to the
+   * command callback. Shares the topic with setCommandCallback(), either call sets it.
+  */
+  void setConfigCallback(const char* topic, util_cfg_callback callback);
+
+  /**
+   * Connect with a persistent session (clean session off) under a stable client id, e.g. the device id.
+   * The broker keeps the command subscription, subscribed at QoS 1 so commands sent while offline are
+   * queued. If the broker answers the first reconnect after a drop the subscription is not renewed,
+   * recovery is one CONNECT round trip. Client ids must be unique on the broker. NULL = clean sessions.
+  */
+  void setPersistentSession(const char* clientId);
+
+  /**
+   * Set Mqtt host IP and port
+  */
+  void setMqttHost(const char* host, uint16_t port);
+
+  /**
+   * Set MQTT username and password
+  */
+  void setMqttUser(const char* username, const char* password);
+
+  /**
+   * Set WiFi network ssid & psk
+  */
+  void setWiFiNetwork(const char* ssid, const char* psk);
+
+  /**
+   * Set a static list of WiFi networks, e.g. an AP and a repeater with its own SSID. The list is scanned
+   * before the first association and the strongest network is joined, reconnects go to it without a scan.
+   * The list is scanned again after a failed association, and every MQTTU_ROAM_INTERVAL while the link is
+   * below MQTTU_ROAM_RSSI. networks must stay valid, e.g. a global const array.
+  */
+  void setWiFiNetworks(const wifi_cred* networks, uint8_t count);
+
+  /**
+   * Set connection attempts per round, 0-100 (0 = retry forever with backoff).
+   * begin() returns when a round fails. After start(), a failed round turns WiFi off for
+   * MQTTU_RETRY_REST before the next round, so an unreachable network does not keep the radio on.
+  */
+  bool setWifiRetry(short i);
+
+  /**
+   * Poll Mqtt connection
+  */
+  void pollMqtt();
+
+  /**
+   * Get status code
+  */
+  int16_t getStatus();
+
+  /**
+   * Get Mqtt error code
+  */
+  int16_t getMqttError();
+
+private:
+  int16_t getConnectionStatus() const;
+
+  bool publishJson(const JsonDocument& doc, const char* topic, bool retain, int8_t qos = -1);  // -1 = topicQos()
+
+  bool publishPayload(const uint8_t* payload, size_t len, const char* topic, bool retain);
+
+  #ifdef MQTTU_PACKED_STATE
+  bool publishMsgPack(const JsonDocument& doc, const char* topic, bool retain);
+  #endif
+
+  bool publishDiscovery(const JsonDocument& doc, const char* topic);
+
+  void setComponent(JsonObject obj, const mdev& device, bool withStateTopic, uint16_t expiresAfter);
+
+  void setDevice(JsonObject obj, const mdev_info& device);
+
+  #ifdef MQTTU_DISCOVERY_CACHE
+  void loadDiscoveryCache();
+
+  int findDiscoverySlot(uint32_t topicHash);
+
+  #ifdef MQTTU_DISCOVERY_VERIFY
+  uint32_t retainedHash(const char* topic);
+  #endif
+  #endif
+
+  int16_t reconnect(int status);
+
+  void connectWifi();
+
+  int8_t strongestNetwork(int32_t* rssi);
+
+  void useNetwork(uint8_t index);
+
+  void roam();
+
+  bool connectMqtt();
+
+  uint8_t topicQos(const char* topic) const;
+
+  bool endPublish();
+
+  bool retriesUsed() const;
+
+  void backoff(int16_t status);
+
+  void setState(util_conn_state state);
+
+  uint32_t nextRandom();
+
+  void subscribeCommands();
+
+  void syncTime();
+
+  #ifdef MQTTU_BACKFILL
+  bool bufferSample(const JsonDocument& doc);
+
+  bool bufferRecord(const uint8_t* data, size_t len);
+
+  void drainBackfill(uint32_t now);
+  #endif
+
+  static void onMqttMessage(int size);
+
+  #ifdef MQTTU_OTA
+  void receiveOta(int size);
+
+  void failOta(const char* error);
+
+  void serviceOta(uint32_t now);
+
+  bool publishOtaStatus(const char* state, int8_t qos = -1);
+  #endif
+
+  #ifdef MQTTU_DIAGNOSTICS
+  void publishDiagnostics();
+
+  uint32_t freeMemory() const;
+  #endif
+
+  #ifdef MQTTU_LOW_POWER
+  uint64_t uptime() const;
+
+  void cacheLease();
+  #endif
+
+  Client* _wifiClient;
+  MqttClient* _mqttClient;
+
+  const char* _ssid;
+  const char* _psk;
+  uint16_t _retry;  // Number of WiFi connection attempts [0-100], 0 = unlimited
+  const wifi_cred* _networks;  // setWiFiNetworks() list, NULL = _ssid only
+  uint8_t _networkCount;
+  uint8_t _network;        // Index of _ssid in _networks
+  bool _scanNeeded;        // Scan before the next association
+  uint32_t _lastRoam;      // monotonicMs() at last link check
+
+  const char* _host;
+  uint16_t _port;
+
+  bool _started;  // Connection engine running
+  bool _ownsMqttClient;
+
+  const char* _user;
+  const char* _pass;
+
+  int16_t _mqttErr;  // MqttClient Uses error codes -2 -> 5
+  int16_t _status;
+
+  util_conn_state _state;
+  uint32_t _stateSince;    // millis() at last state change
+  uint32_t _backoffDelay;  // ms to wait in CONN_STATE_BACKOFF
+  uint16_t _attempts;      // Failed attempts since last successful connection
+  uint32_t _rng;           // Backoff jitter PRNG state
+
+  const char* _cmdTopic;
+  util_cmd_callback _cmdCallback;
+  util_cfg_callback _cfgCallback;
+  const char* _avtyTopic;
+  bool _persistent;     // Clean session off, see setPersistentSession()
+  bool _sessionValid;   // Broker still holds the session subscriptions
+  qos_slot _qos[MQTTU_QOS_SLOTS];
+  uint8_t _qosCount;
+  static MqttUtility* _instance;  // onMessage() takes a plain function, messages are routed through this
+
+  #ifdef MQTTU_PACKED_STATE
+  const char* _packedTopic;
+  #endif
+
+  uint32_t _epoch;    // Unix time at _epochAt, 0 = unknown
+  uint32_t _epochAt;  // monotonicMs() at _epoch
+
+  #ifdef MQTTU_BACKFILL
+  uint8_t _backfillData[MQTTU_BACKFILL_SIZE];
+  SampleRing _backfill;
+  const char* _backfillTopic;
+  uint32_t _lastBackfill;
+  #endif
+
+  #ifdef MQTTU_DISCOVERY_CACHE
+  disc_slot _discSlots[MQTTU_DISCOVERY_SLOTS];
+  uint8_t _discCount;
+  bool _discLoaded;  // Slots have been read from flash
+  bool _discDirty;   // Slots changed since last save
+
+  #ifdef MQTTU_DISCOVERY_VERIFY
+  const char* _verifyTopic;
+  uint32_t _verifyHash;
+  bool _verifyDone;
+  #endif
+  #endif
+
+  #ifdef MQTTU_LOW_POWER
+  IPAddress _leaseIp;
+  IPAddress _leaseGateway;
+  IPAddress _leaseSubnet;
+  uint64_t _leaseSince;    // uptime() when the lease was cached
+  bool _leaseValid;
+  uint64_t _awakeMs;       // Awake time before _wakeSince
+  uint64_t _sleepMs;
+  uint32_t _wakeSince;     // millis() at last wake-up
+  #endif
+
+  #ifdef MQTTU_DIAGNOSTICS
+  PhaseStats _phases[PHASE_COUNT];
+  const char* _diagTopic;
+  uint32_t _lastDiag;
+  uint16_t _reconnects;  // Connection losses since boot
+  uint16_t _pubFailures; // Publishes not completed or not acknowledged since boot
+  #endif
+
+  #ifdef MQTTU_OTA
+  OtaReceiver _ota;
+  const char* _otaTopic;
+  const char* _otaStatusTopic;
+  util_ota_callback _otaCallback;
+  util_ota_state _otaEvent;  // State change for the callback, OTA_IDLE = none
+  const char* _otaError;     // Reason of the last OTA_FAILED
+  uint32_t _otaLast;         // millis() at the last OTA message
+  bool _otaAckDue;           // Status to publish from tick()
+  bool _otaApplyDue;         // Image verified, applied from tick()
+  #endif
+};
+
+ #endif // MQTT_UTIL_H
\ No newline at end of file
@@ -0,0 +1,68 @@
+/*
+  Author: Ilari Mattsson
+  Library: Mqtt Utility
+  File: mem_watermark.cpp
+*/
+
+#include "mem_watermark.h"
+
+#ifdef ARDUINO_ARCH_SAMD
+extern "C" char* sbrk(int incr);
+extern "C" char __end__;      // Heap start, from the SAMD linker script
+extern "C" char __StackTop;   // End of RAM, the stack grows down from here
+#endif
+
+bool MemWatermark::_painted = false;
+
+// ================================ Class public methods ========================================
+
+void MemWatermark::paint() {
+  #ifdef ARDUINO_ARCH_SAMD
+  char top;
+  uint32_t* word = (uint32_t*)(((uintptr_t)sbrk(0) + 3) & ~(uintptr_t)3);
+  uint32_t* limit = (uint32_t*)(&top - MEM_WATERMARK_MARGIN);
+  while (word < limit) *word++ = MEM_WATERMARK_PATTERN;
+  _painted = true;
+  #endif
+}
+
+uint32_t MemWatermark::heapPeak() {
+  #ifdef ARDUINO_ARCH_SAMD
+  return sbrk(0) - &__end__;
+  #else
+  return 0;
+  #endif
+}
+
+uint32_t MemWatermark::stackPeak() {
+  #ifdef ARDUINO_ARCH_SAMD
+  if (!_painted) return 0;
+  return &__StackTop - (char*)lowestStackWord();
+  #else
+  return 0;
+  #endif
+}
+
+uint32_t MemWatermark::headroom() {
+  #ifdef ARDUINO_ARCH_SAMD
+  if (!_painted) return 0;
+  return (char*)lowestStackWord() - sbrk(0);
+  #else
+  return 0;
+  #endif
+}
+
+// ================================ Class private methods ========================================
+
+uint32_t* MemWatermark::lowestStackWord() {
+  #ifdef ARDUINO_ARCH_SAMD
+  // Painted words above the heap end were never reached, the first overwritten one is the stack peak
+  char top;
+  uint32_t* word = (uint32_t*)(((uintptr_t)sbrk(0) + 3) & ~(uintptr_t)3);
+  uint32_t* limit = (uint32_t*)&top;
+  while (word < limit && *word == MEM_WATERMARK_PATTERN) word++;
+  return word;
+  #else
+  return NULL;
+  #endif
+}
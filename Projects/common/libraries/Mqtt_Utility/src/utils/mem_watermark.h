@@ -0,0 +1,51 @@
+/*
+  Author: Ilari Mattsson
+  Library: Mqtt Utility
+  File: mem_watermark.h
+
+  Run-time RAM watermarks for MQTTU_DIAGNOSTICS (SAMD21).
+  paint() fills the free RAM between the heap end and the stack pointer with a pattern, the deepest
+  stack use is found later as the lowest overwritten word. The heap end only grows (newlib sbrk),
+  so its current position is the heap peak:
+    MemWatermark::paint();                    // Early in setup(), done by setDiagnosticsTopic()
+    uint32_t stack = MemWatermark::stackPeak();
+  Stack buffers that are declared but never written are not seen, the peak is a lower bound.
+*/
+
+#ifndef MQTTU_MEM_WATERMARK_H
+#define MQTTU_MEM_WATERMARK_H
+
+#include <Arduino.h>
+
+#define MEM_WATERMARK_PATTERN 0xA5A5A5A5
+#define MEM_WATERMARK_MARGIN 64   // bytes below the stack pointer left unpainted, paint()'s own frame
+
+class MemWatermark {
+public:
+  /**
+   * Paint free RAM, call with a shallow stack. Painting again restarts the stack peak.
+  */
+  static void paint();
+
+  /**
+   * Bytes of heap in use at the peak, static data not included
+  */
+  static uint32_t heapPeak();
+
+  /**
+   * Bytes of stack in use at the deepest point since paint(), 0 if not painted
+  */
+  static uint32_t stackPeak();
+
+  /**
+   * Bytes never reached by the heap or the stack since paint()
+  */
+  static uint32_t headroom();
+
+private:
+  static uint32_t* lowestStackWord();
+
+  static bool _painted;
+};
+
+#endif // MQTTU_MEM_WATERMARK_H
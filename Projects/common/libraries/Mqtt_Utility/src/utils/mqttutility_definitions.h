@@ -0,0 +1,193 @@
+/*
+  Author: Ilari Mattsson
+  Library: Mqtt Utility
+  File: mqttutility_definitions.h
+*/
+
+typedef struct mqtt_device_configuration {
+  const char* device_class;
+  unsigned short expires_after;
+  const char* name;
+  const char* state_topic;
+  const char* unique_id;
+  const char* unit_of_measurement;
+  const char* value_template;
+  const char* configuration_topic;
+  const char* entity_category;  // NULL = not set, "diagnostic" | "config"
+  const char* availability_template;  // NULL = always available, else read from the availability topic
+} mdev;
+
+typedef struct mqtt_device_information {
+  const char* identifier;
+  const char* name;
+  const char* manufacturer;         // NULL = not set
+  const char* model;                // NULL = not set
+  const char* sw_version;           // NULL = not set
+  const char* state_topic;          // Shared by all components in device-based discovery
+  const char* configuration_topic;  // Device-based discovery topic
+} mdev_info;
+
+#ifdef MQTTU_STRING_MDEVS
+typedef struct mqtt_device_configuration_str {
+  String device_class;
+  unsigned short expires_after;
+  String name;
+  String state_topic;
+  String unique_id;
+  String unit_of_measurement;
+  String value_template;
+  String configuration_topic;
+} mdevs;
+#endif
+
+/* Compile-time discovery strings
+  String literals are concatenated by the preprocessor, so a `const mdev` table built with
+  these macros is placed in flash and no String is allocated on the boot path.
+
+  MQTTU_SENSOR(dev_name, node_id, name, key, dev_cla, unit, filter, exp_aft) expands to:
+    device_class        dev_cla
+    expires_after       exp_aft
+    name                dev_name " " name
+    state_topic         homeassistant/sensor/<node_id>/state
+    unique_id           <node_id><key>
+    unit_of_measurement unit (NULL = no unit)
+    value_template      {{ value_json.<key><filter> }}
+    configuration_topic homeassistant/sensor/<node_id><key>/config
+    entity_category     NULL
+    availability_template NULL
+
+  MQTTU_SENSOR_AVTY(..., source) is MQTTU_SENSOR() with availability read from the
+  availability topic: {{ value_json.<source> }}, payloads "online" / "offline".
+*/
+#define MQTTU_DISCOVERY_PREFIX "homeassistant/sensor/"
+#define MQTTU_DEVICE_PREFIX "homeassistant/device/"
+#define MQTTU_STATE_TOPIC(node_id) MQTTU_DISCOVERY_PREFIX node_id "/state"
+#define MQTTU_CONFIG_TOPIC(object_id) MQTTU_DISCOVERY_PREFIX object_id "/config"
+#define MQTTU_COMMAND_TOPIC(node_id) MQTTU_DISCOVERY_PREFIX node_id "/cmd"
+#define MQTTU_BACKFILL_TOPIC(node_id) MQTTU_DISCOVERY_PREFIX node_id "/backfill"
+#define MQTTU_PACKED_TOPIC(node_id) MQTTU_DISCOVERY_PREFIX node_id "/msgpack"
+#define MQTTU_DIAGNOSTICS_TOPIC(node_id) MQTTU_DISCOVERY_PREFIX node_id "/diag"
+#define MQTTU_AVAILABILITY_TOPIC(node_id) MQTTU_DISCOVERY_PREFIX node_id "/avty"
+#define MQTTU_OTA_TOPIC(node_id) MQTTU_DISCOVERY_PREFIX node_id "/ota"
+#define MQTTU_OTA_STATUS_TOPIC(node_id) MQTTU_DISCOVERY_PREFIX node_id "/ota/status"
+#define MQTTU_VALUE_TEMPLATE(key, filter) "{{ value_json." key filter " }}"
+#define MQTTU_SENSOR(dev_name, node_id, name, key, dev_cla, unit, filter, exp_aft) \
+  { dev_cla, exp_aft, dev_name " " name, MQTTU_STATE_TOPIC(node_id), node_id key, unit, \
+    MQTTU_VALUE_TEMPLATE(key, filter), MQTTU_CONFIG_TOPIC(node_id key), NULL, NULL }
+#define MQTTU_SENSOR_AVTY(dev_name, node_id, name, key, dev_cla, unit, filter, exp_aft, source) \
+  { dev_cla, exp_aft, dev_name " " name, MQTTU_STATE_TOPIC(node_id), node_id key, unit, \
+    MQTTU_VALUE_TEMPLATE(key, filter), MQTTU_CONFIG_TOPIC(node_id key), NULL, MQTTU_VALUE_TEMPLATE(source, "") }
+
+/* Diagnostic entities for MQTTU_DIAGNOSTICS
+  MQTTU_DIAGNOSTIC() is MQTTU_SENSOR() reading the diagnostics topic, with entity_category "diagnostic".
+  MQTTU_DIAGNOSTIC_SENSORS(dev_name, node_id, exp_aft) expands to the entries of every published value,
+  add it to the discovery table: const mdev discovery[] = { ..., MQTTU_DIAGNOSTIC_SENSORS(...) };
+  Phase entities show the average of the last diagnostics interval in us.
+*/
+#define MQTTU_DIAGNOSTIC(dev_name, node_id, name, key, dev_cla, unit, filter, exp_aft) \
+  { dev_cla, exp_aft, dev_name " " name, MQTTU_DIAGNOSTICS_TOPIC(node_id), node_id key, unit, \
+    MQTTU_VALUE_TEMPLATE(key, filter), MQTTU_CONFIG_TOPIC(node_id key), "diagnostic", NULL }
+#define MQTTU_DIAGNOSTIC_SENSORS(dev_name, node_id, exp_aft) \
+  MQTTU_DIAGNOSTIC(dev_name, node_id, "Sensor Read Time", "sens", "None", "µs", ".avg", exp_aft), \
+  MQTTU_DIAGNOSTIC(dev_name, node_id, "Serialize Time", "ser", "None", "µs", ".avg", exp_aft), \
+  MQTTU_DIAGNOSTIC(dev_name, node_id, "Connect Time", "conn", "None", "µs", ".avg", exp_aft), \
+  MQTTU_DIAGNOSTIC(dev_name, node_id, "Publish Time", "pub", "None", "µs", ".avg", exp_aft), \
+  MQTTU_DIAGNOSTIC(dev_name, node_id, "Free Memory", "heap", "None", "B", "", exp_aft), \
+  MQTTU_DIAGNOSTIC(dev_name, node_id, "Heap Peak", "hpk", "None", "B", "", exp_aft), \
+  MQTTU_DIAGNOSTIC(dev_name, node_id, "Stack Peak", "spk", "None", "B", "", exp_aft), \
+  MQTTU_DIAGNOSTIC(dev_name, node_id, "WiFi Signal", "rssi", "signal_strength", "dBm", "", exp_aft), \
+  MQTTU_DIAGNOSTIC(dev_name, node_id, "Reconnects", "rcon", "None", NULL, "", exp_aft), \
+  MQTTU_DIAGNOSTIC(dev_name, node_id, "MQTT Error", "merr", "None", NULL, "", exp_aft), \
+  MQTTU_DIAGNOSTIC(dev_name, node_id, "Failed Publishes", "pubf", "None", NULL, "", exp_aft)
+
+/* Device information for batched and device-based discovery
+  MQTTU_DEVICE(dev_name, node_id, model, sw) expands to:
+    identifier          node_id
+    name                dev_name
+    manufacturer        NULL
+    model               model
+    sw_version          sw
+    state_topic         homeassistant/sensor/<node_id>/state
+    configuration_topic homeassistant/device/<node_id>/config
+*/
+#define MQTTU_DEVICE_TOPIC(node_id) MQTTU_DEVICE_PREFIX node_id "/config"
+#define MQTTU_DEVICE(dev_name, node_id, model, sw) \
+  { node_id, dev_name, NULL, model, sw, MQTTU_STATE_TOPIC(node_id), MQTTU_DEVICE_TOPIC(node_id) }
+
+typedef enum {
+    CONN_NO_ERR = 123,
+    CONN_NO_PARAMS = 50,
+    CONN_OK = 0,
+    CONN_NO_MQTT,
+    CONN_NO_WIFI,
+    CONN_CONNECTED,
+    CONN_ERR_MQTT,
+    CONN_WIFI_TIMEOUT,
+    CONN_NOT_STARTED
+} util_conn_status;
+
+typedef enum {
+    CONN_STATE_IDLE = 0,   // Not started
+    CONN_STATE_WIFI,       // Waiting for WiFi association
+    CONN_STATE_MQTT,       // WiFi connected, connecting to MQTT broker
+    CONN_STATE_CONNECTED,  // WiFi and MQTT connected
+    CONN_STATE_BACKOFF     // Waiting before the next connection attempt
+} util_conn_state;
+
+/* WiFi credentials for MqttUtility::setWiFiNetworks(), psk NULL or "" for an open network */
+typedef struct wifi_credentials {
+  const char* ssid;
+  const char* psk;
+} wifi_cred;
+
+/* Outcome of a state publish, lets the caller decide whether a reading is retried */
+typedef enum {
+    PUB_OK = 0,    // Written to the broker, acknowledged when the topic is published at QoS 1
+    PUB_BUFFERED,  // Not published, kept in the offline buffer for backfill
+    PUB_DROPPED    // Not published and not buffered: too large, or no backfill topic
+} util_pub_result;
+
+/* Publish QoS of one topic, see MqttUtility::setTopicQos() */
+typedef struct topic_qos_slot {
+  const char* topic;
+  uint8_t qos;
+} qos_slot;
+
+/* Timed phases of a measurement cycle for MQTTU_DIAGNOSTICS */
+typedef enum {
+    PHASE_SENSOR = 0,  // Sensor reads, timed by the project
+    PHASE_SERIALIZE,   // measureJson() of published payloads
+    PHASE_CONNECT,     // Blocking MqttClient::connect()
+    PHASE_PUBLISH,     // Streaming a payload to the broker
+    PHASE_COUNT
+} util_phase;
+
+/* Discovery cache slot, FNV-1a hashes of a config topic and its last published payload */
+typedef struct discovery_cache_slot {
+  uint32_t topic;
+  uint32_t payload;
+} disc_slot;
+
+/* Firmware update progress for MQTTU_OTA, passed to the OTA callback from tick() */
+typedef enum {
+    OTA_IDLE = 0,    // No update
+    OTA_RECEIVING,   // Image announced, chunks are being written to flash
+    OTA_APPLYING,    // Image verified, the sketch is replaced and the board resets
+    OTA_FAILED       // Size, CRC, write or timeout error, the running sketch is kept
+} util_ota_state;
+
+typedef void (*util_ota_callback)(util_ota_state state);
+
+/* Command callback, called with the NUL terminated message payload */
+typedef void (*util_cmd_callback)(const char* payload, size_t length);
+
+/* MqttClient Status Codes
+  CONNECTION_REFUSED            -2
+  CONNECTION_TIMEOUT            -1
+  SUCCESS                        0
+  UNACCEPTABLE_PROTOCOL_VERSION  1
+  IDENTIFIER_REJECTED            2
+  SERVER_UNAVAILABLE             3
+  BAD_USER_NAME_OR_PASSWORD      4
+  NOT_AUTHORIZED                 5
+*/
\ No newline at end of file
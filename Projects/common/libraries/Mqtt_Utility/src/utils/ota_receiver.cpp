@@ -0,0 +1,147 @@
+/*
+  Author: Ilari Mattsson
+  Library: Mqtt Utility
+  File: ota_receiver.cpp
+*/
+
+#ifdef MQTTU_OTA
+#include "ota_receiver.h"
+
+/**
+ * Run one NVMCTRL command on the row or page at address
+*/
+static void nvmCommand(uint32_t command, uint32_t address) {
+  NVMCTRL->STATUS.reg |= NVMCTRL_STATUS_MASK;
+  NVMCTRL->ADDR.reg = address / 2;  // 16-bit word address
+  NVMCTRL->CTRLA.reg = NVMCTRL_CTRLA_CMDEX_KEY | command;
+  while (!NVMCTRL->INTFLAG.bit.READY) {}
+}
+
+/**
+ * Copy length bytes, whole pages, from src to dest and reset. Runs from RAM: it erases the sketch
+ * it was called from, so it calls nothing in flash. Interrupts must be off, the vector table goes first.
+*/
+__attribute__((long_call, noinline, section(".data#")))
+static void copyAndReset(uint32_t dest, uint32_t src, uint32_t length) {
+  for (uint32_t offset = 0; offset < length; offset += FLASH_PAGE_SIZE) {
+    if (offset % FLASH_ROW_SIZE == 0) {
+      NVMCTRL->ADDR.reg = (dest + offset) / 2;
+      NVMCTRL->CTRLA.reg = NVMCTRL_CTRLA_CMDEX_KEY | NVMCTRL_CTRLA_CMD_ER;
+      while (!NVMCTRL->INTFLAG.bit.READY) {}
+    }
+    NVMCTRL->CTRLA.reg = NVMCTRL_CTRLA_CMDEX_KEY | NVMCTRL_CTRLA_CMD_PBC;
+    while (!NVMCTRL->INTFLAG.bit.READY) {}
+    volatile uint32_t* to = (volatile uint32_t*)(uintptr_t)(dest + offset);
+    const volatile uint32_t* from = (const volatile uint32_t*)(uintptr_t)(src + offset);
+    for (uint32_t i = 0; i < FLASH_PAGE_SIZE / 4; i++) to[i] = from[i];
+    NVMCTRL->CTRLA.reg = NVMCTRL_CTRLA_CMDEX_KEY | NVMCTRL_CTRLA_CMD_WP;
+    while (!NVMCTRL->INTFLAG.bit.READY) {}
+  }
+  // NVIC_SystemReset() without a call into flash
+  __asm volatile ("dsb");
+  SCB->AIRCR = (0x5FAUL << SCB_AIRCR_VECTKEY_Pos) | SCB_AIRCR_SYSRESETREQ_Msk;
+  while (true) {}
+}
+
+
+OtaReceiver::OtaReceiver():
+  _size(0),
+  _expected(0),
+  _offset(0),
+  _written(0),
+  _active(false) {
+}
+
+// ================================ Class public methods ========================================
+
+bool OtaReceiver::begin(uint32_t size, uint32_t crc) {
+  abort();
+  if (size == 0 || size > flashAreaSize()) return false;
+  // The staging area starts where the sketch area ends, a larger sketch would overwrite itself
+  if (flashImageEnd() > flashStagingStart()) return false;
+  _size = size;
+  _expected = crc;
+  _offset = 0;
+  _written = 0;
+  _active = true;
+  return true;
+}
+
+bool OtaReceiver::write(const uint8_t* data, size_t len) {
+  if (!_active) return false;
+  if (_offset + len > _size) {
+    abort();
+    return false;
+  }
+  uint8_t* page = (uint8_t*)_page;
+  while (len > 0) {
+    size_t fill = _offset - _written;
+    size_t n = FLASH_PAGE_SIZE - fill < len ? FLASH_PAGE_SIZE - fill : len;
+    memcpy(page + fill, data, n);
+    _offset += n;
+    data += n;
+    len -= n;
+    if (_offset - _written == FLASH_PAGE_SIZE) writePage();
+  }
+  return true;
+}
+
+bool OtaReceiver::verify() {
+  if (!_active) return false;
+  _active = false;
+  if (_offset != _size) return false;
+  size_t fill = _offset - _written;
+  if (fill > 0) {
+    memset((uint8_t*)_page + fill, 0xFF, FLASH_PAGE_SIZE - fill);
+    writePage();
+  }
+  // Read back from flash, covers the transfer and the page writes
+  return crc32(0, (const uint8_t*)(uintptr_t)flashStagingStart(), _size) == _expected;
+}
+
+void OtaReceiver::apply() {
+  uint32_t length = (_size + FLASH_PAGE_SIZE - 1) / FLASH_PAGE_SIZE * FLASH_PAGE_SIZE;
+  noInterrupts();
+  copyAndReset(flashSketchStart(), flashStagingStart(), length);
+}
+
+void OtaReceiver::abort() {
+  // Staged pages are left as they are, the next image erases rows as it reaches them
+  _active = false;
+}
+
+bool OtaReceiver::isActive() const {
+  return _active;
+}
+
+uint32_t OtaReceiver::getOffset() const {
+  return _offset;
+}
+
+uint32_t OtaReceiver::getSize() const {
+  return _size;
+}
+
+uint32_t OtaReceiver::crc32(uint32_t crc, const uint8_t* data, size_t len) {
+  // Bitwise, no 1 kB table in flash. ~100 kB images take a few ms per chunk at 48 MHz
+  crc = ~crc;
+  for (size_t i = 0; i < len; i++) {
+    crc ^= data[i];
+    for (uint8_t bit = 0; bit < 8; bit++) crc = (crc >> 1) ^ (0xEDB88320 & (0 - (crc & 1)));
+  }
+  return ~crc;
+}
+
+// ================================ Class private methods ========================================
+
+void OtaReceiver::writePage() {
+  uint32_t address = flashStagingStart() + _written;
+  if (_written % FLASH_ROW_SIZE == 0) nvmCommand(NVMCTRL_CTRLA_CMD_ER, address);
+  NVMCTRL->CTRLB.bit.MANW = 1;  // The page is written by the WP command, not by the last word
+  nvmCommand(NVMCTRL_CTRLA_CMD_PBC, address);
+  volatile uint32_t* flash = (volatile uint32_t*)(uintptr_t)address;
+  for (size_t i = 0; i < FLASH_PAGE_SIZE / 4; i++) flash[i] = _page[i];
+  nvmCommand(NVMCTRL_CTRLA_CMD_WP, address);
+  _written += FLASH_PAGE_SIZE;
+}
+#endif
@@ -0,0 +1,75 @@
+/*
+  Author: Ilari Mattsson
+  Library: Mqtt Utility
+  File: ota_receiver.h
+
+  Streaming firmware receiver for MQTTU_OTA (SAMD21, flash map in Flash_Layout.h).
+  Chunks are written page by page into the staging area above the sketch, the image is never held
+  in RAM. verify() reads the staged image back and checks its CRC-32 (zlib). apply() copies it over
+  the running sketch from a RAM function and resets. The SAM-BA bootloader and the record rows at the
+  top of flash are not touched, so calibration, node settings and the discovery cache are kept:
+    if (!ota.begin(size, crc)) ...;      // Image or running sketch larger than flashAreaSize()
+    ota.write(data, len);                // In order, any chunk length
+    if (ota.verify()) ota.apply();       // Does not return
+  The running sketch must fit in the sketch area, see size_reports/ for the flash budget.
+*/
+
+#ifndef MQTTU_OTA_RECEIVER_H
+#define MQTTU_OTA_RECEIVER_H
+
+#include <Arduino.h>
+#include <Flash_Layout.h>
+
+class OtaReceiver {
+public:
+  OtaReceiver();
+
+  /**
+   * Start a new image, an unfinished one is discarded
+   * returns: bool: false if size is 0, the image does not fit in the staging area, or the running
+   *   sketch reaches into it
+  */
+  bool begin(uint32_t size, uint32_t crc);
+
+  /**
+   * Append bytes at getOffset()
+   * returns: bool: false if not started or past the announced size, the image is aborted
+  */
+  bool write(const uint8_t* data, size_t len);
+
+  /**
+   * Write the last page and check the staged image
+   * returns: bool: true if every byte was received and the CRC of the flash copy matches
+  */
+  bool verify();
+
+  /**
+   * Copy the image over the sketch and reset. Call only after verify()
+  */
+  void apply();
+
+  void abort();
+
+  bool isActive() const;
+
+  uint32_t getOffset() const;
+
+  uint32_t getSize() const;
+
+  /**
+   * CRC-32 as zlib.crc32(), start with crc = 0
+  */
+  static uint32_t crc32(uint32_t crc, const uint8_t* data, size_t len);
+
+private:
+  void writePage();
+
+  uint32_t _size;
+  uint32_t _expected;  // CRC from begin()
+  uint32_t _offset;    // Bytes received
+  uint32_t _written;   // Bytes written to flash, whole pages
+  bool _active;
+  uint32_t _page[FLASH_PAGE_SIZE / 4];  // Page buffer, NVMCTRL takes 32-bit writes
+};
+
+#endif // MQTTU_OTA_RECEIVER_H
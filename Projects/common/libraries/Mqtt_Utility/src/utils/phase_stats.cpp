@@ -0,0 +1,54 @@
+/*
+  Author: Ilari Mattsson
+  Library: Mqtt Utility
+  File: phase_stats.cpp
+*/
+
+#include "phase_stats.h"
+
+
+PhaseStats::PhaseStats() {
+  reset();
+}
+
+// ================================ Class public methods ========================================
+
+void PhaseStats::add(uint32_t us) {
+  if (_count == 0 || us < _min) _min = us;
+  if (us > _max) _max = us;
+  _total += us;
+  _count++;
+}
+
+void PhaseStats::reset() {
+  _count = 0;
+  _min = 0;
+  _max = 0;
+  _total = 0;
+}
+
+uint32_t PhaseStats::getCount() const {
+  return _count;
+}
+
+uint32_t PhaseStats::getMin() const {
+  return _min;
+}
+
+uint32_t PhaseStats::getMax() const {
+  return _max;
+}
+
+uint32_t PhaseStats::getAvg() const {
+  return _count > 0 ? (uint32_t)(_total / _count) : 0;
+}
+
+
+PhaseTimer::PhaseTimer(PhaseStats& stats):
+  _stats(stats),
+  _start(micros()) {
+}
+
+PhaseTimer::~PhaseTimer() {
+  _stats.add(micros() - _start);
+}
@@ -0,0 +1,52 @@
+/*
+  Author: Ilari Mattsson
+  Library: Mqtt Utility
+  File: phase_stats.h
+
+  micros() based timing statistics for MQTTU_DIAGNOSTICS.
+  A PhaseTimer adds the time from its construction to the end of its scope to a PhaseStats:
+    { PhaseTimer timer(mqttUtility.getPhase(PHASE_SENSOR)); measureData(); }
+*/
+
+#ifndef MQTTU_PHASE_STATS_H
+#define MQTTU_PHASE_STATS_H
+
+#include <Arduino.h>
+
+class PhaseStats {
+public:
+  PhaseStats();
+
+  /**
+   * Add one measurement, us
+  */
+  void add(uint32_t us);
+
+  void reset();
+
+  uint32_t getCount() const;
+
+  uint32_t getMin() const;
+
+  uint32_t getMax() const;
+
+  uint32_t getAvg() const;
+
+private:
+  uint32_t _count;
+  uint32_t _min;
+  uint32_t _max;
+  uint64_t _total;
+};
+
+class PhaseTimer {
+public:
+  PhaseTimer(PhaseStats& stats);
+  ~PhaseTimer();
+
+private:
+  PhaseStats& _stats;
+  uint32_t _start;  // micros() at construction, wraps after ~71 min
+};
+
+#endif // MQTTU_PHASE_STATS_H
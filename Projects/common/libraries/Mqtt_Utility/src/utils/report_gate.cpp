@@ -0,0 +1,128 @@
+/*
+  Author: Ilari Mattsson
+  Library: Mqtt Utility
+  File: report_gate.cpp
+*/
+
+#include "report_gate.h"
+
+
+RollingStats::RollingStats() {
+  reset();
+}
+
+// ================================ Class public methods ========================================
+
+void RollingStats::add(float value) {
+  if (isnan(value)) return;
+  if (_count == 0 || value < _min) _min = value;
+  if (_count == 0 || value > _max) _max = value;
+  _sum += value;
+  if (_count < UINT16_MAX) _count++;
+}
+
+void RollingStats::reset() {
+  _count = 0;
+  _min = 0;
+  _max = 0;
+  _sum = 0;
+}
+
+uint16_t RollingStats::getCount() const {
+  return _count;
+}
+
+float RollingStats::getMin() const {
+  return _min;
+}
+
+float RollingStats::getMax() const {
+  return _max;
+}
+
+float RollingStats::getMean() const {
+  return _count > 0 ? _sum / _count : 0;
+}
+
+
+ReportGate::ReportGate(uint32_t heartbeat):
+  _count(0),
+  _heartbeat(heartbeat),
+  _reportedAt(0),
+  _hasReported(false),
+  _triggered(false) {
+}
+
+// ================================ Class public methods ========================================
+
+int8_t ReportGate::addChannel(const char* key, float deadband, bool withStats) {
+  if (_count >= REPORT_GATE_CHANNELS) return -1;
+  rep_channel& channel = _channels[_count];
+  channel.key = key;
+  channel.deadband = deadband;
+  channel.last = 0;
+  channel.reported = 0;
+  channel.hasReported = false;
+  channel.withStats = withStats;
+  channel.stats.reset();
+  return _count++;
+}
+
+void ReportGate::update(int8_t channel, float value) {
+  if (channel < 0 || channel >= _count || isnan(value)) return;
+  rep_channel& ch = _channels[channel];
+  ch.last = value;
+  ch.stats.add(value);
+  if (ch.hasReported && ch.deadband > 0 && fabsf(value - ch.reported) >= ch.deadband) _triggered = true;
+}
+
+bool ReportGate::set(const char* key, float value, uint8_t decimals) {
+  for (uint8_t i = 0; i < _count; i++) {
+    if (strcmp(_channels[i].key, key) != 0) continue;
+    update(i, value);
+    return true;
+  }
+  return false;
+}
+
+bool ReportGate::isDue(uint32_t now) const {
+  return !_hasReported || _triggered || now - _reportedAt >= _heartbeat;
+}
+
+bool ReportGate::isTriggered() const {
+  return _triggered;
+}
+
+void ReportGate::addStats(StateFrame& frame) const {
+  for (uint8_t i = 0; i < _count; i++) {
+    const RollingStats& s = _channels[i].stats;
+    if (!_channels[i].withStats || s.getCount() == 0) continue;
+    frame.setStats(_channels[i].key, s.getMin(), s.getMean(), s.getMax());
+  }
+}
+
+void ReportGate::markReported(uint32_t now) {
+  for (uint8_t i = 0; i < _count; i++) {
+    rep_channel& ch = _channels[i];
+    if (ch.stats.getCount() == 0) continue;
+    ch.reported = ch.last;
+    ch.hasReported = true;
+    ch.stats.reset();
+  }
+  _reportedAt = now;
+  _hasReported = true;
+  _triggered = false;
+}
+
+void ReportGate::setHeartbeat(uint32_t heartbeat) {
+  _heartbeat = heartbeat;
+}
+
+uint32_t ReportGate::getHeartbeat() const {
+  return _heartbeat;
+}
+
+void ReportGate::setDeadband(int8_t channel, float deadband) {
+  if (channel < 0 || channel >= _count) return;
+  _channels[channel].deadband = deadband;
+}
@@ -0,0 +1,123 @@
+/*
+  Author: Ilari Mattsson
+  Library: Mqtt Utility
+  File: report_gate.h
+
+  Change-based reporting. Sensors are sampled more often than they are published, each sample is
+  added to a channel. A report is due when a channel moved more than its deadband from the value
+  in the last report, or when the heartbeat has elapsed. Channels keep min/max/mean of the samples
+  since the last report in constant memory:
+    temp = gate.addChannel("temp", 0.5);
+    gate.update(temp, temperature);
+    if (gate.isDue(now)) { gate.addStats(frame); publish(frame); gate.markReported(now); }
+*/
+
+#ifndef MQTTU_REPORT_GATE_H
+#define MQTTU_REPORT_GATE_H
+
+#include <Arduino.h>
+#include "state_frame.h"
+
+#ifndef REPORT_GATE_CHANNELS
+#define REPORT_GATE_CHANNELS 10  // Channels per gate
+#endif
+
+class RollingStats {
+public:
+  RollingStats();
+
+  void add(float value);
+
+  void reset();
+
+  uint16_t getCount() const;
+
+  float getMin() const;
+
+  float getMax() const;
+
+  float getMean() const;
+
+private:
+  uint16_t _count;
+  float _min;
+  float _max;
+  float _sum;
+};
+
+class ReportGate {
+public:
+  /**
+   * params: uint32_t heartbeat: ms, longest time between reports when nothing changes
+  */
+  ReportGate(uint32_t heartbeat);
+
+  /**
+   * Add a channel
+   * params:
+   *   const char* key: state payload key, used for the stats object. Not copied.
+   *   float deadband: report when the value moves at least this much from the last report, 0 = heartbeat only
+   *   bool withStats: include the channel in addStats(), leave out to keep payloads short
+   * returns: int8_t: channel index, -1 if all REPORT_GATE_CHANNELS are in use
+  */
+  int8_t addChannel(const char* key, float deadband, bool withStats = true);
+
+  /**
+   * Add a sample to a channel, triggers a report if it crosses the deadband
+  */
+  void update(int8_t channel, float value);
+
+  /**
+   * Add a sample to the channel of key, unknown keys are ignored.
+   * Same signature as StateFrame::set() so sensor policies can emit into either.
+   * returns: bool: false if no channel has key
+  */
+  bool set(const char* key, float value, uint8_t decimals = 2);
+
+  /**
+   * True if a channel crossed its deadband, the heartbeat has elapsed or nothing has been reported yet
+   * params: uint32_t now: ms, same clock as markReported()
+  */
+  bool isDue(uint32_t now) const;
+
+  /**
+   * True if a deadband crossing is waiting to be reported
+  */
+  bool isTriggered() const;
+
+  /**
+   * Add "stats": { key: [min, mean, max] } for the channels that have samples
+  */
+  void addStats(StateFrame& frame) const;
+
+  /**
+   * Store the reported values and start new statistics
+  */
+  void markReported(uint32_t now);
+
+  void setHeartbeat(uint32_t heartbeat);
+
+  uint32_t getHeartbeat() const;
+
+  void setDeadband(int8_t channel, float deadband);
+
+private:
+  typedef struct report_channel {
+    const char* key;
+    float deadband;
+    float last;      // Latest sample
+    float reported;  // Value in the last report
+    bool hasReported;
+    bool withStats;
+    RollingStats stats;
+  } rep_channel;
+
+  rep_channel _channels[REPORT_GATE_CHANNELS];
+  uint8_t _count;
+  uint32_t _heartbeat;
+  uint32_t _reportedAt;
+  bool _hasReported;
+  bool _triggered;
+};
+
+#endif // MQTTU_REPORT_GATE_H
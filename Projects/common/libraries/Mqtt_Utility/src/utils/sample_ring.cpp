@@ -0,0 +1,82 @@
+/*
+  Author: Ilari Mattsson
+  Library: Mqtt Utility
+  File: sample_ring.cpp
+*/
+
+#include "sample_ring.h"
+
+
+SampleRing::SampleRing(uint8_t* buffer, size_t size):
+  _buffer(buffer),
+  _size(size),
+  _head(0),
+  _used(0),
+  _count(0) {
+}
+
+// ================================ Class public methods ========================================
+
+bool SampleRing::push(uint32_t time, const uint8_t* data, uint8_t length) {
+  size_t needed = SAMPLE_RING_HEADER + length;
+  if (needed > _size) return false;
+  while (_size - _used < needed) pop(1);
+
+  uint8_t header[SAMPLE_RING_HEADER] = { length, (uint8_t)time, (uint8_t)(time >> 8), (uint8_t)(time >> 16), (uint8_t)(time >> 24) };
+  size_t tail = (_head + _used) % _size;
+  copyIn(tail, header, SAMPLE_RING_HEADER);
+  copyIn((tail + SAMPLE_RING_HEADER) % _size, data, length);
+  _used += needed;
+  _count++;
+  return true;
+}
+
+bool SampleRing::read(uint16_t index, uint32_t* time, uint8_t* data, uint8_t* length) const {
+  if (index >= _count) return false;
+
+  size_t pos = _head;
+  uint8_t header[SAMPLE_RING_HEADER];
+  for (uint16_t i = 0; i <= index; i++) {
+    copyOut(pos, header, SAMPLE_RING_HEADER);
+    if (i < index) pos = (pos + SAMPLE_RING_HEADER + header[0]) % _size;
+  }
+
+  *length = header[0];
+  *time = (uint32_t)header[1] | ((uint32_t)header[2] << 8) | ((uint32_t)header[3] << 16) | ((uint32_t)header[4] << 24);
+  copyOut((pos + SAMPLE_RING_HEADER) % _size, data, header[0]);
+  return true;
+}
+
+void SampleRing::pop(uint16_t count) {
+  while (count-- > 0 && _count > 0) {
+    uint8_t length;
+    copyOut(_head, &length, 1);
+    _head = (_head + SAMPLE_RING_HEADER + length) % _size;
+    _used -= SAMPLE_RING_HEADER + length;
+    _count--;
+  }
+  if (_count == 0) _head = _used = 0;
+}
+
+uint16_t SampleRing::count() const {
+  return _count;
+}
+
+void SampleRing::clear() {
+  _head = _used = 0;
+  _count = 0;
+}
+
+// ================================ Class private methods ========================================
+
+void SampleRing::copyOut(size_t pos, uint8_t* dst, size_t len) const {
+  size_t first = _size - pos < len ? _size - pos : len;
+  memcpy(dst, _buffer + pos, first);
+  memcpy(dst + first, _buffer, len - first);
+}
+
+void SampleRing::copyIn(size_t pos, const uint8_t* src, size_t len) {
+  size_t first = _size - pos < len ? _size - pos : len;
+  memcpy(_buffer + pos, src, first);
+  memcpy(_buffer, src + first, len - first);
+}
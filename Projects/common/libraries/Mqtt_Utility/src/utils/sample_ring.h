@@ -0,0 +1,55 @@
+/*
+  Author: Ilari Mattsson
+  Library: Mqtt Utility
+  File: sample_ring.h
+
+  Fixed-size byte ring buffer of timestamped binary records.
+  Record layout: [length: 1 byte][time: 4 bytes][payload: length bytes]
+  The oldest records are dropped when a new record does not fit.
+*/
+
+#ifndef MQTTU_SAMPLE_RING_H
+#define MQTTU_SAMPLE_RING_H
+
+#include <Arduino.h>
+
+#define SAMPLE_RING_HEADER 5
+
+class SampleRing {
+public:
+  SampleRing(uint8_t* buffer, size_t size);
+
+  /**
+   * Append a record, drops oldest records to make room.
+   * returns: bool: false if the record can never fit
+  */
+  bool push(uint32_t time, const uint8_t* data, uint8_t length);
+
+  /**
+   * Read the index:th oldest record without removing it. data must hold 255 bytes.
+   * returns: bool: false if there is no such record
+  */
+  bool read(uint16_t index, uint32_t* time, uint8_t* data, uint8_t* length) const;
+
+  /**
+   * Remove count oldest records
+  */
+  void pop(uint16_t count);
+
+  uint16_t count() const;
+
+  void clear();
+
+private:
+  void copyOut(size_t pos, uint8_t* dst, size_t len) const;
+
+  void copyIn(size_t pos, const uint8_t* src, size_t len);
+
+  uint8_t* _buffer;
+  size_t _size;
+  size_t _head;    // Oldest record
+  size_t _used;    // Bytes in use
+  uint16_t _count;
+};
+
+#endif // MQTTU_SAMPLE_RING_H
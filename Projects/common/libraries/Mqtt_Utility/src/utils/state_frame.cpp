@@ -0,0 +1,268 @@
+/*
+  Author: Ilari Mattsson
+  Library: Mqtt Utility
+  File: state_frame.cpp
+*/
+
+#include "state_frame.h"
+
+/**
+ * Bounded byte sink for JSON text and MessagePack, length() is 0 after an overflow
+*/
+class FrameWriter : public Print {
+public:
+  FrameWriter(uint8_t* buffer, size_t size):
+    _buffer(buffer),
+    _size(size),
+    _len(0),
+    _overflowed(false) {
+  }
+
+  using Print::write;
+
+  size_t write(uint8_t c) override {
+    if (_len >= _size) {
+      _overflowed = true;
+      return 0;
+    }
+    _buffer[_len++] = c;
+    return 1;
+  }
+
+  size_t length() const {
+    return _overflowed ? 0 : _len;
+  }
+
+  void jsonKey(const char* key) {
+    write('"');
+    print(key);
+    print("\":");
+  }
+
+  void jsonNumber(float value, uint8_t decimals) {
+    if (isnan(value) || isinf(value)) print("null");
+    else print(value, decimals);
+  }
+
+  void jsonFixed(int32_t value, uint8_t decimals) {
+    uint32_t magnitude = value < 0 ? -(uint32_t)value : (uint32_t)value;
+    if (value < 0) write('-');
+    uint32_t divisor = 1;
+    for (uint8_t i = 0; i < decimals; i++) divisor *= 10;
+    print(magnitude / divisor);
+    if (decimals == 0) return;
+    write('.');
+    uint32_t fraction = magnitude % divisor;
+    for (uint32_t digit = divisor / 10; digit > 0; digit /= 10) {
+      write('0' + fraction / digit);
+      fraction %= digit;
+    }
+  }
+
+  void packKey(const char* key) {
+    size_t len = strlen(key);
+    if (len < 32) write(0xa0 | len);
+    else {
+      write(0xd9);
+      write(len);
+    }
+    write((const uint8_t*)key, len);
+  }
+
+  void packMap(uint8_t count) {
+    if (count < 16) write(0x80 | count);
+    else {
+      write(0xde);
+      packBigEndian(count, 2);
+    }
+  }
+
+  void packNumber(float value, uint8_t decimals) {
+    if (isnan(value) || isinf(value)) {
+      write(0xc0);  // nil
+      return;
+    }
+    // Integer fields are packed as integers, the same as ArduinoJson does for integer values
+    if (decimals == 0) {
+      packInt(lroundf(value));
+      return;
+    }
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    write(0xca);
+    packBigEndian(bits, 4);
+  }
+
+  void packInt(int32_t number) {
+    if (number >= -32 && number < 128) write((uint8_t)number);  // positive or negative fixint
+    else {
+      write(0xd2);
+      packBigEndian((uint32_t)number, 4);
+    }
+  }
+
+private:
+  void packBigEndian(uint32_t value, uint8_t bytes) {
+    while (bytes-- > 0) write((uint8_t)(value >> (8 * bytes)));
+  }
+
+  uint8_t* _buffer;
+  size_t _size;
+  size_t _len;
+  bool _overflowed;
+};
+
+
+StateFrame::StateFrame():
+  _count(0) {
+}
+
+// ================================ Class public methods ========================================
+
+void StateFrame::clear() {
+  _count = 0;
+}
+
+bool StateFrame::set(const char* key, float value, uint8_t decimals) {
+  st_field* field = find(key);
+  if (field == NULL) return false;
+  field->value = value;
+  field->decimals = decimals;
+  field->hasValue = true;
+  field->isFixed = false;
+  return true;
+}
+
+bool StateFrame::setFixed(const char* key, int32_t value, uint8_t decimals) {
+  static const float scales[] = { 1.0f, 0.1f, 0.01f, 0.001f, 0.0001f };
+  if (decimals > 4) decimals = 4;
+  st_field* field = find(key);
+  if (field == NULL) return false;
+  field->fixed = value;
+  field->value = value * scales[decimals];  // For MessagePack, one multiply instead of a division
+  field->decimals = decimals;
+  field->hasValue = true;
+  field->isFixed = true;
+  return true;
+}
+
+bool StateFrame::setStats(const char* key, float min, float mean, float max) {
+  st_field* field = find(key);
+  if (field == NULL) return false;
+  field->min = min;
+  field->mean = mean;
+  field->max = max;
+  field->hasStats = true;
+  return true;
+}
+
+uint8_t StateFrame::size() const {
+  uint8_t count = 0;
+  bool hasStats = false;
+  for (uint8_t i = 0; i < _count; i++) {
+    if (_fields[i].hasValue) count++;
+    if (_fields[i].hasStats) hasStats = true;
+  }
+  return hasStats ? count + 1 : count;
+}
+
+size_t StateFrame::render() {
+  FrameWriter out(_payload, sizeof(_payload));
+  bool first = true;
+
+  out.write('{');
+  for (uint8_t i = 0; i < _count; i++) {
+    const st_field& field = _fields[i];
+    if (!field.hasValue) continue;
+    if (!first) out.write(',');
+    first = false;
+    out.jsonKey(field.key);
+    if (field.isFixed) out.jsonFixed(field.fixed, field.decimals);
+    else out.jsonNumber(field.value, field.decimals);
+  }
+
+  bool firstStats = true;
+  for (uint8_t i = 0; i < _count; i++) {
+    const st_field& field = _fields[i];
+    if (!field.hasStats) continue;
+    if (firstStats) {
+      if (!first) out.write(',');
+      out.jsonKey("stats");
+      out.write('{');
+      firstStats = false;
+    } else out.write(',');
+    uint8_t decimals = statsDecimals(field);
+    out.jsonKey(field.key);
+    out.write('[');
+    out.jsonNumber(field.min, decimals);
+    out.write(',');
+    out.jsonNumber(field.mean, decimals);
+    out.write(',');
+    out.jsonNumber(field.max, decimals);
+    out.write(']');
+  }
+  if (!firstStats) out.write('}');
+  out.write('}');
+  return out.length();
+}
+
+const uint8_t* StateFrame::getPayload() const {
+  return _payload;
+}
+
+size_t StateFrame::pack(uint8_t* buffer, size_t length) const {
+  FrameWriter out(buffer, length);
+  uint8_t statsCount = 0;
+  for (uint8_t i = 0; i < _count; i++) {
+    if (_fields[i].hasStats) statsCount++;
+  }
+
+  out.packMap(size());
+  for (uint8_t i = 0; i < _count; i++) {
+    const st_field& field = _fields[i];
+    if (!field.hasValue) continue;
+    out.packKey(field.key);
+    if (field.isFixed && field.decimals == 0) out.packInt(field.fixed);
+    else out.packNumber(field.value, field.decimals);
+  }
+
+  if (statsCount > 0) {
+    out.packKey("stats");
+    out.packMap(statsCount);
+    for (uint8_t i = 0; i < _count; i++) {
+      const st_field& field = _fields[i];
+      if (!field.hasStats) continue;
+      uint8_t decimals = statsDecimals(field);
+      out.packKey(field.key);
+      out.write(0x93);  // fixarray of 3
+      out.packNumber(field.min, decimals);
+      out.packNumber(field.mean, decimals);
+      out.packNumber(field.max, decimals);
+    }
+  }
+  return out.length();
+}
+
+// ================================ Class private methods ========================================
+
+uint8_t StateFrame::statsDecimals(const st_field& field) {
+  // Mean of an integer field is not an integer
+  return field.decimals > 0 ? field.decimals : 1;
+}
+
+StateFrame::st_field* StateFrame::find(const char* key) {
+  for (uint8_t i = 0; i < _count; i++) {
+    if (strcmp(_fields[i].key, key) == 0) return &_fields[i];
+  }
+  if (_count >= STATE_FRAME_FIELDS) return NULL;
+
+  // Stats can be set before the value, or without one when a sensor is unavailable
+  st_field& field = _fields[_count++];
+  field.key = key;
+  field.value = 0;
+  field.decimals = 2;
+  field.hasValue = false;
+  field.hasStats = false;
+  field.isFixed = false;
+  return &field;
+}
@@ -0,0 +1,109 @@
+/*
+  Author: Ilari Mattsson
+  Library: Mqtt Utility
+  File: state_frame.h
+
+  Fixed-size state payload. The project sets typed numeric fields in a statically allocated frame,
+  MqttUtility::sendFrame() renders it once into the frame's own buffer and writes that buffer to the
+  socket. No JsonDocument, heap or serialization buffer is handled in the project:
+    frame.clear();
+    frame.set("temp", temperature);
+    frame.set("mst1", moisture, 0);
+    frame.setFixed("smst1", tenths, 1);  // 435 -> 43.5, rendered with integer math
+    gate.addStats(frame);
+    mqttUtility.sendFrame(frame, stateTopic);
+  Keys are not copied or escaped, use string literals or other static strings.
+*/
+
+#ifndef MQTTU_STATE_FRAME_H
+#define MQTTU_STATE_FRAME_H
+
+#include <Arduino.h>
+
+#ifndef STATE_FRAME_FIELDS
+#define STATE_FRAME_FIELDS 12    // Fields per frame, stats share the field of their key
+#endif
+#ifndef STATE_FRAME_SIZE
+#define STATE_FRAME_SIZE 384     // Bytes for the rendered JSON payload
+#endif
+
+class StateFrame {
+public:
+  StateFrame();
+
+  /**
+   * Remove all fields and stats, call before filling the frame for a new report
+  */
+  void clear();
+
+  /**
+   * Set a field, an existing key is overwritten
+   * params:
+   *   const char* key: payload key. Not copied.
+   *   float value: NaN is written as null
+   *   uint8_t decimals: digits after the decimal point, 0 = integer
+   * returns: bool: false if all STATE_FRAME_FIELDS are in use
+  */
+  bool set(const char* key, float value, uint8_t decimals = 2);
+
+  /**
+   * Set a fixed-point field, rendered without float formatting. An existing key is overwritten
+   * params:
+   *   int32_t value: field value * 10^decimals, e.g. 435 with 1 decimal for 43.5
+   *   uint8_t decimals: 0..4
+   * returns: bool: false if all STATE_FRAME_FIELDS are in use
+  */
+  bool setFixed(const char* key, int32_t value, uint8_t decimals);
+
+  /**
+   * Add "stats": { key: [min, mean, max] }, with the decimals of the key's field and at least one
+   * returns: bool: false if all STATE_FRAME_FIELDS are in use
+  */
+  bool setStats(const char* key, float min, float mean, float max);
+
+  /**
+   * Number of keys at the top level of the payload
+  */
+  uint8_t size() const;
+
+  /**
+   * Render the frame as JSON into the frame buffer
+   * returns: size_t: payload length, 0 if it does not fit in STATE_FRAME_SIZE
+  */
+  size_t render();
+
+  /**
+   * Payload from the last render()
+  */
+  const uint8_t* getPayload() const;
+
+  /**
+   * Encode the frame as MessagePack, same key/value map as the JSON payload
+   * returns: size_t: bytes written to buffer, 0 if it does not fit in length
+  */
+  size_t pack(uint8_t* buffer, size_t length) const;
+
+private:
+  typedef struct state_field {
+    const char* key;
+    float value;
+    int32_t fixed;   // value * 10^decimals when isFixed
+    float min;
+    float mean;
+    float max;
+    uint8_t decimals;
+    bool hasValue;
+    bool hasStats;
+    bool isFixed;
+  } st_field;
+
+  st_field* find(const char* key);
+
+  static uint8_t statsDecimals(const st_field& field);
+
+  st_field _fields[STATE_FRAME_FIELDS];
+  uint8_t _count;
+  uint8_t _payload[STATE_FRAME_SIZE];
+};
+
+#endif // MQTTU_STATE_FRAME_H
@@ -0,0 +1,63 @@
+/*
+  Author: Ilari Mattsson
+  Library: Mqtt Utility
+  File: static_pool.cpp
+*/
+
+#include "static_pool.h"
+
+// Block header holds the block size, blocks stay word aligned
+#define STATIC_POOL_HEADER sizeof(size_t)
+#define STATIC_POOL_ALIGN(n) (((n) + sizeof(size_t) - 1) & ~(sizeof(size_t) - 1))
+
+
+StaticPool::StaticPool(uint8_t* buffer, size_t size):
+  _buffer(buffer),
+  _size(size),
+  _used(0),
+  _last(size) {
+}
+
+// ================================ Class public methods ========================================
+
+void* StaticPool::allocate(size_t size) {
+  size_t start = STATIC_POOL_ALIGN(_used);
+  size_t needed = STATIC_POOL_HEADER + STATIC_POOL_ALIGN(size);
+  if (start > _size || _size - start < needed) return NULL;
+
+  memcpy(_buffer + start, &size, STATIC_POOL_HEADER);
+  _last = start;
+  _used = start + needed;
+  return _buffer + start + STATIC_POOL_HEADER;
+}
+
+void StaticPool::deallocate(void* ptr) {
+  if (ptr == NULL || _last == _size || ptr != _buffer + _last + STATIC_POOL_HEADER) return;
+  _used = _last;
+  _last = _size;
+}
+
+void* StaticPool::reallocate(void* ptr, size_t newSize) {
+  if (ptr == NULL) return allocate(newSize);
+
+  size_t oldSize;
+  memcpy(&oldSize, (uint8_t*)ptr - STATIC_POOL_HEADER, STATIC_POOL_HEADER);
+
+  // The last block is resized in place, shrinking always succeeds
+  if (_last != _size && ptr == _buffer + _last + STATIC_POOL_HEADER) {
+    size_t needed = STATIC_POOL_HEADER + STATIC_POOL_ALIGN(newSize);
+    if (_size - _last < needed) return NULL;
+    memcpy(_buffer + _last, &newSize, STATIC_POOL_HEADER);
+    _used = _last + needed;
+    return ptr;
+  }
+
+  if (newSize <= oldSize) return ptr;
+  void* moved = allocate(newSize);
+  if (moved != NULL) memcpy(moved, ptr, oldSize);
+  return moved;
+}
+
+size_t StaticPool::getUsed() const {
+  return _used;
+}
@@ -0,0 +1,43 @@
+/*
+  Author: Ilari Mattsson
+  Library: Mqtt Utility
+  File: static_pool.h
+
+  ArduinoJson allocator over a caller-owned buffer, JsonDocument memory never comes from the heap.
+  Blocks are taken from the front of the buffer. Only the last block can grow in place or be
+  released, other blocks are freed when the pool goes out of scope:
+    uint8_t buffer[512];
+    StaticPool pool(buffer, sizeof(buffer));
+    JsonDocument doc(&pool);
+  Allocation fails (doc.overflowed()) when the buffer is full.
+*/
+
+#ifndef MQTTU_STATIC_POOL_H
+#define MQTTU_STATIC_POOL_H
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+
+class StaticPool : public ArduinoJson::Allocator {
+public:
+  StaticPool(uint8_t* buffer, size_t size);
+
+  void* allocate(size_t size) override;
+
+  void deallocate(void* ptr) override;
+
+  void* reallocate(void* ptr, size_t newSize) override;
+
+  /**
+   * Bytes in use, including block headers
+  */
+  size_t getUsed() const;
+
+private:
+  uint8_t* _buffer;
+  size_t _size;
+  size_t _used;
+  size_t _last;  // Offset of the last block header, _size when there is none
+};
+
+#endif // MQTTU_STATIC_POOL_H
@@ -0,0 +1,159 @@
+/*
+  Host replacement of the Arduino core subset used by the common libraries, for the native test env.
+  Print follows the Arduino core formatting (printFloat() rounding included) so rendered payloads
+  match the boards byte for byte. Time and analog inputs are driven by the test, see Native_Mocks.h.
+
+  Author: Ilari Mattsson
+  Library: Native Mocks
+  File: Arduino.h
+*/
+
+#ifndef NATIVE_MOCKS_ARDUINO_H
+#define NATIVE_MOCKS_ARDUINO_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+typedef uint8_t byte;
+typedef bool boolean;
+
+#define HIGH 0x1
+#define LOW 0x0
+#define INPUT 0x0
+#define OUTPUT 0x1
+#define INPUT_PULLUP 0x2
+#define LED_BUILTIN 6
+
+// MKR WiFi 1010 analog pin numbers
+#define A0 15
+#define A1 16
+#define A2 17
+#define A3 18
+#define A4 19
+#define A5 20
+#define A6 21
+#define NUM_PINS 32
+
+#define PROGMEM
+#define F(string) (string)
+
+// Same helpers as the SAMD core
+template <class T, class L>
+auto min(const T& a, const L& b) -> decltype((b < a) ? b : a) {
+  return (b < a) ? b : a;
+}
+template <class T, class L>
+auto max(const T& a, const L& b) -> decltype((b < a) ? b : a) {
+  return (a < b) ? b : a;
+}
+#define constrain(amt, low, high) ((amt) < (low) ? (low) : ((amt) > (high) ? (high) : (amt)))
+
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+void yield();
+
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t value);
+int digitalRead(uint8_t pin);
+int analogRead(uint8_t pin);
+void analogReadResolution(int bits);
+
+long random(long max);
+long random(long min, long max);
+void randomSeed(unsigned long seed);
+
+void noInterrupts();
+void interrupts();
+
+class Print {
+public:
+  virtual ~Print() {}
+
+  virtual size_t write(uint8_t c) = 0;
+  virtual size_t write(const uint8_t* buffer, size_t size);
+  size_t write(const char* str) {
+    return str == NULL ? 0 : write((const uint8_t*)str, strlen(str));
+  }
+  size_t write(const char* buffer, size_t size) {
+    return write((const uint8_t*)buffer, size);
+  }
+
+  virtual int availableForWrite() {
+    return 0;
+  }
+  virtual void flush() {}
+
+  size_t print(const char* str);
+  size_t print(char c);
+  size_t print(unsigned char value, int base = 10);
+  size_t print(int value, int base = 10);
+  size_t print(unsigned int value, int base = 10);
+  size_t print(long value, int base = 10);
+  size_t print(unsigned long value, int base = 10);
+  size_t print(double value, int digits = 2);
+
+  size_t println(const char* str);
+  size_t println();
+
+private:
+  size_t printNumber(unsigned long value, uint8_t base);
+  size_t printFloat(double value, uint8_t digits);
+};
+
+class Stream : public Print {
+public:
+  virtual int available() = 0;
+  virtual int read() = 0;
+  virtual int peek() = 0;
+};
+
+/**
+ * Fixed capacity String, enough for topic names. No heap use, so it does not show in benchmark counts
+*/
+class String {
+public:
+  String(const char* str = "");
+  const char* c_str() const;
+  unsigned int length() const;
+  bool operator==(const char* str) const;
+  bool operator!=(const char* str) const;
+
+private:
+  char _buffer[128];
+};
+
+class IPAddress {
+public:
+  IPAddress();
+  IPAddress(uint8_t a, uint8_t b, uint8_t c, uint8_t d);
+  IPAddress(uint32_t address);
+  operator uint32_t() const;
+  uint8_t operator[](int index) const;
+
+private:
+  uint32_t _address;
+};
+
+/**
+ * Serial writes to stdout
+*/
+class HardwareSerial : public Stream {
+public:
+  void begin(unsigned long baud);
+  void end();
+  using Print::write;
+  size_t write(uint8_t c) override;
+  int available() override;
+  int read() override;
+  int peek() override;
+  operator bool() const;
+};
+
+extern HardwareSerial Serial;
+
+#endif // NATIVE_MOCKS_ARDUINO_H
@@ -0,0 +1,118 @@
+/*
+  ArduinoMqttClient replacement for the native test env. Published messages are kept in a log,
+  tests read them back with getMessage(), written bytes are counted in mockIo:
+    mqttClient.mockConnect = true;            // connect() result
+    mqttClient.mockAck = 0;                   // endMessage() result, 0 = PUBACK missing
+    const mock_message* msg = mqttClient.getMessage(0);
+  Incoming messages are delivered with mockDeliver(), from the test instead of poll().
+
+  Author: Ilari Mattsson
+  Library: Native Mocks
+  File: ArduinoMqttClient.h
+*/
+
+#ifndef NATIVE_MOCKS_MQTT_CLIENT_H
+#define NATIVE_MOCKS_MQTT_CLIENT_H
+
+#include <Arduino.h>
+#include <Client.h>
+
+#define MQTT_CONNECTION_REFUSED -2
+#define MQTT_CONNECTION_TIMEOUT -1
+#define MQTT_SUCCESS 0
+#define MQTT_UNACCEPTABLE_PROTOCOL_VERSION 1
+#define MQTT_IDENTIFIER_REJECTED 2
+#define MQTT_SERVER_UNAVAILABLE 3
+#define MQTT_BAD_USER_NAME_OR_PASSWORD 4
+#define MQTT_NOT_AUTHORIZED 5
+
+#ifndef MOCK_MQTT_MESSAGES
+#define MOCK_MQTT_MESSAGES 32      // Logged messages, later ones are counted only
+#endif
+#ifndef MOCK_MQTT_PAYLOAD
+#define MOCK_MQTT_PAYLOAD 4096     // Logged bytes per message, device discovery payloads are the largest
+#endif
+
+typedef struct mock_mqtt_message {
+  char topic[128];
+  uint8_t payload[MOCK_MQTT_PAYLOAD + 1];  // NUL terminated for text payloads
+  size_t length;           // Bytes written between beginMessage() and endMessage()
+  unsigned long announced; // Size given to beginMessage(), 0xFFFFFFFF = unsized
+  bool retain;
+  uint8_t qos;
+} mock_message;
+
+class MqttClient : public Client {
+public:
+  MqttClient(Client* client);
+  MqttClient(Client& client);
+
+  /**
+   * Clear the message log and restore the defaults: broker reachable, every message acknowledged
+  */
+  void mockReset();
+
+  /**
+   * Deliver an incoming message to the onMessage() callback, read() then returns payload
+  */
+  void mockDeliver(const char* topic, const uint8_t* payload, size_t length);
+
+  /**
+   * Logged message, NULL past the log
+  */
+  const mock_message* getMessage(uint16_t index) const;
+
+  /**
+   * Messages ended since mockReset(), including those past the log
+  */
+  uint16_t getMessageCount() const;
+
+  void onMessage(void (*callback)(int size));
+  String messageTopic() const;
+  int beginMessage(const char* topic, unsigned long size, bool retain = false, uint8_t qos = 0, bool dup = false);
+  int beginMessage(const char* topic, bool retain = false, uint8_t qos = 0, bool dup = false);
+  int endMessage();
+  int subscribe(const char* topic, uint8_t qos = 0);
+  int unsubscribe(const char* topic);
+  void poll();
+  int connect(IPAddress ip, uint16_t port = 1883) override;
+  int connect(const char* host, uint16_t port = 1883) override;
+  using Print::write;
+  size_t write(uint8_t c) override;
+  size_t write(const uint8_t* buffer, size_t size) override;
+  int available() override;
+  int read() override;
+  int read(uint8_t* buffer, size_t size) override;
+  int peek() override;
+  void flush() override;
+  void stop() override;
+  uint8_t connected() override;
+  operator bool() override;
+  void setId(const char* id);
+  void setUsernamePassword(const char* username, const char* password);
+  void setCleanSession(bool cleanSession);
+  void setKeepAliveInterval(unsigned long interval);
+  void setConnectionTimeout(unsigned long timeout);
+  int connectError() const;
+
+  bool mockConnect;        // connect() result
+  int mockConnectError;    // connectError() after a failed connect()
+  int mockAck;             // endMessage() result
+  bool mockConnected;      // connected(), set by connect() and stop()
+  const char* mockSubscribed;  // Last subscribe() topic
+  bool mockCleanSession;
+
+private:
+  Client* _client;
+  void (*_onMessage)(int size);
+  mock_message _log[MOCK_MQTT_MESSAGES];
+  mock_message _current;   // Message between beginMessage() and endMessage()
+  bool _inMessage;
+  uint16_t _count;
+  String _rxTopic;
+  const uint8_t* _rx;
+  size_t _rxLength;
+  size_t _rxOffset;
+};
+
+#endif // NATIVE_MOCKS_MQTT_CLIENT_H
@@ -0,0 +1,118 @@
+/*
+  Author: Ilari Mattsson
+  Library: Native Mocks
+  File: Native_Bench.cpp
+*/
+
+#include "Native_Bench.h"
+#include <stdio.h>
+#include <new>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#else
+#include <chrono>
+#endif
+
+static uint32_t _allocs = 0;
+static uint64_t _heap = 0;
+
+static void countAlloc(size_t size) {
+  _allocs++;
+  _heap += size;
+}
+
+#if defined(__GLIBC__)
+// glibc allows the program to replace malloc, the originals stay reachable under __libc_*.
+// ArduinoJson allocates with malloc(), operator new of libstdc++ ends up here as well.
+extern "C" {
+  void* __libc_malloc(size_t size);
+  void* __libc_calloc(size_t count, size_t size);
+  void* __libc_realloc(void* ptr, size_t size);
+  void __libc_free(void* ptr);
+
+  void* malloc(size_t size) {
+    countAlloc(size);
+    return __libc_malloc(size);
+  }
+
+  void* calloc(size_t count, size_t size) {
+    countAlloc(count * size);
+    return __libc_calloc(count, size);
+  }
+
+  void* realloc(void* ptr, size_t size) {
+    countAlloc(size);
+    return __libc_realloc(ptr, size);
+  }
+
+  void free(void* ptr) {
+    __libc_free(ptr);
+  }
+}
+#else
+void* operator new(size_t size) {
+  countAlloc(size);
+  void* ptr = malloc(size > 0 ? size : 1);
+  if (ptr == NULL) throw std::bad_alloc();
+  return ptr;
+}
+
+void* operator new[](size_t size) {
+  return operator new(size);
+}
+
+void operator delete(void* ptr) noexcept {
+  free(ptr);
+}
+
+void operator delete[](void* ptr) noexcept {
+  free(ptr);
+}
+#endif
+
+// ================================ Harness ========================================
+
+uint64_t benchCycles() {
+  #if defined(__x86_64__) || defined(__i386__)
+  return __rdtsc();
+  #else
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+    std::chrono::steady_clock::now().time_since_epoch()).count();
+  #endif
+}
+
+void benchSnapshot(bench_snap* snap) {
+  snap->bytes = mockIo.bytes;
+  snap->writes = mockIo.writes;
+  snap->allocs = _allocs;
+  snap->heap = _heap;
+}
+
+bench_res benchFinish(const char* name, uint32_t calls, uint64_t elapsed, const bench_snap& start) {
+  bench_snap end;
+  benchSnapshot(&end);
+  float n = calls > 0 ? (float)calls : 1.0f;
+
+  bench_res result;
+  result.name = name;
+  result.calls = calls;
+  result.cycles = calls > 0 ? elapsed / calls : 0;
+  result.bytes = (end.bytes - start.bytes) / n;
+  result.writes = (end.writes - start.writes) / n;
+  result.allocs = (end.allocs - start.allocs) / n;
+  result.heap = (float)(end.heap - start.heap) / n;
+
+  printf("bench %-28s calls %6u  cycles %8llu  bytes %7.1f  writes %7.1f  allocs %5.1f  heap %8.1f\n",
+         name, (unsigned)calls, (unsigned long long)result.cycles, result.bytes, result.writes,
+         result.allocs, result.heap);
+  return result;
+}
+
+uint32_t benchAllocs() {
+  return _allocs;
+}
+
+uint64_t benchHeapBytes() {
+  return _heap;
+}
@@ -0,0 +1,76 @@
+/*
+  Benchmark harness for the native test env. benchRun() calls a function repeatedly and reports per call:
+    - cycles: average over the calls, TSC ticks on x86 hosts, steady clock ns elsewhere
+    - bytes: bytes written to mock Clients and MqttClients, i.e. payload bytes copied towards the socket
+    - writes: write() calls carrying them, byte-wise streaming shows as writes == bytes
+    - allocs: heap allocations (malloc, calloc, realloc and operator new on glibc hosts, operator new only elsewhere)
+    - heap: bytes requested by those allocations
+  Cycles are host numbers, compare them between builds on the same machine. Bytes, writes and allocs
+  do not depend on the host and can be asserted in tests:
+    bench_res r = benchRun("sendFrame", 1000, [&]() { mqttUtility.sendFrame(frame, topic); });
+    TEST_ASSERT_EQUAL_FLOAT(0, r.allocs);
+  Each result is printed as one line starting with "bench", e.g. to grep from pio test -e native -v.
+
+  Author: Ilari Mattsson
+  Library: Native Mocks
+  File: Native_Bench.h
+*/
+
+#ifndef NATIVE_BENCH_H
+#define NATIVE_BENCH_H
+
+#include "Native_Mocks.h"
+
+typedef struct bench_result {
+  const char* name;
+  uint32_t calls;
+  uint64_t cycles;  // Per call averages
+  float bytes;
+  float writes;
+  float allocs;
+  float heap;
+} bench_res;
+
+/* Counter snapshot, see benchRun() */
+typedef struct bench_snapshot {
+  uint32_t bytes;
+  uint32_t writes;
+  uint32_t allocs;
+  uint64_t heap;
+} bench_snap;
+
+/**
+ * Cycle counter, see the header for its unit
+*/
+uint64_t benchCycles();
+
+void benchSnapshot(bench_snap* snap);
+
+/**
+ * Per call averages since start, printed as a "bench" line
+*/
+bench_res benchFinish(const char* name, uint32_t calls, uint64_t elapsed, const bench_snap& start);
+
+/**
+ * Heap allocation counters, also counting outside benchRun()
+*/
+uint32_t benchAllocs();
+uint64_t benchHeapBytes();
+
+/**
+ * Call fn calls times. A warm-up call runs first and is not counted, so one-time initialisation
+ * does not show as a per call cost. The loop is timed as a whole, single calls can be shorter than
+ * the resolution of a virtualised TSC.
+*/
+template <typename F>
+bench_res benchRun(const char* name, uint32_t calls, F fn) {
+  fn();
+  bench_snap start;
+  benchSnapshot(&start);
+  uint64_t begin = benchCycles();
+  for (uint32_t i = 0; i < calls; i++) fn();
+  uint64_t elapsed = benchCycles() - begin;
+  return benchFinish(name, calls, elapsed, start);
+}
+
+#endif // NATIVE_BENCH_H
@@ -0,0 +1,273 @@
+/*
+  Author: Ilari Mattsson
+  Library: Native Mocks
+  File: Native_Mocks.cpp
+  Version: 1.0
+*/
+
+#include "Native_Mocks.h"
+#include <stdio.h>
+
+mock_io mockIo = { 0, 0, 0 };
+HardwareSerial Serial;
+
+static uint64_t _micros = 0;
+static mock_analog_source _analog = NULL;
+static uint8_t _pins[NUM_PINS];
+static uint32_t _random = 1;
+
+// ================================ Mock control ========================================
+
+void mockReset() {
+  _micros = 0;
+  _analog = NULL;
+  memset(_pins, 0, sizeof(_pins));
+  _random = 1;
+  memset(&mockIo, 0, sizeof(mockIo));
+  WiFi.mockReset();
+}
+
+void mockAdvance(unsigned long ms) {
+  _micros += (uint64_t)ms * 1000;
+}
+
+void mockAnalog(mock_analog_source source) {
+  _analog = source;
+}
+
+uint8_t mockPinValue(uint8_t pin) {
+  return pin < NUM_PINS ? _pins[pin] : LOW;
+}
+
+// ================================ Core functions ========================================
+
+unsigned long millis() {
+  return (unsigned long)(uint32_t)(_micros / 1000);
+}
+
+unsigned long micros() {
+  return (unsigned long)(uint32_t)_micros;
+}
+
+void delay(unsigned long ms) {
+  mockAdvance(ms);
+}
+
+void delayMicroseconds(unsigned int us) {
+  _micros += us;
+}
+
+void yield() {
+}
+
+void pinMode(uint8_t pin, uint8_t mode) {
+  (void)pin;
+  (void)mode;
+}
+
+void digitalWrite(uint8_t pin, uint8_t value) {
+  if (pin < NUM_PINS) _pins[pin] = value;
+}
+
+int digitalRead(uint8_t pin) {
+  return mockPinValue(pin);
+}
+
+int analogRead(uint8_t pin) {
+  return _analog != NULL ? _analog(pin) : 0;
+}
+
+void analogReadResolution(int bits) {
+  (void)bits;
+}
+
+long random(long max) {
+  // xorshift32, same sequence on every run
+  _random ^= _random << 13;
+  _random ^= _random >> 17;
+  _random ^= _random << 5;
+  return max > 0 ? (long)(_random % (uint32_t)max) : 0;
+}
+
+long random(long min, long max) {
+  return min >= max ? min : min + random(max - min);
+}
+
+void randomSeed(unsigned long seed) {
+  if (seed != 0) _random = (uint32_t)seed;
+}
+
+void noInterrupts() {
+}
+
+void interrupts() {
+}
+
+// ================================ Print ========================================
+
+size_t Print::write(const uint8_t* buffer, size_t size) {
+  size_t n = 0;
+  while (size--) {
+    if (write(*buffer++)) n++;
+    else break;
+  }
+  return n;
+}
+
+size_t Print::print(const char* str) {
+  return write(str);
+}
+
+size_t Print::print(char c) {
+  return write((uint8_t)c);
+}
+
+size_t Print::print(unsigned char value, int base) {
+  return print((unsigned long)value, base);
+}
+
+size_t Print::print(int value, int base) {
+  return print((long)value, base);
+}
+
+size_t Print::print(unsigned int value, int base) {
+  return print((unsigned long)value, base);
+}
+
+size_t Print::print(long value, int base) {
+  if (base == 0) return write((uint8_t)value);
+  if (base == 10 && value < 0) {
+    size_t n = print('-');
+    return n + printNumber(-(unsigned long)value, 10);
+  }
+  return printNumber((unsigned long)value, base);
+}
+
+size_t Print::print(unsigned long value, int base) {
+  if (base == 0) return write((uint8_t)value);
+  return printNumber(value, base);
+}
+
+size_t Print::print(double value, int digits) {
+  return printFloat(value, digits < 0 ? 2 : digits);
+}
+
+size_t Print::println(const char* str) {
+  size_t n = print(str);
+  return n + println();
+}
+
+size_t Print::println() {
+  return write("\r\n");
+}
+
+size_t Print::printNumber(unsigned long value, uint8_t base) {
+  char buffer[8 * sizeof(long) + 1];
+  char* str = &buffer[sizeof(buffer) - 1];
+  *str = '\0';
+  if (base < 2) base = 10;
+  do {
+    char digit = value % base;
+    value /= base;
+    *--str = digit < 10 ? digit + '0' : digit + 'A' - 10;
+  } while (value);
+  return write(str);
+}
+
+size_t Print::printFloat(double value, uint8_t digits) {
+  // As the Arduino core: round at the last digit, then print the integer part and one digit at a time
+  if (isnan(value)) return print("nan");
+  if (isinf(value)) return print("inf");
+  if (value > 4294967040.0 || value < -4294967040.0) return print("ovf");
+
+  size_t n = 0;
+  if (value < 0.0) {
+    n += print('-');
+    value = -value;
+  }
+  double rounding = 0.5;
+  for (uint8_t i = 0; i < digits; i++) rounding /= 10.0;
+  value += rounding;
+
+  unsigned long integer = (unsigned long)value;
+  double remainder = value - (double)integer;
+  n += print(integer);
+  if (digits > 0) n += print('.');
+  while (digits-- > 0) {
+    remainder *= 10.0;
+    unsigned int digit = (unsigned int)remainder;
+    n += print(digit);
+    remainder -= digit;
+  }
+  return n;
+}
+
+// ================================ String, IPAddress, Serial ========================================
+
+String::String(const char* str) {
+  strncpy(_buffer, str != NULL ? str : "", sizeof(_buffer) - 1);
+  _buffer[sizeof(_buffer) - 1] = '\0';
+}
+
+const char* String::c_str() const {
+  return _buffer;
+}
+
+unsigned int String::length() const {
+  return strlen(_buffer);
+}
+
+bool String::operator==(const char* str) const {
+  return str != NULL && strcmp(_buffer, str) == 0;
+}
+
+bool String::operator!=(const char* str) const {
+  return !(*this == str);
+}
+
+IPAddress::IPAddress():
+  _address(0) {
+}
+
+IPAddress::IPAddress(uint8_t a, uint8_t b, uint8_t c, uint8_t d):
+  _address((uint32_t)a | ((uint32_t)b << 8) | ((uint32_t)c << 16) | ((uint32_t)d << 24)) {
+}
+
+IPAddress::IPAddress(uint32_t address):
+  _address(address) {
+}
+
+IPAddress::operator uint32_t() const {
+  return _address;
+}
+
+uint8_t IPAddress::operator[](int index) const {
+  return (_address >> (8 * index)) & 0xFF;
+}
+
+void HardwareSerial::begin(unsigned long baud) {
+  (void)baud;
+}
+
+void HardwareSerial::end() {
+}
+
+size_t HardwareSerial::write(uint8_t c) {
+  return putchar(c) == EOF ? 0 : 1;
+}
+
+int HardwareSerial::available() {
+  return 0;
+}
+
+int HardwareSerial::read() {
+  return -1;
+}
+
+int HardwareSerial::peek() {
+  return -1;
+}
+
+HardwareSerial::operator bool() const {
+  return true;
+}
@@ -0,0 +1,64 @@
+/*
+  Host mocks of the Arduino core, WiFiNINA and ArduinoMqttClient for the PlatformIO native test env.
+  Library code builds unchanged against them, e.g. Mqtt_Utility, Sensors and project libraries, and
+  tests drive time, inputs and the network from here.
+
+  > Implements:
+    - Arduino.h subset: Print with the core's number formatting, Stream, String, IPAddress, Serial on stdout
+    - Mock clock: millis()/micros() advance only with delay() and mockAdvance()
+    - analogRead() from a test supplied source function
+    - WiFi (WiFi.h, WiFiNINA.h) with settable status, RSSI and scan results, WiFiClient, WiFiSSLClient
+    - MqttClient (ArduinoMqttClient.h) recording published messages, settable connect and PUBACK results
+    - Byte and write() counters of every Client, read by Native_Bench.h
+
+  Only in the native env lib_deps, board builds use the real core and libraries:
+    symlink://../common/libraries/Native_Mocks
+
+  Author: Ilari Mattsson
+  Library: Native Mocks
+  File: Native_Mocks.h
+  Version: 1.0
+*/
+
+#ifndef NATIVE_MOCKS_H
+#define NATIVE_MOCKS_H
+
+#include <Arduino.h>
+#include <Client.h>
+#include <WiFi.h>
+#include <ArduinoMqttClient.h>
+
+#define NATIVE_MOCKS_VERSION "1.0"
+
+/* Transport counters, every Client and MqttClient write() adds to them */
+typedef struct mock_io_counters {
+  uint32_t bytes;     // Bytes written
+  uint32_t writes;    // write() calls, byte-wise streaming shows as writes == bytes
+  uint32_t messages;  // MqttClient messages ended
+} mock_io;
+
+extern mock_io mockIo;
+
+typedef int (*mock_analog_source)(uint8_t pin);
+
+/**
+ * Back to boot: clock at 0, counters cleared, WiFi reset, analogRead() returns 0
+*/
+void mockReset();
+
+/**
+ * Advance millis() and micros()
+*/
+void mockAdvance(unsigned long ms);
+
+/**
+ * Source of analogRead() values, NULL = always 0. Called once per analogRead()
+*/
+void mockAnalog(mock_analog_source source);
+
+/**
+ * digitalWrite() value of pin, LOW until written
+*/
+uint8_t mockPinValue(uint8_t pin);
+
+#endif // NATIVE_MOCKS_H
@@ -0,0 +1,97 @@
+/*
+  WiFiNINA replacement for the native test env. The radio is a set of public mock fields, e.g.
+    WiFi.mockStatus = WL_CONNECTED;
+  association is immediate and scans return mockNetworks. WiFiClient counts written bytes in mockIo.
+
+  Author: Ilari Mattsson
+  Library: Native Mocks
+  File: WiFi.h
+*/
+
+#ifndef NATIVE_MOCKS_WIFI_H
+#define NATIVE_MOCKS_WIFI_H
+
+#include <Arduino.h>
+#include <Client.h>
+
+#define WL_IDLE_STATUS 0
+#define WL_NO_SSID_AVAIL 1
+#define WL_SCAN_COMPLETED 2
+#define WL_CONNECTED 3
+#define WL_CONNECT_FAILED 4
+#define WL_CONNECTION_LOST 5
+#define WL_DISCONNECTED 6
+#define WL_AP_LISTENING 7
+#define WL_AP_CONNECTED 8
+#define WL_AP_FAILED 9
+#define WL_NO_MODULE 255
+
+#define MOCK_WIFI_NETWORKS 4
+
+class WiFiClass {
+public:
+  WiFiClass();
+
+  /**
+   * Back to defaults: disconnected, joins on begin(), no networks in range
+  */
+  void mockReset();
+
+  int begin(const char* ssid);
+  int begin(const char* ssid, const char* psk);
+  void end();
+  int disconnect();
+  uint8_t status();
+  int32_t RSSI();
+  int32_t RSSI(uint8_t index);
+  const char* SSID();
+  const char* SSID(uint8_t index);
+  int8_t scanNetworks();
+  void setTimeout(unsigned long timeout);
+  uint8_t* macAddress(uint8_t* mac);
+  unsigned long getTime();
+  IPAddress localIP();
+  IPAddress gatewayIP();
+  IPAddress subnetMask();
+  void config(IPAddress ip, IPAddress dns, IPAddress gateway, IPAddress subnet);
+  void lowPowerMode();
+  void noLowPowerMode();
+
+  uint8_t mockStatus;       // status()
+  uint8_t mockJoinStatus;   // status() after begin(), e.g. WL_CONNECT_FAILED
+  int32_t mockRssi;         // RSSI() of the joined network
+  unsigned long mockTime;   // getTime(), 0 = no NTP time yet
+  const char* mockSsid;     // Last begin() network
+  uint16_t mockBegins;      // begin() calls
+  const char* mockNetworks[MOCK_WIFI_NETWORKS];  // scanNetworks() results
+  int32_t mockNetworkRssi[MOCK_WIFI_NETWORKS];
+  uint8_t mockNetworkCount;
+};
+
+extern WiFiClass WiFi;
+
+class WiFiClient : public Client {
+public:
+  WiFiClient();
+  int connect(IPAddress ip, uint16_t port) override;
+  int connect(const char* host, uint16_t port) override;
+  using Print::write;
+  size_t write(uint8_t c) override;
+  size_t write(const uint8_t* buffer, size_t size) override;
+  int available() override;
+  int read() override;
+  int read(uint8_t* buffer, size_t size) override;
+  int peek() override;
+  void flush() override;
+  void stop() override;
+  uint8_t connected() override;
+  operator bool() override;
+
+private:
+  bool _connected;
+};
+
+class WiFiSSLClient : public WiFiClient {
+};
+
+#endif // NATIVE_MOCKS_WIFI_H
@@ -0,0 +1,12 @@
+/*
+  Author: Ilari Mattsson
+  Library: Native Mocks
+  File: WiFiNINA.h
+*/
+
+#ifndef NATIVE_MOCKS_WIFININA_H
+#define NATIVE_MOCKS_WIFININA_H
+
+#include <WiFi.h>
+
+#endif // NATIVE_MOCKS_WIFININA_H
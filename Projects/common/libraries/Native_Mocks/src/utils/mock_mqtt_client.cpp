@@ -0,0 +1,201 @@
+/*
+  Author: Ilari Mattsson
+  Library: Native Mocks
+  File: mock_mqtt_client.cpp
+*/
+
+#include "../Native_Mocks.h"
+#include <WiFi.h>
+
+MqttClient::MqttClient(Client* client):
+  _client(client),
+  _onMessage(NULL) {
+  mockReset();
+}
+
+MqttClient::MqttClient(Client& client):
+  MqttClient(&client) {
+}
+
+// ================================ Mock control ========================================
+
+void MqttClient::mockReset() {
+  mockConnect = true;
+  mockConnectError = MQTT_CONNECTION_REFUSED;
+  mockAck = 1;
+  mockConnected = false;
+  mockSubscribed = NULL;
+  mockCleanSession = true;
+  _inMessage = false;
+  _count = 0;
+  _rxTopic = String();
+  _rx = NULL;
+  _rxLength = 0;
+  _rxOffset = 0;
+}
+
+void MqttClient::mockDeliver(const char* topic, const uint8_t* payload, size_t length) {
+  _rxTopic = String(topic);
+  _rx = payload;
+  _rxLength = length;
+  _rxOffset = 0;
+  if (_onMessage != NULL) _onMessage((int)length);
+  // Unread bytes are discarded as by the real client
+  _rx = NULL;
+  _rxLength = 0;
+  _rxOffset = 0;
+}
+
+const mock_message* MqttClient::getMessage(uint16_t index) const {
+  if (index >= _count || index >= MOCK_MQTT_MESSAGES) return NULL;
+  return &_log[index];
+}
+
+uint16_t MqttClient::getMessageCount() const {
+  return _count;
+}
+
+// ================================ Class public methods ========================================
+
+void MqttClient::onMessage(void (*callback)(int size)) {
+  _onMessage = callback;
+}
+
+String MqttClient::messageTopic() const {
+  return _rxTopic;
+}
+
+int MqttClient::beginMessage(const char* topic, unsigned long size, bool retain, uint8_t qos, bool dup) {
+  (void)dup;
+  if (!connected()) return 0;
+  strncpy(_current.topic, topic, sizeof(_current.topic) - 1);
+  _current.topic[sizeof(_current.topic) - 1] = '\0';
+  _current.length = 0;
+  _current.announced = size;
+  _current.retain = retain;
+  _current.qos = qos;
+  _inMessage = true;
+  return 1;
+}
+
+int MqttClient::beginMessage(const char* topic, bool retain, uint8_t qos, bool dup) {
+  return beginMessage(topic, 0xFFFFFFFFUL, retain, qos, dup);
+}
+
+int MqttClient::endMessage() {
+  if (!_inMessage) return 0;
+  _inMessage = false;
+  _current.payload[_current.length < MOCK_MQTT_PAYLOAD ? _current.length : MOCK_MQTT_PAYLOAD] = '\0';
+  if (_count < MOCK_MQTT_MESSAGES) _log[_count] = _current;
+  _count++;
+  mockIo.messages++;
+  // A sized message with a different length corrupts the stream on a real broker connection
+  if (_current.announced != 0xFFFFFFFFUL && _current.announced != _current.length) return 0;
+  return _current.qos == 0 ? 1 : mockAck;
+}
+
+int MqttClient::subscribe(const char* topic, uint8_t qos) {
+  (void)qos;
+  if (!connected()) return 0;
+  mockSubscribed = topic;
+  return 1;
+}
+
+int MqttClient::unsubscribe(const char* topic) {
+  (void)topic;
+  return connected();
+}
+
+void MqttClient::poll() {
+}
+
+int MqttClient::connect(IPAddress ip, uint16_t port) {
+  (void)ip;
+  (void)port;
+  mockConnected = mockConnect && WiFi.status() == WL_CONNECTED;
+  return mockConnected;
+}
+
+int MqttClient::connect(const char* host, uint16_t port) {
+  (void)host;
+  (void)port;
+  mockConnected = mockConnect && WiFi.status() == WL_CONNECTED;
+  return mockConnected;
+}
+
+size_t MqttClient::write(uint8_t c) {
+  return write(&c, 1);
+}
+
+size_t MqttClient::write(const uint8_t* buffer, size_t size) {
+  if (!_inMessage) return 0;
+  if (_current.length < MOCK_MQTT_PAYLOAD) {
+    size_t room = MOCK_MQTT_PAYLOAD - _current.length;
+    memcpy(_current.payload + _current.length, buffer, size < room ? size : room);
+  }
+  _current.length += size;
+  mockIo.bytes += size;
+  mockIo.writes++;
+  return size;
+}
+
+int MqttClient::available() {
+  return (int)(_rxLength - _rxOffset);
+}
+
+int MqttClient::read() {
+  return _rxOffset < _rxLength ? _rx[_rxOffset++] : -1;
+}
+
+int MqttClient::read(uint8_t* buffer, size_t size) {
+  size_t n = _rxLength - _rxOffset;
+  if (n > size) n = size;
+  if (n > 0) memcpy(buffer, _rx + _rxOffset, n);
+  _rxOffset += n;
+  return (int)n;
+}
+
+int MqttClient::peek() {
+  return _rxOffset < _rxLength ? _rx[_rxOffset] : -1;
+}
+
+void MqttClient::flush() {
+}
+
+void MqttClient::stop() {
+  mockConnected = false;
+  if (_client != NULL) _client->stop();
+}
+
+uint8_t MqttClient::connected() {
+  return mockConnected && WiFi.status() == WL_CONNECTED;
+}
+
+MqttClient::operator bool() {
+  return true;
+}
+
+void MqttClient::setId(const char* id) {
+  (void)id;
+}
+
+void MqttClient::setUsernamePassword(const char* username, const char* password) {
+  (void)username;
+  (void)password;
+}
+
+void MqttClient::setCleanSession(bool cleanSession) {
+  mockCleanSession = cleanSession;
+}
+
+void MqttClient::setKeepAliveInterval(unsigned long interval) {
+  (void)interval;
+}
+
+void MqttClient::setConnectionTimeout(unsigned long timeout) {
+  (void)timeout;
+}
+
+int MqttClient::connectError() const {
+  return mockConnected ? MQTT_SUCCESS : mockConnectError;
+}
@@ -0,0 +1,177 @@
+/*
+  Author: Ilari Mattsson
+  Library: Native Mocks
+  File: mock_wifi.cpp
+*/
+
+#include "../Native_Mocks.h"
+
+WiFiClass WiFi;
+
+WiFiClass::WiFiClass() {
+  mockReset();
+}
+
+// ================================ Class public methods ========================================
+
+void WiFiClass::mockReset() {
+  mockStatus = WL_IDLE_STATUS;
+  mockJoinStatus = WL_CONNECTED;
+  mockRssi = -60;
+  mockTime = 0;
+  mockSsid = NULL;
+  mockBegins = 0;
+  mockNetworkCount = 0;
+  for (uint8_t i = 0; i < MOCK_WIFI_NETWORKS; i++) {
+    mockNetworks[i] = NULL;
+    mockNetworkRssi[i] = 0;
+  }
+}
+
+int WiFiClass::begin(const char* ssid) {
+  mockSsid = ssid;
+  mockBegins++;
+  mockStatus = mockJoinStatus;
+  return mockStatus;
+}
+
+int WiFiClass::begin(const char* ssid, const char* psk) {
+  (void)psk;
+  return begin(ssid);
+}
+
+void WiFiClass::end() {
+  mockStatus = WL_IDLE_STATUS;
+}
+
+int WiFiClass::disconnect() {
+  mockStatus = WL_DISCONNECTED;
+  return WL_DISCONNECTED;
+}
+
+uint8_t WiFiClass::status() {
+  return mockStatus;
+}
+
+int32_t WiFiClass::RSSI() {
+  return mockStatus == WL_CONNECTED ? mockRssi : 0;
+}
+
+int32_t WiFiClass::RSSI(uint8_t index) {
+  return index < mockNetworkCount ? mockNetworkRssi[index] : 0;
+}
+
+const char* WiFiClass::SSID() {
+  return mockSsid != NULL ? mockSsid : "";
+}
+
+const char* WiFiClass::SSID(uint8_t index) {
+  return index < mockNetworkCount && mockNetworks[index] != NULL ? mockNetworks[index] : "";
+}
+
+int8_t WiFiClass::scanNetworks() {
+  return mockNetworkCount;
+}
+
+void WiFiClass::setTimeout(unsigned long timeout) {
+  (void)timeout;
+}
+
+uint8_t* WiFiClass::macAddress(uint8_t* mac) {
+  const uint8_t address[6] = { 0x24, 0x0a, 0xc4, 0x00, 0x00, 0x01 };
+  memcpy(mac, address, sizeof(address));
+  return mac;
+}
+
+unsigned long WiFiClass::getTime() {
+  return mockTime;
+}
+
+IPAddress WiFiClass::localIP() {
+  return mockStatus == WL_CONNECTED ? IPAddress(192, 168, 1, 50) : IPAddress();
+}
+
+IPAddress WiFiClass::gatewayIP() {
+  return mockStatus == WL_CONNECTED ? IPAddress(192, 168, 1, 1) : IPAddress();
+}
+
+IPAddress WiFiClass::subnetMask() {
+  return mockStatus == WL_CONNECTED ? IPAddress(255, 255, 255, 0) : IPAddress();
+}
+
+void WiFiClass::config(IPAddress ip, IPAddress dns, IPAddress gateway, IPAddress subnet) {
+  (void)ip;
+  (void)dns;
+  (void)gateway;
+  (void)subnet;
+}
+
+void WiFiClass::lowPowerMode() {
+}
+
+void WiFiClass::noLowPowerMode() {
+}
+
+
+WiFiClient::WiFiClient():
+  _connected(false) {
+}
+
+int WiFiClient::connect(IPAddress ip, uint16_t port) {
+  (void)ip;
+  (void)port;
+  _connected = WiFi.status() == WL_CONNECTED;
+  return _connected;
+}
+
+int WiFiClient::connect(const char* host, uint16_t port) {
+  (void)host;
+  (void)port;
+  _connected = WiFi.status() == WL_CONNECTED;
+  return _connected;
+}
+
+size_t WiFiClient::write(uint8_t c) {
+  return write(&c, 1);
+}
+
+size_t WiFiClient::write(const uint8_t* buffer, size_t size) {
+  (void)buffer;
+  if (!_connected) return 0;
+  mockIo.bytes += size;
+  mockIo.writes++;
+  return size;
+}
+
+int WiFiClient::available() {
+  return 0;
+}
+
+int WiFiClient::read() {
+  return -1;
+}
+
+int WiFiClient::read(uint8_t* buffer, size_t size) {
+  (void)buffer;
+  (void)size;
+  return -1;
+}
+
+int WiFiClient::peek() {
+  return -1;
+}
+
+void WiFiClient::flush() {
+}
+
+void WiFiClient::stop() {
+  _connected = false;
+}
+
+uint8_t WiFiClient::connected() {
+  return _connected && WiFi.status() == WL_CONNECTED;
+}
+
+WiFiClient::operator bool() {
+  return _connected;
+}
@@ -0,0 +1,105 @@
+/*
+  Author: Ilari Mattsson
+  Library: Node Config
+  File: Node_Config.cpp
+  Version: 1.0
+*/
+
+#include "Node_Config.h"
+#include <Arduino.h>
+#include <FlashStorage.h>
+#include <Flash_Layout.h>
+
+typedef struct node_config_record {
+  uint32_t magic;
+  node_cfg cfg;
+  uint32_t checksum;  // FNV-1a over all preceding bytes
+} cfg_record;
+
+static_assert(sizeof(cfg_record) <= FLASH_ROW_SIZE, "cfg_record must fit in one flash row");
+FlashStorageClass<cfg_record> nodeConfigFlash(FLASH_RECORD_ADDRESS(FLASH_ROW_NODE_CONFIG));
+
+/**
+ * Read a number within min..max, integers and floats are both accepted
+*/
+static bool readNumber(JsonVariantConst value, float min, float max, float* out) {
+  if (!value.is<float>()) return false;
+  float number = value.as<float>();
+  if (isnan(number) || number < min || number > max) return false;
+  *out = number;
+  return true;
+}
+
+
+NodeConfig::NodeConfig(const node_cfg& defaults):
+  _defaults(defaults),
+  _cfg(defaults) {
+}
+
+// ================================ Class public methods ========================================
+
+bool NodeConfig::load() {
+  cfg_record record;
+  nodeConfigFlash.read(&record);
+
+  if (record.magic != NODE_CONFIG_MAGIC) return false;
+  if (record.checksum != checksum(&record, offsetof(cfg_record, checksum))) return false;
+  _cfg = record.cfg;
+  return true;
+}
+
+void NodeConfig::save() {
+  // Zeroed so struct padding does not change the checksum
+  cfg_record record;
+  memset(&record, 0, sizeof(record));
+  record.magic = NODE_CONFIG_MAGIC;
+  record.cfg = _cfg;
+  record.checksum = checksum(&record, offsetof(cfg_record, checksum));
+
+  nodeConfigFlash.write(record);
+}
+
+void NodeConfig::clear() {
+  cfg_record record;
+  memset(&record, 0, sizeof(record));
+  nodeConfigFlash.write(record);
+  _cfg = _defaults;
+}
+
+uint8_t NodeConfig::apply(JsonObjectConst doc) {
+  node_cfg cfg = _cfg;
+  float value;
+
+  if (readNumber(doc["interval"], NODE_CFG_INTERVAL_MIN, NODE_CFG_INTERVAL_MAX, &value)) cfg.interval = (uint32_t)value * 1000UL;
+  if (readNumber(doc["heartbeat"], NODE_CFG_INTERVAL_MIN, NODE_CFG_INTERVAL_MAX, &value)) cfg.heartbeat = (uint32_t)value * 1000UL;
+  if (readNumber(doc["timeout"], 0, UINT16_MAX, &value)) cfg.sensorTimeout = (uint16_t)value;
+  if (readNumber(doc["rounds"], 1, NODE_CFG_ROUNDS_MAX, &value)) cfg.rounds = (uint16_t)value;
+  if (readNumber(doc["temp_offset"], -NODE_CFG_OFFSET_MAX, NODE_CFG_OFFSET_MAX, &value)) cfg.temperatureOffset = value;
+  if (readNumber(doc["hum_offset"], -NODE_CFG_OFFSET_MAX, NODE_CFG_OFFSET_MAX, &value)) cfg.humidityOffset = value;
+  if (cfg.heartbeat < cfg.interval) cfg.heartbeat = cfg.interval;
+
+  uint8_t changed = 0;
+  if (cfg.interval != _cfg.interval) changed |= NODE_CFG_INTERVAL;
+  if (cfg.heartbeat != _cfg.heartbeat) changed |= NODE_CFG_HEARTBEAT;
+  if (cfg.sensorTimeout != _cfg.sensorTimeout) changed |= NODE_CFG_TIMEOUT;
+  if (cfg.rounds != _cfg.rounds) changed |= NODE_CFG_ROUNDS;
+  if (cfg.temperatureOffset != _cfg.temperatureOffset || cfg.humidityOffset != _cfg.humidityOffset) changed |= NODE_CFG_OFFSETS;
+  _cfg = cfg;
+  return changed;
+}
+
+const node_cfg& NodeConfig::get() const {
+  return _cfg;
+}
+
+// ================================ Class private methods ========================================
+
+uint32_t NodeConfig::checksum(const void* data, size_t len) {
+  const uint8_t* bytes = (const uint8_t*)data;
+  uint32_t hash = 2166136261UL;
+  for (size_t i = 0; i < len; i++) {
+    hash ^= bytes[i];
+    hash *= 16777619UL;
+  }
+  return hash;
+}
@@ -0,0 +1,93 @@
+/*
+  Runtime node configuration for SAMD boards.
+  Sampling and reporting settings that used to be compile-time constants, changed with a JSON
+  document on the command topic and kept in flash (FlashStorage) over resets.
+
+  > Implements:
+    - Fixed schema, every field has a compile-time default and a valid range
+    - apply() reads a JsonObjectConst, only present and valid keys are changed
+    - Flash record: magic, settings, FNV-1a checksum. Defaults are used without a valid record
+
+  Config document, every key optional, times in seconds:
+    {"interval": 60, "heartbeat": 300, "timeout": 3600, "rounds": 40, "temp_offset": -3.6, "hum_offset": 14}
+
+  Flash is only written by save(). The record lives in a reserved row at the top of flash
+  (Flash_Layout.h), it is kept over MQTTU_OTA updates and erased by a USB upload.
+
+  Author: Ilari Mattsson
+  Library: Node Config
+  File: Node_Config.h
+  Version: 1.0
+*/
+
+#ifndef NODE_CONFIG_H
+#define NODE_CONFIG_H
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+
+#define NODE_CONFIG_VERSION "1.0"
+
+#define NODE_CONFIG_MAGIC 0x43464731  // "CFG1", change when the record layout changes
+
+// Valid ranges, values outside are ignored
+#define NODE_CFG_INTERVAL_MIN 10      // s
+#define NODE_CFG_INTERVAL_MAX 86400   // s
+#define NODE_CFG_ROUNDS_MAX 1000
+#define NODE_CFG_OFFSET_MAX 50.0f     // ±°C / ±%
+
+// apply() return flags
+#define NODE_CFG_INTERVAL 0x01
+#define NODE_CFG_HEARTBEAT 0x02
+#define NODE_CFG_TIMEOUT 0x04
+#define NODE_CFG_ROUNDS 0x08
+#define NODE_CFG_OFFSETS 0x10
+
+typedef struct node_configuration {
+  uint32_t interval;        // ms, sampling period
+  uint32_t heartbeat;       // ms, longest time between reports, at least interval
+  uint16_t sensorTimeout;   // s, discovery expire_after
+  uint16_t rounds;          // Readings averaged per measurement
+  float temperatureOffset;  // °C
+  float humidityOffset;     // %
+} node_cfg;
+
+class NodeConfig {
+public:
+  /**
+   * params: const node_cfg& defaults: values used until a config is loaded or applied
+  */
+  NodeConfig(const node_cfg& defaults);
+
+  /**
+   * Load settings from flash
+   * returns: bool: false if no valid record was found, defaults are kept
+  */
+  bool load();
+
+  /**
+   * Write the current settings to flash
+  */
+  void save();
+
+  /**
+   * Invalidate the stored record and return to the defaults
+  */
+  void clear();
+
+  /**
+   * Change settings from a config document, invalid or out of range values are ignored
+   * returns: uint8_t: NODE_CFG_* flags of the changed settings, 0 if nothing changed
+  */
+  uint8_t apply(JsonObjectConst doc);
+
+  const node_cfg& get() const;
+
+private:
+  static uint32_t checksum(const void* data, size_t len);
+
+  node_cfg _defaults;
+  node_cfg _cfg;
+};
+
+#endif // NODE_CONFIG_H
@@ -0,0 +1,127 @@
+/*
+  Integer conversions for sensor readings on boards without an FPU (SAMD21 Cortex-M0+).
+  Calibration is turned into a fixed-point scale once, readings are then converted with one multiply
+  and a shift instead of map() or float math.
+
+  > Implements:
+    - FixedScale: linear two point calibration as a Q16 scale, output in fixed-point units
+      (e.g. tenths of a percent) so fractions are kept instead of truncated. applyMean() converts
+      the mean of a fixed number of summed readings with a scale precomputed for that count, the
+      fraction of the mean is kept without dividing the sum
+    - bandOf(): classification against a threshold table kept in flash, table order checked at compile time
+
+  Usage:
+    FixedScale moisture;
+    moisture.set(base, cap, 0, 1000);        // Dry reading 0.0 %, wet reading 100.0 %, in tenths
+    moisture.setCount(rounds);               // Readings summed per mean, either call may come first
+    int32_t tenths = moisture.apply(raw);    // Clamped to 0..1000
+    tenths = moisture.applyMean(sum);        // Mean of rounds summed readings
+    frame.setFixed("smst1", tenths, 1);      // Rendered as 43.5 without float formatting
+
+    constexpr uint16_t co2Limits[] = { 600, 800, 1000, 1500 };
+    static_assert(isAscending(co2Limits), "co2Limits must be ascending");
+    uint8_t level = 1 + bandOf(co2, co2Limits);   // 1..5
+
+  Author: Ilari Mattsson
+  Library: Sensors
+  File: Sensor_Convert.h
+  Version: 1.1
+*/
+
+#ifndef SENSOR_CONVERT_H
+#define SENSOR_CONVERT_H
+
+#include <Arduino.h>
+
+class FixedScale {
+public:
+  FixedScale():
+    _in0(0),
+    _in1(0),
+    _out0(0),
+    _out1(0),
+    _count(1),
+    _scale(0),
+    _meanScale(0) {
+  }
+
+  /**
+   * Map in0..in1 linearly to out0..out1, either range may be descending.
+   * returns: bool: false if in0 == in1, apply() then returns out0
+  */
+  bool set(int32_t in0, int32_t in1, int32_t out0, int32_t out1) {
+    _in0 = in0;
+    _in1 = in1;
+    _out0 = out0;
+    _out1 = out1;
+    _scale = scaleFor(1);
+    _meanScale = scaleFor(_count);
+    return in0 != in1;
+  }
+
+  /**
+   * Set the number of readings summed for applyMean(), e.g. the rounds of a sampling batch
+  */
+  void setCount(uint16_t count) {
+    _count = count > 0 ? count : 1;
+    _meanScale = scaleFor(_count);
+  }
+
+  /**
+   * Convert raw, clamped to the calibrated input range, rounded to the nearest output unit
+  */
+  int32_t apply(int32_t raw) const {
+    int32_t lo = _in0 < _in1 ? _in0 : _in1;
+    int32_t hi = _in0 < _in1 ? _in1 : _in0;
+    if (raw < lo) raw = lo;
+    else if (raw > hi) raw = hi;
+    return _out0 + (int32_t)(((int64_t)(raw - _in0) * _scale + 0x8000) >> 16);
+  }
+
+  /**
+   * Convert the mean of setCount() readings summed into sum, same clamping and rounding as apply().
+   * The sum is scaled as is, so the mean is not truncated to whole input units.
+  */
+  int32_t applyMean(int32_t sum) const {
+    int32_t lo = (_in0 < _in1 ? _in0 : _in1) * _count;
+    int32_t hi = (_in0 < _in1 ? _in1 : _in0) * _count;
+    if (sum < lo) sum = lo;
+    else if (sum > hi) sum = hi;
+    return _out0 + (int32_t)(((int64_t)(sum - _in0 * _count) * _meanScale + 0x8000) >> 16);
+  }
+
+private:
+  int32_t _in0;
+  int32_t _in1;
+  int32_t _out0;
+  int32_t _out1;
+  uint16_t _count;
+  int32_t _scale;      // Output units per input unit, Q16
+  int32_t _meanScale;  // Output units per summed input unit of _count readings, Q16
+
+  // The only division, done when calibrating or setting the count
+  int32_t scaleFor(uint16_t count) const {
+    if (_in0 == _in1) return 0;
+    return ((int64_t)(_out1 - _out0) << 16) / ((int64_t)(_in1 - _in0) * count);
+  }
+};
+
+/**
+ * Number of limits value has reached: 0 below limits[0], N at or above limits[N - 1]
+*/
+template <typename T, size_t N>
+uint8_t bandOf(T value, const T (&limits)[N]) {
+  uint8_t band = 0;
+  while (band < N && value >= limits[band]) band++;
+  return band;
+}
+
+/**
+ * Compile-time check for bandOf() tables
+*/
+template <typename T, size_t N>
+constexpr bool isAscending(const T (&limits)[N], size_t i = 1) {
+  return i >= N || (limits[i - 1] < limits[i] && isAscending(limits, i + 1));
+}
+
+#endif // SENSOR_CONVERT_H
@@ -0,0 +1,66 @@
+/*
+  Author: Ilari Mattsson
+  Library: Sensors
+  File: Sensor_Guard.cpp
+  Version: 1.0
+*/
+
+#include "Sensor_Guard.h"
+#include <Arduino.h>
+#ifdef SENSORS_WATCHDOG
+#include <Adafruit_SleepyDog.h>
+#endif
+
+
+SensorGuard::SensorGuard(const char* name, uint32_t timeout, uint8_t maxFailures):
+  _name(name),
+  _timeout(timeout),
+  _maxFailures(maxFailures),
+  _failures(0),
+  _lastGood(0),
+  _hasValue(false),
+  _reported(false),
+  _reportedAvailable(false) {
+}
+
+// ================================ Class public methods ========================================
+
+const char* SensorGuard::getName() const {
+  return _name;
+}
+
+bool SensorGuard::isAvailable() const {
+  return _hasValue && _failures < _maxFailures;
+}
+
+uint32_t SensorGuard::getAge() const {
+  if (!_hasValue) return UINT32_MAX;
+  return millis() - _lastGood;
+}
+
+bool SensorGuard::isChanged() const {
+  return !_reported || _reportedAvailable != isAvailable();
+}
+
+void SensorGuard::markReported() {
+  _reported = true;
+  _reportedAvailable = isAvailable();
+}
+
+void SensorGuard::kickWatchdog() {
+  #ifdef SENSORS_WATCHDOG
+  Watchdog.reset();
+  #endif
+}
+
+// ================================ Class private methods ========================================
+
+void SensorGuard::onSuccess() {
+  _failures = 0;
+  _lastGood = millis();
+  _hasValue = true;
+}
+
+void SensorGuard::onFailure() {
+  if (_failures < UINT8_MAX) _failures++;
+}
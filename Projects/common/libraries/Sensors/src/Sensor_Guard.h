@@ -0,0 +1,113 @@
+/*
+  Bounded sensor acquisition for Arduino projects.
+  Wraps a sensor read so a missing or failing sensor cannot block the node.
+
+  > Implements:
+    - Timed retries of a read function, the read is given up after a timeout
+    - Last good value policy: the caller keeps its previous values when a read fails,
+      the sensor is reported unavailable after SENSOR_MAX_FAILURES failed acquisitions in a row
+    - Availability change tracking for publishing per sensor availability
+    - Hardware watchdog kicks between read attempts (SENSORS_WATCHDOG, Adafruit SleepyDog)
+
+  Usage:
+    SensorGuard shtGuard("sht");
+    float t;
+    if (shtGuard.acquire([&]() { t = sht.readTemperature(); return !isnan(t); })) temperature = t;
+
+  Author: Ilari Mattsson
+  Library: Sensors
+  File: Sensor_Guard.h
+  Version: 1.0
+*/
+
+#ifndef SENSOR_GUARD_H
+#define SENSOR_GUARD_H
+
+#include <Arduino.h>
+
+#define SENSORS_VERSION "1.2"
+
+#ifndef SENSOR_TIMEOUT
+#define SENSOR_TIMEOUT 1000       // ms to retry a read before giving up
+#endif
+#ifndef SENSOR_RETRY_DELAY
+#define SENSOR_RETRY_DELAY 50     // ms between read attempts
+#endif
+#ifndef SENSOR_MAX_FAILURES
+#define SENSOR_MAX_FAILURES 3     // Failed acquisitions in a row before the sensor is unavailable
+#endif
+#ifndef SENSOR_WDT_TIMEOUT
+#define SENSOR_WDT_TIMEOUT 16000  // ms, watchdog period used by projects with SENSORS_WATCHDOG (SAMD21 max 16 s)
+#endif
+
+class SensorGuard {
+public:
+  SensorGuard(const char* name, uint32_t timeout = SENSOR_TIMEOUT, uint8_t maxFailures = SENSOR_MAX_FAILURES);
+
+  /**
+   * Call read until it returns true or the timeout has passed, the watchdog is kicked between attempts.
+   * params:
+   *   F read: callable returning bool, true when the values it read are valid
+   * returns: bool: true if a valid reading was taken, previous values should be kept otherwise
+  */
+  template <typename F>
+  bool acquire(F read) {
+    uint32_t start = millis();
+    do {
+      if (read()) {
+        onSuccess();
+        return true;
+      }
+      kickWatchdog();
+      delay(SENSOR_RETRY_DELAY);
+    } while (millis() - start < _timeout);
+    onFailure();
+    return false;
+  }
+
+  /**
+   * Sensor name, used as the availability key
+  */
+  const char* getName() const;
+
+  /**
+   * True after a good reading until SENSOR_MAX_FAILURES acquisitions in a row have failed
+  */
+  bool isAvailable() const;
+
+  /**
+   * ms since the last good reading, UINT32_MAX if there has been none
+  */
+  uint32_t getAge() const;
+
+  /**
+   * True if availability changed since the last markReported(), or has never been reported
+  */
+  bool isChanged() const;
+
+  /**
+   * Call after the current availability has been published
+  */
+  void markReported();
+
+  /**
+   * Reset the hardware watchdog, no-op without SENSORS_WATCHDOG
+  */
+  static void kickWatchdog();
+
+private:
+  void onSuccess();
+
+  void onFailure();
+
+  const char* _name;
+  uint32_t _timeout;
+  uint8_t _maxFailures;
+  uint8_t _failures;   // Failed acquisitions in a row
+  uint32_t _lastGood;  // millis() at last good reading
+  bool _hasValue;
+  bool _reported;      // Availability has been published at least once
+  bool _reportedAvailable;
+};
+
+#endif // SENSOR_GUARD_H
@@ -0,0 +1,206 @@
+/*
+  Compile-time sensor set for Arduino projects.
+  Sensors are policy types listed in a variadic template, every call on the set is expanded for each
+  type at compile time. No virtual calls, no heap, and a project only carries the drivers it lists.
+
+  > Implements:
+    - One SensorGuard per sensor: bounded reads, last good value policy and availability tracking
+    - Per sensor enable flag, a sensor that did not start is skipped
+    - Field emission into any sink with set(key, value, decimals): StateFrame, ReportGate
+    - Availability emission into a JSON document
+
+  Policy type requirements:
+    class MySensor {
+    public:
+      static const char* name();                   // Availability key, e.g. "sht"
+      bool begin();                                // true when the sensor started
+      bool read();                                 // Take a reading, true when valid. Keep old values on false
+      template <typename F> void emit(F& sink) const;  // sink.set("temp", value, decimals) for every field
+    };
+
+  Usage:
+    typedef GroveSht31Sensor<> ShtSensor;
+    SensorSet<ShtSensor, Si1151Sensor> sensors;
+    supervisor.retry([]() { return sensors.begin<ShtSensor>(); });
+    sensors.acquireAll(reportGate);   // Read every enabled sensor, fresh values go to the gate
+    sensors.emit(stateFrame);         // Last good values of the available sensors
+  List NoSensor in place of a sensor that is compiled out. Each type can be listed once.
+
+  Author: Ilari Mattsson
+  Library: Sensors
+  File: Sensor_Set.h
+  Version: 1.1
+*/
+
+#ifndef SENSOR_SET_H
+#define SENSOR_SET_H
+
+#include <Arduino.h>
+#include "Sensor_Guard.h"
+
+/**
+ * Placeholder for a sensor that is not compiled in, skipped by SensorSet
+*/
+struct NoSensor {};
+
+template <typename T>
+struct SensorTag {};
+
+template <typename T>
+class SensorSlot {
+public:
+  SensorSlot():
+    guard(T::name()),
+    enabled(false) {
+  }
+
+  bool begin() {
+    enabled = sensor.begin();
+    return enabled;
+  }
+
+  template <typename G>
+  bool acquire(G& sink) {
+    if (!enabled || !guard.acquire([this]() { return sensor.read(); })) return false;
+    sensor.emit(sink);
+    return true;
+  }
+
+  template <typename F>
+  void emit(F& sink) const {
+    if (guard.isAvailable()) sensor.emit(sink);
+  }
+
+  template <typename D>
+  void addAvailability(D& doc) const {
+    doc[T::name()] = guard.isAvailable() ? "online" : "offline";
+  }
+
+  T sensor;
+  SensorGuard guard;
+  bool enabled;
+};
+
+template <typename... Sensors>
+class SensorSet;
+
+template <>
+class SensorSet<> {
+public:
+  uint8_t begin() { return 0; }
+
+  template <typename G>
+  uint8_t acquireAll(G& sink) { return 0; }
+
+  template <typename F>
+  void emit(F& sink) const {}
+
+  template <typename D>
+  void addAvailability(D& doc) const {}
+
+  bool isChanged() const { return false; }
+
+  void markReported() {}
+
+protected:
+  void slot();  // Anchor for the using-declarations of the sensor levels
+};
+
+template <typename... Tail>
+class SensorSet<NoSensor, Tail...> : public SensorSet<Tail...> {};
+
+template <typename Head, typename... Tail>
+class SensorSet<Head, Tail...> : public SensorSet<Tail...> {
+  typedef SensorSet<Tail...> Next;
+
+public:
+  /**
+   * Start every sensor
+   * returns: uint8_t: number of sensors that started
+  */
+  uint8_t begin() {
+    uint8_t started = _slot.begin() ? 1 : 0;
+    return started + Next::begin();
+  }
+
+  /**
+   * Start one sensor, for boot stages that are supervised one sensor at a time
+   * returns: bool: true if the sensor started, it is skipped otherwise
+  */
+  template <typename T>
+  bool begin() {
+    return this->slot(SensorTag<T>()).begin();
+  }
+
+  /**
+   * Read every enabled sensor, values of the sensors that gave a valid reading are emitted into sink
+   * returns: uint8_t: number of valid readings
+  */
+  template <typename G>
+  uint8_t acquireAll(G& sink) {
+    uint8_t valid = _slot.acquire(sink) ? 1 : 0;
+    return valid + Next::acquireAll(sink);
+  }
+
+  /**
+   * Read one sensor, its values are emitted into sink if the reading was valid
+  */
+  template <typename T, typename G>
+  bool acquire(G& sink) {
+    return this->slot(SensorTag<T>()).acquire(sink);
+  }
+
+  /**
+   * Emit the last good values of every available sensor
+  */
+  template <typename F>
+  void emit(F& sink) const {
+    _slot.emit(sink);
+    Next::emit(sink);
+  }
+
+  /**
+   * Add "<name>": "online" | "offline" for every sensor
+  */
+  template <typename D>
+  void addAvailability(D& doc) const {
+    _slot.addAvailability(doc);
+    Next::addAvailability(doc);
+  }
+
+  /**
+   * True if the availability of any sensor changed since markReported()
+  */
+  bool isChanged() const {
+    return _slot.guard.isChanged() || Next::isChanged();
+  }
+
+  void markReported() {
+    _slot.guard.markReported();
+    Next::markReported();
+  }
+
+  template <typename T>
+  T& get() {
+    return this->slot(SensorTag<T>()).sensor;
+  }
+
+  template <typename T>
+  SensorGuard& getGuard() {
+    return this->slot(SensorTag<T>()).guard;
+  }
+
+  template <typename T>
+  bool isEnabled() {
+    return this->slot(SensorTag<T>()).enabled;
+  }
+
+protected:
+  SensorSlot<Head>& slot(SensorTag<Head>) { return _slot; }
+  using Next::slot;
+
+private:
+  SensorSlot<Head> _slot;
+};
+
+#endif // SENSOR_SET_H
@@ -0,0 +1,37 @@
+/*
+  Author: Ilari Mattsson
+  Library: Sensors
+  File: adafruit_sht31_sensor.h
+
+  SensorSet policy for the SHT31 with the Adafruit SHT31 library
+*/
+
+#ifndef SENSORS_ADAFRUIT_SHT31_SENSOR_H
+#define SENSORS_ADAFRUIT_SHT31_SENSOR_H
+
+#include <Adafruit_SHT31.h>
+#include "climate_values.h"
+
+template <uint8_t Address = SHT31_DEFAULT_ADDR>
+class AdafruitSht31Sensor : public ClimateValues {
+public:
+  static const char* name() {
+    return "sht";
+  }
+
+  bool begin() {
+    return _sht.begin(Address);
+  }
+
+  bool read() {
+    // One measurement for both values, readTemperature() and readHumidity() each start their own
+    float temperature, humidity;
+    if (!_sht.readBoth(&temperature, &humidity)) return false;
+    return store(temperature, humidity);
+  }
+
+private:
+  Adafruit_SHT31 _sht;
+};
+
+#endif // SENSORS_ADAFRUIT_SHT31_SENSOR_H
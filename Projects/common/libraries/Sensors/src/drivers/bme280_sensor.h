@@ -0,0 +1,56 @@
+/*
+  Author: Ilari Mattsson
+  Library: Sensors
+  File: bme280_sensor.h
+
+  SensorSet policy for the BME280 with the DFRobot BME280 library, pressure is emitted as "pres" in Pa
+*/
+
+#ifndef SENSORS_BME280_SENSOR_H
+#define SENSORS_BME280_SENSOR_H
+
+#include <Wire.h>
+#include <DFRobot_BME280.h>
+#include "climate_values.h"
+
+template <uint8_t Address = 0x76>
+class Bme280Sensor : public ClimateValues {
+public:
+  Bme280Sensor():
+    _bme(&Wire, Address),
+    _pressure(0) {
+  }
+
+  static const char* name() {
+    return "bme";
+  }
+
+  bool begin() {
+    return _bme.begin() == DFRobot_BME280::eStatusOK;
+  }
+
+  bool read() {
+    float temperature = _bme.getTemperature();
+    float humidity = _bme.getHumidity();
+    uint32_t pressure = _bme.getPressure();
+    if (_bme.lastOperateStatus != DFRobot_BME280::eStatusOK || !store(temperature, humidity)) return false;
+    _pressure = pressure;
+    return true;
+  }
+
+  uint32_t getPressure() const {
+    return _pressure;
+  }
+
+  template <typename F>
+  void emit(F& sink) const {
+    ClimateValues::emit(sink);
+    sink.set("pres", _pressure, 0);
+  }
+
+private:
+  DFRobot_BME280_IIC _bme;
+  uint32_t _pressure;
+};
+
+#endif // SENSORS_BME280_SENSOR_H
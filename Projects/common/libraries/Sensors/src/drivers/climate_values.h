@@ -0,0 +1,76 @@
+/*
+  Author: Ilari Mattsson
+  Library: Sensors
+  File: climate_values.h
+
+  Temperature and humidity shared by the climate sensor policies. Offsets are added when a reading is
+  stored, keys default to "temp" and "hum".
+*/
+
+#ifndef SENSORS_CLIMATE_VALUES_H
+#define SENSORS_CLIMATE_VALUES_H
+
+#include <Arduino.h>
+
+class ClimateValues {
+public:
+  ClimateValues():
+    _temperature(0),
+    _humidity(0),
+    _temperatureOffset(0),
+    _humidityOffset(0),
+    _temperatureKey("temp"),
+    _humidityKey("hum") {
+  }
+
+  /**
+   * Payload keys, not copied
+  */
+  void setKeys(const char* temperatureKey, const char* humidityKey) {
+    _temperatureKey = temperatureKey;
+    _humidityKey = humidityKey;
+  }
+
+  /**
+   * Calibration offsets in °C and %, added to the following readings
+  */
+  void setOffsets(float temperature, float humidity) {
+    _temperatureOffset = temperature;
+    _humidityOffset = humidity;
+  }
+
+  float getTemperature() const {
+    return _temperature;
+  }
+
+  float getHumidity() const {
+    return _humidity;
+  }
+
+  template <typename F>
+  void emit(F& sink) const {
+    sink.set(_temperatureKey, _temperature, 2);
+    sink.set(_humidityKey, _humidity, 2);
+  }
+
+protected:
+  /**
+   * Store a reading with offsets, NaN values are rejected and the previous values are kept
+  */
+  bool store(float temperature, float humidity) {
+    if (isnan(temperature) || isnan(humidity)) return false;
+    _temperature = temperature + _temperatureOffset;
+    _humidity = humidity + _humidityOffset;
+    return true;
+  }
+
+private:
+  float _temperature;
+  float _humidity;
+  float _temperatureOffset;
+  float _humidityOffset;
+  const char* _temperatureKey;
+  const char* _humidityKey;
+};
+
+#endif // SENSORS_CLIMATE_VALUES_H
@@ -0,0 +1,40 @@
+/*
+  Author: Ilari Mattsson
+  Library: Sensors
+  File: dht22_sensor.h
+
+  SensorSet policy for the DHT22 with the Adafruit DHT sensor library
+*/
+
+#ifndef SENSORS_DHT22_SENSOR_H
+#define SENSORS_DHT22_SENSOR_H
+
+#include <DHT.h>
+#include "climate_values.h"
+
+template <uint8_t Pin>
+class Dht22Sensor : public ClimateValues {
+public:
+  Dht22Sensor():
+    _dht(Pin, DHT22) {
+  }
+
+  static const char* name() {
+    return "dht";
+  }
+
+  bool begin() {
+    // No presence check in the library, a missing sensor shows up as failed reads
+    _dht.begin();
+    return true;
+  }
+
+  bool read() {
+    return store(_dht.readTemperature(), _dht.readHumidity());
+  }
+
+private:
+  DHT _dht;
+};
+
+#endif // SENSORS_DHT22_SENSOR_H
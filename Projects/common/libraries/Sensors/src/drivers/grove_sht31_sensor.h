@@ -0,0 +1,34 @@
+/*
+  Author: Ilari Mattsson
+  Library: Sensors
+  File: grove_sht31_sensor.h
+
+  SensorSet policy for the SHT31 with the Seeed Grove SHT31 library (SHT31.h)
+*/
+
+#ifndef SENSORS_GROVE_SHT31_SENSOR_H
+#define SENSORS_GROVE_SHT31_SENSOR_H
+
+#include <SHT31.h>
+#include "climate_values.h"
+
+template <uint8_t Address = 0x44>
+class GroveSht31Sensor : public ClimateValues {
+public:
+  static const char* name() {
+    return "sht";
+  }
+
+  bool begin() {
+    return _sht.begin(Address);
+  }
+
+  bool read() {
+    return store(_sht.getTemperature(), _sht.getHumidity());
+  }
+
+private:
+  SHT31 _sht;
+};
+
+#endif // SENSORS_GROVE_SHT31_SENSOR_H
@@ -0,0 +1,50 @@
+/*
+  Author: Ilari Mattsson
+  Library: Sensors
+  File: si1151_sensor.h
+
+  SensorSet policy for the Si1151 with the Grove Sunlight Sensor library, visible light is emitted as "sun"
+*/
+
+#ifndef SENSORS_SI1151_SENSOR_H
+#define SENSORS_SI1151_SENSOR_H
+
+#include <Si115X.h>
+
+class Si1151Sensor {
+public:
+  Si1151Sensor():
+    _visible(0) {
+  }
+
+  static const char* name() {
+    return "sun";
+  }
+
+  bool begin() {
+    return _si1151.Begin();
+  }
+
+  bool read() {
+    // ReadVisible() is an integer, a missing sensor reads back as all ones
+    uint16_t visible = _si1151.ReadVisible();
+    if (visible == 0xFFFF) return false;
+    _visible = visible;
+    return true;
+  }
+
+  uint16_t getVisible() const {
+    return _visible;
+  }
+
+  template <typename F>
+  void emit(F& sink) const {
+    sink.set("sun", _visible, 0);
+  }
+
+private:
+  Si115X _si1151;
+  uint16_t _visible;
+};
+
+#endif // SENSORS_SI1151_SENSOR_H
@@ -0,0 +1,130 @@
+/*
+  Author: Ilari Mattsson
+  Library: Supervisor
+  File: Supervisor.cpp
+  Version: 1.0
+*/
+
+#include "Supervisor.h"
+#include <Arduino.h>
+#include <Adafruit_SleepyDog.h>
+
+typedef struct supervisor_record {
+  uint32_t magic;
+  uint32_t boots;
+  uint16_t crashes;
+  uint8_t stage;       // Stage running now
+  uint8_t crashStage;  // Stage running at the last crash
+  uint32_t checksum;   // Sum of the preceding words, detects RAM contents left after power loss
+} sup_record;
+
+// Not cleared by the startup code, survives watchdog and system resets
+static sup_record supervisorRecord __attribute__((section(".noinit")));
+
+static uint32_t recordChecksum(const sup_record& record) {
+  return record.magic + record.boots + ((uint32_t)record.crashes << 16 | record.stage << 8 | record.crashStage) + 1;
+}
+
+
+Supervisor::Supervisor():
+  _resetCause(0) {
+}
+
+// ================================ Class public methods ========================================
+
+void Supervisor::begin() {
+  _resetCause = Watchdog.resetCause();
+
+  sup_record& record = supervisorRecord;
+  if (record.magic != SUPERVISOR_MAGIC || record.checksum != recordChecksum(record) || (_resetCause & SUPERVISOR_RCAUSE_POR)) {
+    record.magic = SUPERVISOR_MAGIC;
+    record.boots = 0;
+    record.crashes = 0;
+    record.stage = SUPERVISOR_STAGE_RUN;
+    record.crashStage = SUPERVISOR_STAGE_RUN;
+  }
+  if (_resetCause & (SUPERVISOR_RCAUSE_WDT | SUPERVISOR_RCAUSE_SYST)) {
+    // Crashes are only counted in a row for the same stage
+    if (record.crashStage != record.stage) record.crashes = 0;
+    if (record.crashes < UINT16_MAX) record.crashes++;
+    record.crashStage = record.stage;
+  }
+  record.boots++;
+  record.stage = SUPERVISOR_STAGE_RUN;
+  commit();
+
+  resume();
+}
+
+void Supervisor::kick() {
+  #ifdef SENSORS_WATCHDOG
+  Watchdog.reset();
+  #endif
+}
+
+void Supervisor::pause() {
+  #ifdef SENSORS_WATCHDOG
+  Watchdog.disable();
+  #endif
+}
+
+void Supervisor::resume() {
+  #ifdef SENSORS_WATCHDOG
+  Watchdog.enable(SUPERVISOR_WDT_TIMEOUT);
+  #endif
+}
+
+void Supervisor::setStage(uint8_t stage) {
+  supervisorRecord.stage = stage;
+  commit();
+}
+
+bool Supervisor::isSuspect(uint8_t stage) const {
+  if (stage == SUPERVISOR_STAGE_RUN) return false;
+  return supervisorRecord.crashStage == stage && supervisorRecord.crashes >= SUPERVISOR_MAX_CRASHES;
+}
+
+void Supervisor::markHealthy() {
+  if (supervisorRecord.crashes == 0) return;
+  supervisorRecord.crashes = 0;
+  commit();
+}
+
+const char* Supervisor::getResetReason() const {
+  if (_resetCause & SUPERVISOR_RCAUSE_WDT) return "watchdog";
+  if (_resetCause & SUPERVISOR_RCAUSE_SYST) return "system";
+  if (_resetCause & (SUPERVISOR_RCAUSE_BOD12 | SUPERVISOR_RCAUSE_BOD33)) return "brownout";
+  if (_resetCause & SUPERVISOR_RCAUSE_EXT) return "external";
+  if (_resetCause & SUPERVISOR_RCAUSE_POR) return "power";
+  return "unknown";
+}
+
+uint8_t Supervisor::getResetCause() const {
+  return _resetCause;
+}
+
+uint32_t Supervisor::getBootCount() const {
+  return supervisorRecord.boots;
+}
+
+uint16_t Supervisor::getCrashCount() const {
+  return supervisorRecord.crashes;
+}
+
+uint8_t Supervisor::getCrashStage() const {
+  return supervisorRecord.crashStage;
+}
+
+// ================================ Class private methods ========================================
+
+void Supervisor::sleep(uint32_t ms) {
+  uint32_t start = millis();
+  while (millis() - start < ms) {
+    kick();
+    delay(10);
+  }
+}
+
+void Supervisor::commit() {
+  supervisorRecord.checksum = recordChecksum(supervisorRecord);
+}
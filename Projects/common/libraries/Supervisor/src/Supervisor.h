@@ -0,0 +1,136 @@
+/*
+  Boot supervisor for SAMD21 boards.
+  Keeps a node running when parts of it fail, instead of stopping in while(1) loops.
+
+  > Implements:
+    - Hardware watchdog (SAMD21 WDT through Adafruit SleepyDog) with SENSORS_WATCHDOG
+    - Reset reason, boot counter and crash counter kept in .noinit RAM over resets
+    - Stage markers: the stage running when the watchdog fired is remembered, a subsystem whose
+      stage crashed SUPERVISOR_MAX_CRASHES times in a row is skipped on the next boots (degraded mode)
+    - Subsystem initialization retries with exponential backoff, the watchdog is kicked while waiting
+
+  .noinit RAM is not cleared by the startup code, the record is validated with a magic and a checksum
+  and is reset after power loss.
+
+  Author: Ilari Mattsson
+  Library: Supervisor
+  File: Supervisor.h
+  Version: 1.0
+*/
+
+#ifndef SUPERVISOR_H
+#define SUPERVISOR_H
+
+#include <Arduino.h>
+
+#define SUPERVISOR_VERSION "1.0"
+
+#ifndef SUPERVISOR_WDT_TIMEOUT
+#define SUPERVISOR_WDT_TIMEOUT 16000   // ms, SAMD21 WDT maximum
+#endif
+#ifndef SUPERVISOR_MAX_CRASHES
+#define SUPERVISOR_MAX_CRASHES 2       // Crashes in the same stage before it is skipped
+#endif
+#ifndef SUPERVISOR_RETRY_ATTEMPTS
+#define SUPERVISOR_RETRY_ATTEMPTS 4    // Initialization attempts per subsystem
+#endif
+#ifndef SUPERVISOR_RETRY_DELAY
+#define SUPERVISOR_RETRY_DELAY 500     // ms before the second attempt, doubled after each failure
+#endif
+
+#define SUPERVISOR_MAGIC 0x53555031    // "SUP1", change when the record layout changes
+#define SUPERVISOR_STAGE_RUN 0         // Normal operation, never skipped
+
+// PM->RCAUSE bits
+#define SUPERVISOR_RCAUSE_POR 0x01
+#define SUPERVISOR_RCAUSE_BOD12 0x02
+#define SUPERVISOR_RCAUSE_BOD33 0x04
+#define SUPERVISOR_RCAUSE_EXT 0x10
+#define SUPERVISOR_RCAUSE_WDT 0x20
+#define SUPERVISOR_RCAUSE_SYST 0x40
+
+class Supervisor {
+public:
+  Supervisor();
+
+  /**
+   * Read the reset cause, update the counters and start the watchdog (SENSORS_WATCHDOG).
+   * Call first in setup().
+  */
+  void begin();
+
+  /**
+   * Reset the watchdog
+  */
+  void kick();
+
+  /**
+   * Stop the watchdog, e.g. before standby sleep. The WDT keeps counting in standby.
+  */
+  void pause();
+
+  /**
+   * Restart the watchdog after pause()
+  */
+  void resume();
+
+  /**
+   * Mark the running stage, the last stage before a watchdog reset is blamed for the crash
+  */
+  void setStage(uint8_t stage);
+
+  /**
+   * True if stage crashed SUPERVISOR_MAX_CRASHES boots in a row and should be skipped
+  */
+  bool isSuspect(uint8_t stage) const;
+
+  /**
+   * Call after a successful cycle, clears the crash counter
+  */
+  void markHealthy();
+
+  /**
+   * Run init until it returns true, up to SUPERVISOR_RETRY_ATTEMPTS times with exponential backoff.
+   * params:
+   *   F init: callable returning bool, true when the subsystem is up
+   * returns: bool: false if every attempt failed, continue without the subsystem
+  */
+  template <typename F>
+  bool retry(F init) {
+    uint32_t wait = SUPERVISOR_RETRY_DELAY;
+    for (uint8_t i = 0; i < SUPERVISOR_RETRY_ATTEMPTS; i++) {
+      if (init()) return true;
+      if (i + 1 < SUPERVISOR_RETRY_ATTEMPTS) sleep(wait);
+      wait *= 2;
+    }
+    return false;
+  }
+
+  /**
+   * Short name of the last reset cause: "power", "brownout", "external", "watchdog", "system", "unknown"
+  */
+  const char* getResetReason() const;
+
+  uint8_t getResetCause() const;
+
+  uint32_t getBootCount() const;
+
+  /**
+   * Watchdog and system resets since the last markHealthy()
+  */
+  uint16_t getCrashCount() const;
+
+  /**
+   * Stage that was running at the last crash
+  */
+  uint8_t getCrashStage() const;
+
+private:
+  void sleep(uint32_t ms);
+
+  void commit();
+
+  uint8_t _resetCause;
+};
+
+#endif // SUPERVISOR_H
@@ -0,0 +1,92 @@
+/*
+  Author: Ilari Mattsson
+  Library: Task Scheduler
+  File: Task_Scheduler.cpp
+  Version: 1.1
+*/
+
+#include "Task_Scheduler.h"
+#include <Arduino.h>
+
+
+TaskScheduler::TaskScheduler():
+  _count(0),
+  _idleSleep(true) {
+}
+
+// ================================ Class public methods ========================================
+
+int8_t TaskScheduler::addTask(task_callback callback, uint32_t period, uint32_t offset) {
+  if (_count >= SCHEDULER_MAX_TASKS || callback == NULL) return -1;
+
+  _tasks[_count] = { callback, period, (uint32_t)(millis() + offset), true };
+  return _count++;
+}
+
+void TaskScheduler::setEnabled(int8_t id, bool enabled) {
+  if (!isValid(id)) return;
+  setEnabled(id, enabled, _tasks[id].period);
+}
+
+void TaskScheduler::setEnabled(int8_t id, bool enabled, uint32_t offset) {
+  if (!isValid(id)) return;
+  if (enabled && !_tasks[id].enabled) _tasks[id].deadline = millis() + offset;
+  _tasks[id].enabled = enabled;
+}
+
+void TaskScheduler::setPeriod(int8_t id, uint32_t period) {
+  if (!isValid(id)) return;
+  _tasks[id].period = period;
+}
+
+void TaskScheduler::runNow(int8_t id) {
+  if (!isValid(id)) return;
+  _tasks[id].deadline = millis();
+}
+
+int32_t TaskScheduler::timeUntil(int8_t id) const {
+  if (!isValid(id) || !_tasks[id].enabled) return INT32_MAX;
+  return (int32_t)(_tasks[id].deadline - millis());
+}
+
+void TaskScheduler::advance(uint32_t ms) {
+  for (uint8_t i = 0; i < _count; i++) _tasks[i].deadline -= ms;
+}
+
+void TaskScheduler::setIdleSleep(bool sleep) {
+  _idleSleep = sleep;
+}
+
+uint32_t TaskScheduler::run() {
+  uint32_t now = millis();
+  uint32_t next = UINT32_MAX;
+
+  for (uint8_t i = 0; i < _count; i++) {
+    sched_task* t = &_tasks[i];
+    if (!t->enabled) continue;
+
+    // Signed difference keeps deadline checks valid across millis() overflow
+    if ((int32_t)(now - t->deadline) >= 0) {
+      // Advance by whole periods to avoid drift, skip runs that were missed entirely
+      t->deadline += t->period;
+      if ((int32_t)(now - t->deadline) >= 0) t->deadline = now + t->period;
+      t->callback();
+      now = millis();
+    }
+
+    uint32_t remaining = (int32_t)(t->deadline - now) > 0 ? t->deadline - now : 0;
+    if (remaining < next) next = remaining;
+  }
+
+  #if defined(ARDUINO_ARCH_SAMD)
+  if (_idleSleep && next > 0) __WFI();
+  #endif
+
+  return next;
+}
+
+// ================================ Class private methods ========================================
+
+bool TaskScheduler::isValid(int8_t id) const {
+  return id >= 0 && id < _count;
+}
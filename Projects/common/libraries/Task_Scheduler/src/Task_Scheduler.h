@@ -0,0 +1,97 @@
+/*
+  Cooperative task scheduler for Arduino boards.
+  Runs callbacks on fixed periods from loop() using millis() deadlines.
+  The task table is statically sized, no heap memory is used.
+
+  > Implements:
+    - Fixed-size task table (SCHEDULER_MAX_TASKS)
+    - Per-task period and deadline, drift-free rescheduling
+    - Enabling/disabling tasks and changing periods at runtime, re-enabled tasks keep a given phase
+    - Sleeping the CPU (WFI) until the next interrupt when no task is due
+
+  Author: Ilari Mattsson
+  Library: Task Scheduler
+  File: Task_Scheduler.h
+  Version: 1.1
+*/
+
+#ifndef TASK_SCHEDULER_H
+#define TASK_SCHEDULER_H
+
+#include <Arduino.h>
+
+#define TASK_SCHEDULER_VERSION "1.1"
+
+#ifndef SCHEDULER_MAX_TASKS
+#define SCHEDULER_MAX_TASKS 8
+#endif
+
+typedef void (*task_callback)();
+
+typedef struct scheduler_task {
+  task_callback callback;
+  uint32_t period;    // ms between runs
+  uint32_t deadline;  // millis() value of the next run
+  bool enabled;
+} sched_task;
+
+class TaskScheduler {
+public:
+  TaskScheduler();
+
+  /**
+   * Add a task running every period ms, first run after offset ms.
+   * Returns task id, or -1 when the task table is full.
+  */
+  int8_t addTask(task_callback callback, uint32_t period, uint32_t offset = 0);
+
+  /**
+   * Enable or disable a task. Enabled tasks are due after one period.
+  */
+  void setEnabled(int8_t id, bool enabled);
+
+  /**
+   * Enable or disable a task. An enabled task is due after offset ms, e.g. to keep it ahead of
+   * another task by the same lead as addTask() did.
+  */
+  void setEnabled(int8_t id, bool enabled, uint32_t offset);
+
+  /**
+   * Change task period, takes effect after the next run.
+  */
+  void setPeriod(int8_t id, uint32_t period);
+
+  /**
+   * Make task due on the next run() call.
+  */
+  void runNow(int8_t id);
+
+  /**
+   * Get ms until the task is due, negative when overdue. INT32_MAX for invalid or disabled tasks.
+  */
+  int32_t timeUntil(int8_t id) const;
+
+  /**
+   * Move all deadlines ms earlier, e.g. after deep sleep stopped millis() from counting.
+  */
+  void advance(uint32_t ms);
+
+  /**
+   * Sleep the CPU between deadlines, default true. Wakes up on any interrupt (SysTick every 1 ms).
+  */
+  void setIdleSleep(bool sleep);
+
+  /**
+   * Run all due tasks. Call from loop(). Returns ms until the next deadline.
+  */
+  uint32_t run();
+
+private:
+  bool isValid(int8_t id) const;
+
+  sched_task _tasks[SCHEDULER_MAX_TASKS];
+  uint8_t _count;
+  bool _idleSleep;
+};
+
+#endif // TASK_SCHEDULER_H
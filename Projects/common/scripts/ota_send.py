@@ -0,0 +1,135 @@
+"""
+  Firmware upload over MQTT for nodes built with MQTTU_OTA (Mqtt_Utility).
+  Streams a PlatformIO firmware.bin to homeassistant/sensor/<node>/ota in chunks, each chunk waits for
+  its acknowledgement on .../ota/status, so the node never has more than one chunk in flight.
+
+  Usage:
+    pip install paho-mqtt
+    python ota_send.py --host 192.168.1.10 --user mqtt --password secret greenA .pio/build/mkrwifi1010/firmware.bin
+
+  A lost chunk or acknowledgement is resent, the node answers a chunk at an unexpected offset with the
+  offset it expects and the upload resumes there. If the final "applying" status is lost, the update
+  still counts as applied when the node reboots and publishes its availability again.
+
+  Author: Ilari Mattsson
+  File: ota_send.py
+  Version: 1.1
+"""
+
+import argparse
+import json
+import queue
+import struct
+import sys
+import zlib
+
+import paho.mqtt.client as mqtt
+
+PREFIX = "homeassistant/sensor/"
+ACK_TIMEOUT = 10     # s to wait for a status message
+RETRIES = 5          # Resends of one chunk before giving up
+REBOOT_TIMEOUT = 90  # s to wait for the node's availability after the image is applied
+
+
+def wait_status(statuses, timeout=ACK_TIMEOUT):
+    try:
+        return statuses.get(timeout=timeout)
+    except queue.Empty:
+        return None
+
+
+def wait_reboot(availability, timeout=REBOOT_TIMEOUT):
+    """True when the node publishes availability again, it does so once after every boot"""
+    try:
+        availability.get(timeout=timeout)
+        return True
+    except queue.Empty:
+        return False
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Upload firmware to an MQTTU_OTA node")
+    parser.add_argument("node", help="device id, e.g. greenA")
+    parser.add_argument("firmware", help="firmware.bin")
+    parser.add_argument("--host", required=True)
+    parser.add_argument("--port", type=int, default=1883)
+    parser.add_argument("--user")
+    parser.add_argument("--password")
+    args = parser.parse_args()
+
+    with open(args.firmware, "rb") as f:
+        image = f.read()
+    crc = zlib.crc32(image) & 0xFFFFFFFF
+    topic = PREFIX + args.node + "/ota"
+    avty_topic = PREFIX + args.node + "/avty"
+    statuses = queue.Queue()
+    availability = queue.Queue()
+    watch_avty = [False]  # Retained availability arrives on subscribe, only messages after "E" count
+
+    def on_message(client, userdata, msg):
+        if msg.topic == avty_topic:
+            if watch_avty[0]:
+                availability.put(msg.payload)
+            return
+        statuses.put(json.loads(msg.payload))
+
+    if hasattr(mqtt, "CallbackAPIVersion"):
+        client = mqtt.Client(mqtt.CallbackAPIVersion.VERSION1)
+    else:
+        client = mqtt.Client()
+    if args.user:
+        client.username_pw_set(args.user, args.password)
+    client.on_message = on_message
+    client.connect(args.host, args.port)
+    client.subscribe(topic + "/status", 1)
+    client.subscribe(avty_topic, 1)
+    client.loop_start()
+
+    print("%s: %d bytes, crc %08x" % (args.firmware, len(image), crc))
+    client.publish(topic, b"B" + struct.pack("<II", len(image), crc), qos=1)
+    status = wait_status(statuses)
+    if status is None or status.get("state") != "receiving":
+        sys.exit("Node did not start the update: %s" % status)
+    chunk = int(status.get("chunk", 512))
+
+    offset = 0
+    retries = 0
+    while offset < len(image):
+        client.publish(topic, b"D" + struct.pack("<I", offset) + image[offset:offset + chunk], qos=1)
+        status = wait_status(statuses)
+        if status is not None and status.get("state") == "failed":
+            sys.exit("Update failed: %s" % status.get("error"))
+        if status is None or status.get("offset") == offset:
+            retries += 1
+            if retries > RETRIES:
+                sys.exit("No acknowledgement at offset %d" % offset)
+            continue
+        retries = 0
+        offset = int(status["offset"])
+        print("\r%3d %%" % (100 * offset // len(image)), end="", flush=True)
+    print()
+
+    watch_avty[0] = True
+    client.publish(topic, b"E", qos=1)
+    # Late acknowledgements of resent chunks may still be queued
+    status = wait_status(statuses)
+    while status is not None and status.get("state") == "receiving":
+        status = wait_status(statuses)
+    if status is not None and status.get("state") == "applying":
+        client.loop_stop()
+        print("Applied, node resets into the new firmware")
+        return
+    if status is not None:
+        client.loop_stop()
+        sys.exit("Image was not applied: %s" % status)
+    # No status: the node may have reset before its last message went out
+    print("No status after the upload, waiting for the node to come back")
+    rebooted = wait_reboot(availability)
+    client.loop_stop()
+    if not rebooted:
+        sys.exit("Image was not applied: no status and no availability from the node")
+    print("Node is back online after the update")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,359 @@
+"""
+  PlatformIO extra script: flash and RAM budget report.
+  Add to an env in platformio.ini:
+    extra_scripts = post:../common/scripts/size_report.py
+
+  > Implements:
+    - Linker map (-Wl,-Map) and per-function stack usage (-fstack-usage) for every build
+    - After each link: flash/RAM totals, per-library and per-symbol size breakdowns and the worst-case
+      stack depth of the setup() and loop() call chains, written to size_reports/<env>.txt
+    - One line per build appended to size_reports/<env>.csv (time, git revision, build flags, totals),
+      compare builds with git diff or a spreadsheet
+    - pio run -e <env> -t size_report prints the last report
+    - Flash budget of the Flash_Layout map: the build fails when the image reaches the record rows,
+      with MQTTU_OTA when it does not fit in the sketch area (half of the flash below the rows)
+
+  Stack depth is static: frames from the .su files, calls from the disassembly (bl and tail calls).
+  Indirect calls (virtual methods, callbacks, ISRs) are not followed and are listed. Frames of functions
+  with dynamic stack use (VLAs, alloca) are their fixed part only and are flagged.
+  Run-time peaks (heap, stack) are published with MQTTU_DIAGNOSTICS as "hpk" and "spk".
+
+  Author: Ilari Mattsson
+  File: size_report.py
+  Version: 1.1
+"""
+
+import csv
+import datetime
+import os
+import re
+import subprocess
+from collections import defaultdict
+
+Import("env", "projenv")
+
+TOP_SYMBOLS = 25
+STACK_ROOTS = ("setup", "loop")
+
+FLASH_SECTIONS = (".text", ".rodata", ".ARM.exidx", ".ARM.extab", ".relocate", ".data")
+RAM_SECTIONS = (".relocate", ".data", ".bss", "COMMON")
+
+FLASH_RECORD_BYTES = 4 * 256  # FLASH_RECORD_ROWS * FLASH_ROW_SIZE in Flash_Layout.h
+FLASH_ROW_BYTES = 256
+
+for e in (env, projenv):
+    e.Append(CCFLAGS=["-fstack-usage"])
+env.Append(LINKFLAGS=["-Wl,-Map,${BUILD_DIR}/${PROGNAME}.map"])
+
+
+def tool(name):
+    # CC is e.g. arm-none-eabi-gcc, binutils share its prefix
+    cc = env.subst("$CC")
+    return cc[: -len("gcc")] + name if cc.endswith("gcc") else name
+
+
+def run(args):
+    return subprocess.run(args, stdout=subprocess.PIPE, stderr=subprocess.DEVNULL,
+                          universal_newlines=True, check=True).stdout
+
+
+def is_section(name, prefixes):
+    return any(name == p or name.startswith(p + ".") for p in prefixes)
+
+
+# ================================ Section totals ========================================
+
+def section_totals(elf):
+    flash = ram = 0
+    for line in run([tool("size"), "-A", elf]).splitlines():
+        parts = line.split()
+        if len(parts) != 3 or not parts[1].isdigit():
+            continue
+        name, size = parts[0], int(parts[1])
+        if is_section(name, FLASH_SECTIONS):
+            flash += size
+        if is_section(name, RAM_SECTIONS):
+            ram += size
+    return flash, ram
+
+
+# ================================ Per-library sizes ========================================
+
+def library_of(path):
+    """libWiFiNINA.a(WiFi.cpp.o) -> WiFiNINA, .pio/build/env/src/main.cpp.o -> src"""
+    m = re.search(r"lib([^/\\]+)\.a\(", path)
+    if m:
+        return m.group(1)
+    parts = re.split(r"[/\\]", path)
+    return parts[-2] if len(parts) > 1 else path
+
+
+def library_sizes(map_file):
+    flash = defaultdict(int)
+    ram = defaultdict(int)
+    in_map = False
+    section = None
+    entry = re.compile(r"^\s(\.\S+|COMMON)?\s+0x([0-9a-f]+)\s+0x([0-9a-f]+)\s+(\S.*)$")
+    with open(map_file) as f:
+        for line in f:
+            if line.startswith("Linker script and memory map"):
+                in_map = True
+                continue
+            if not in_map:
+                continue
+            # Long input section names are printed on a line of their own
+            name_only = re.match(r"^\s(\.\S+|COMMON)\s*$", line)
+            if name_only:
+                section = name_only.group(1)
+                continue
+            m = entry.match(line)
+            if not m:
+                if not line.startswith(" "):
+                    section = None
+                continue
+            name = m.group(1) or section
+            section = None
+            size = int(m.group(3), 16)
+            if name is None or size == 0 or int(m.group(2), 16) == 0:
+                continue
+            lib = library_of(m.group(4).strip())
+            if is_section(name, FLASH_SECTIONS):
+                flash[lib] += size
+            if is_section(name, RAM_SECTIONS):
+                ram[lib] += size
+    return flash, ram
+
+
+# ================================ Per-symbol sizes ========================================
+
+def symbol_sizes(elf):
+    flash, ram = [], []
+    for line in run([tool("nm"), "-S", "-C", "--size-sort", elf]).splitlines():
+        parts = line.split(None, 3)
+        if len(parts) != 4:
+            continue
+        size, kind, name = int(parts[1], 16), parts[2].lower(), parts[3]
+        # Initialized data takes both, it is listed with RAM
+        if kind in ("t", "w", "r"):
+            flash.append((size, name))
+        elif kind in ("d", "b", "v"):
+            ram.append((size, name))
+    flash.sort(reverse=True)
+    ram.sort(reverse=True)
+    return flash[:TOP_SYMBOLS], ram[:TOP_SYMBOLS]
+
+
+# ================================ Stack depth ========================================
+
+def strip_templates(name):
+    prev = None
+    while prev != name:
+        prev = name
+        name = re.sub(r"<[^<>]*>", "", name)
+    return name
+
+
+def function_key(name):
+    """Comparable key for .su and disassembly names: qualified name without return type,
+    template and function arguments. Overloads share a key, the largest frame is used."""
+    name = name.split(" [with ")[0]
+    name = strip_templates(name)
+    name = name.split("(")[0].strip()
+    return name.split(" ")[-1] if name else name
+
+
+def stack_frames(build_dir):
+    frames = {}
+    dynamic = set()
+    for root, _, files in os.walk(build_dir):
+        for file in files:
+            if not file.endswith(".su"):
+                continue
+            with open(os.path.join(root, file)) as f:
+                for line in f:
+                    parts = line.rstrip("\n").split("\t")
+                    if len(parts) != 3:
+                        continue
+                    # file:line:column:name
+                    key = function_key(parts[0].split(":", 3)[-1])
+                    frames[key] = max(frames.get(key, 0), int(parts[1]))
+                    if parts[2].startswith("dynamic"):
+                        dynamic.add(key)
+    return frames, dynamic
+
+
+def call_graph(elf):
+    calls = defaultdict(set)
+    indirect = set()
+    current = None
+    header = re.compile(r"^[0-9a-f]+ <(.+)>:$")
+    branch = re.compile(r"\s(bl|b|b\.n|b\.w)\s+[0-9a-f]+ <(.+)>$")  # Template names hold <>
+    for line in run([tool("objdump"), "-d", "-C", elf]).splitlines():
+        m = header.match(line)
+        if m:
+            current = function_key(m.group(1))
+            continue
+        if current is None:
+            continue
+        m = branch.search(line)
+        if m:
+            target = m.group(2)
+            # Branches into a function body are local jumps, calls and tail calls go to an entry
+            if "+0x" not in target:
+                callee = function_key(target)
+                if callee != current:
+                    calls[current].add(callee)
+        elif re.search(r"\sblx\s+r\d", line):
+            indirect.add(current)
+    return calls, indirect
+
+
+def worst_chain(root, frames, calls):
+    """Deepest call chain from root: (bytes, [functions]). Recursion is cut at the repeated call."""
+    memo = {}
+
+    def depth(fn, active):
+        if fn in memo:
+            return memo[fn]
+        active.add(fn)
+        best = (0, [])
+        for callee in calls.get(fn, ()):
+            if callee in active:
+                continue
+            sub = depth(callee, active)
+            if sub[0] > best[0]:
+                best = sub
+        active.discard(fn)
+        result = (frames.get(fn, 0) + best[0], [fn] + best[1])
+        memo[fn] = result
+        return result
+
+    return depth(root, set())
+
+
+# ================================ Report ========================================
+
+def git_revision(path):
+    try:
+        rev = run(["git", "-C", path, "rev-parse", "--short", "HEAD"]).strip()
+        dirty = run(["git", "-C", path, "status", "--porcelain", "--", "."]).strip()
+        return rev + ("+" if dirty else "")
+    except (OSError, subprocess.CalledProcessError):
+        return "-"
+
+
+def flash_budget(max_flash, build_flags):
+    """Largest image for the Flash_Layout map, 0 if the board size is unknown"""
+    if not max_flash:
+        return 0
+    budget = max_flash - FLASH_RECORD_BYTES
+    if "MQTTU_OTA" in build_flags:
+        budget = budget // 2 // FLASH_ROW_BYTES * FLASH_ROW_BYTES
+    return budget
+
+
+def percent(used, total):
+    return " (%.1f %% of %d)" % (100.0 * used / total, total) if total else ""
+
+
+def write_report(target, source, env):
+    elf = str(source[0])
+    build_dir = env.subst("$BUILD_DIR")
+    map_file = env.subst("$BUILD_DIR/${PROGNAME}.map")
+    project_dir = env.subst("$PROJECT_DIR")
+    env_name = env.subst("$PIOENV")
+    board = env.BoardConfig()
+    max_flash = int(board.get("upload.maximum_size", 0))
+    max_ram = int(board.get("upload.maximum_ram_size", 0))
+
+    build_flags = " ".join(env.subst("$BUILD_FLAGS").split())
+    budget = flash_budget(max_flash, build_flags)
+
+    flash, ram = section_totals(elf)
+    lib_flash, lib_ram = library_sizes(map_file) if os.path.isfile(map_file) else ({}, {})
+    sym_flash, sym_ram = symbol_sizes(elf)
+    frames, dynamic = stack_frames(build_dir)
+    calls, indirect = call_graph(elf)
+
+    lines = []
+    lines.append("Size report %s, %s" % (env_name, git_revision(project_dir)))
+    lines.append("Build flags: %s" % build_flags)
+    lines.append("")
+    lines.append("Flash: %d B%s" % (flash, percent(flash, max_flash)))
+    if budget:
+        lines.append("Flash budget: %d B%s, %s" % (flash, percent(flash, budget),
+                     "sketch area with MQTTU_OTA" if "MQTTU_OTA" in build_flags else "below the record rows"))
+    lines.append("RAM:   %d B%s, static data only, heap and stack use the rest" % (ram, percent(ram, max_ram)))
+
+    lines.append("")
+    lines.append("%-32s %8s %8s" % ("Library", "Flash", "RAM"))
+    for lib in sorted(set(lib_flash) | set(lib_ram), key=lambda l: -(lib_flash.get(l, 0) + lib_ram.get(l, 0))):
+        lines.append("%-32s %8d %8d" % (lib, lib_flash.get(lib, 0), lib_ram.get(lib, 0)))
+
+    for title, symbols in (("Largest flash symbols", sym_flash), ("Largest RAM symbols", sym_ram)):
+        lines.append("")
+        lines.append(title)
+        for size, name in symbols:
+            lines.append("%8d  %s" % (size, name))
+
+    stack = {}
+    for root in STACK_ROOTS:
+        total, chain = worst_chain(root, frames, calls)
+        stack[root] = total
+        lines.append("")
+        lines.append("Stack %s(): %d B worst case" % (root, total))
+        for fn in chain:
+            flags = []
+            if fn in dynamic:
+                flags.append("dynamic")
+            if fn in indirect:
+                flags.append("indirect calls")
+            if fn not in frames:
+                flags.append("no .su")
+            lines.append("%8d  %s%s" % (frames.get(fn, 0), fn, "  [" + ", ".join(flags) + "]" if flags else ""))
+
+    if dynamic:
+        lines.append("")
+        lines.append("Dynamic stack use (VLA/alloca), fixed part counted only:")
+        for fn in sorted(dynamic):
+            lines.append("%8d  %s" % (frames.get(fn, 0), fn))
+
+    report_dir = os.path.join(project_dir, "size_reports")
+    if not os.path.isdir(report_dir):
+        os.makedirs(report_dir)
+    with open(os.path.join(report_dir, env_name + ".txt"), "w") as f:
+        f.write("\n".join(lines) + "\n")
+
+    history = os.path.join(report_dir, env_name + ".csv")
+    is_new = not os.path.isfile(history)
+    with open(history, "a") as f:
+        writer = csv.writer(f)
+        if is_new:
+            writer.writerow(["time", "revision", "flags", "flash", "ram", "stack_setup", "stack_loop"])
+        writer.writerow([datetime.datetime.now().strftime("%Y-%m-%d %H:%M"), git_revision(project_dir),
+                         build_flags, flash, ram,
+                         stack["setup"], stack["loop"]])
+
+    print("Size report: flash %d B, RAM %d B, stack setup() %d B, loop() %d B -> size_reports/%s.txt"
+          % (flash, ram, stack["setup"], stack["loop"], env_name))
+
+    if budget and flash > budget:
+        print("Size report: flash %d B is over the budget of %d B, the image would overwrite %s"
+              % (flash, budget, "the OTA staging area" if "MQTTU_OTA" in build_flags else "the record rows"))
+        return 1
+
+
+def print_report(target, source, env):
+    report = os.path.join(env.subst("$PROJECT_DIR"), "size_reports", env.subst("$PIOENV") + ".txt")
+    with open(report) as f:
+        print(f.read())
+
+
+env.AddPostAction("$BUILD_DIR/${PROGNAME}.elf", write_report)
+env.AddCustomTarget(
+    name="size_report",
+    dependencies="$BUILD_DIR/${PROGNAME}.elf",
+    actions=[print_report],
+    title="Size Report",
+    description="Flash, RAM and stack budget of the last build",
+)